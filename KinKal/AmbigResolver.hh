@@ -0,0 +1,171 @@
+#ifndef KinKal_AmbigResolver_hh
+#define KinKal_AmbigResolver_hh
+//
+//  Resolve the left-right ambiguity of wire hits jointly, for small groups of hits adjacent in time, using the result of the previous
+//  meta-iteration without refitting.  The fit information excluding all the hits of a group is found by subtracting the other
+//  hits' weights from the unbiased information cached by the first active hit (see KKHit::weightCache).  That is exact only if no other
+//  effect changes the information between the hits, so groups are split at material and BField correction effects.  The material
+//  of a hit with material doesn't split groups: it changes the information only by the scattering and energy loss noise of one
+//  crossing, which is neglected.  The parameters are taken relative to each hit's own reference piece, which moves with the fit
+//  parameters across that material.
+//  The chisquared of fitting the group's hits together with that information is computed for every combination of left and right
+//  ambiguities, and the best combination is assigned.  Only the first combination is fit from the weights; each of the others
+//  changes the ambiguity of one hit from the previous one (Gray code order), so its fit follows by adding the new residual and
+//  removing the old (rank-1 updates).  Hits whose best alternative is worse by less than minchisqdiff_ are set to null ambiguity.
+//  Drift and null residuals have different units, so the null alternative is chosen by that margin instead of by chisquared.
+//  The resolver is added as a hit updater to a meta-iteration which updates hits, and runs before the hits are updated.
+//  In that meta-iteration the hit updaters only set the hit activity.
+//  used as part of the kinematic kalman fit
+//
+#include "KinKal/TPocaBase.hh"
+#include "KinKal/WireHit.hh"
+#include "KinKal/LRAmbig.hh"
+#include "KinKal/TDir.hh"
+#include "Math/SVector.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <istream>
+
+namespace KinKal {
+  struct AmbigResolver {
+    static constexpr unsigned maxgroupsize = 8; // the combinations grow as 2^group size
+    unsigned maxgroup_; // maximum number of hits resolved together
+    double maxdt_; // maximum time between adjacent hits in a group (ns)
+    double minchisqdiff_; // minimum chisquared difference between the best and the alternative ambiguity to resolve a hit
+    AmbigResolver(unsigned maxgroup, double maxdt, double minchisqdiff) : maxgroup_(maxgroup), maxdt_(maxdt), minchisqdiff_(minchisqdiff) { check(); }
+    // construct from a schedule file line; see KKConfig::readSchedule
+    AmbigResolver(std::istream& is) { if(is >> maxgroup_ >> maxdt_ >> minchisqdiff_) check(); }
+    static const char* name() { return "AmbigResolver"; }
+    // resolve the ambiguities of the hits of the given effects, which must be in time order.  A null entry marks any other effect between
+    // hits; groups never extend across one.  Only wire hits that were processed in both directions by the last fit iteration are resolved.
+    // TPOCA is computed against the reference used in that iteration
+    template <class KKHIT> void resolve(std::vector<KKHIT const*> const& kkhits, typename KKHIT::PKTRAJ const& reftraj, TPocaConfig const& tpconfig) const;
+    private:
+    void check() const { if(maxgroup_ == 0 || maxgroup_ > maxgroupsize) throw std::invalid_argument("AmbigResolver: invalid group size"); }
+    // the wire hit of a time hit, or null if it isn't one
+    template <class KTRAJ> static WireHit<KTRAJ>* wireHit(THit<KTRAJ>& thit) { return dynamic_cast<WireHit<KTRAJ>*>(&thit); }
+    template <class KKHIT> void resolveGroup(std::vector<KKHIT const*> const& group, typename KKHIT::PKTRAJ const& reftraj, TPocaConfig const& tpconfig) const;
+    // update the parameter changes, their covariance, and the chisquared for adding a residual with the given (scaled) variance, or
+    // removing it if the variance is negative
+    template <class PDATA, class RESIDUAL> static void updateFit(RESIDUAL const& resid, double tvar, PDATA& pdata, double& chisq);
+  };
+
+  template <class KKHIT> void AmbigResolver::resolve(std::vector<KKHIT const*> const& kkhits, typename KKHIT::PKTRAJ const& reftraj, TPocaConfig const& tpconfig) const {
+    std::vector<KKHIT const*> group;
+    group.reserve(maxgroup_);
+    for(auto kkhit : kkhits){
+      if(kkhit == 0){
+	if(group.size() > 0) resolveGroup(group,reftraj,tpconfig);
+	group.clear();
+	continue;
+      }
+      if(!(wireHit(*kkhit->tHit()) != 0 && kkhit->wasProcessed(TDir::forwards) && kkhit->wasProcessed(TDir::backwards))) continue;
+      if(group.size() > 0 && (group.size() == maxgroup_ || kkhit->time() - group.back()->time() > maxdt_)){
+	resolveGroup(group,reftraj,tpconfig);
+	group.clear();
+      }
+      group.push_back(kkhit);
+    }
+    if(group.size() > 0) resolveGroup(group,reftraj,tpconfig);
+  }
+
+  template <class KKHIT> void AmbigResolver::resolveGroup(std::vector<KKHIT const*> const& group, typename KKHIT::PKTRAJ const& reftraj, TPocaConfig const& tpconfig) const {
+    typedef typename KKHIT::PDATA PDATA;
+    typedef typename KKHIT::WDATA WDATA;
+    typedef typename KKHIT::RESIDUAL RESIDUAL;
+    typedef typename KKHIT::TPOCA TPOCA;
+    typedef typename PDATA::DVEC DVEC;
+    size_t nhits = group.size();
+    // work with parameters relative to each hit's reference.  The weights of the fit information excluding all the hits in the group
+    // follow from the cache of the first active hit, which already excludes that hit.  Inactive hits add no information, and have no cache
+    size_t ifirst(0);
+    while(ifirst < nhits && !group[ifirst]->isActive()) ifirst++;
+    if(ifirst == nhits) return; // leave the ambiguities unchanged
+    WDATA wexcl = group[ifirst]->weightCache();
+    DVEC wvexcl = wexcl.weightVec() - wexcl.weightMat()*group[ifirst]->refParams().parameters();
+    for(size_t ihit=ifirst+1;ihit<nhits;ihit++){
+      if(group[ihit]->isActive()){
+	WDATA const& hiteff = group[ihit]->hitEffect();
+	wexcl.weightMat() -= hiteff.weightMat();
+	wvexcl -= hiteff.weightVec() - hiteff.weightMat()*group[ihit]->refParams().parameters();
+      }
+    }
+    // residuals of each hit for left (0) and right (1) ambiguity, and their scaled variances
+    std::vector<RESIDUAL> resids(2*nhits);
+    std::vector<double> tvars(2*nhits);
+    for(size_t ihit=0;ihit<nhits;ihit++){
+      auto const& kkhit = *group[ihit];
+      auto const& whit = *wireHit(*kkhit.tHit());
+      TPOCA tpoca(reftraj,whit.wire(),kkhit.refResid().tPoca().hint(),tpconfig);
+      if(!tpoca.usable()) return;
+      whit.ambigResid(tpoca,LRAmbig::left,resids[2*ihit]);
+      whit.ambigResid(tpoca,LRAmbig::right,resids[2*ihit+1]);
+      for(size_t iambig=0;iambig<2;iambig++) tvars[2*ihit+iambig] = resids[2*ihit+iambig].variance()*kkhit.varianceScale();
+    }
+    // minimum chisquared of the excluded information and the group's hits for each combination, up to a constant common to all
+    // combinations.  Bit i of the combination gives the ambiguity of hit i.  The all-left combination is fit in weight space, as the
+    // excluded information can leave parameters (like t0) unconstrained, which makes covariance-space updates lose precision.
+    // After that all the group's hits constrain the fit
+    size_t ncombo = size_t(1) << nhits;
+    std::vector<double> chisqs(ncombo,0.0);
+    WDATA wcombo(wvexcl,wexcl.weightMat());
+    for(size_t ihit=0;ihit<nhits;ihit++){
+      RESIDUAL const& resid = resids[2*ihit];
+      wcombo.weightVec() += resid.dRdP()*(resid.value()/tvars[2*ihit]);
+      for(size_t ipar=0;ipar<PDATA::PDim();ipar++)
+	for(size_t jpar=0;jpar<=ipar;jpar++)
+	  wcombo.weightMat()(ipar,jpar) += resid.dRdP()[ipar]*resid.dRdP()[jpar]/tvars[2*ihit];
+    }
+    PDATA pcombo;
+    try {
+      pcombo = PDATA(wcombo);
+    } catch (std::runtime_error const&) {
+      return; // leave the ambiguities unchanged
+    }
+    DVEC const& dpvec = pcombo.parameters();
+    double chisq = ROOT::Math::Similarity(dpvec,wexcl.weightMat()) - 2.0*ROOT::Math::Dot(dpvec,wvexcl);
+    for(size_t ihit=0;ihit<nhits;ihit++){
+      RESIDUAL const& resid = resids[2*ihit];
+      double dresid = resid.value() - ROOT::Math::Dot(dpvec,resid.dRdP());
+      chisq += dresid*dresid/tvars[2*ihit];
+    }
+    chisqs[0] = chisq;
+    // step i of the Gray code changes the ambiguity of the hit given by the lowest set bit of i.  Add the new residual before
+    // removing the old, so that the fit stays constrained
+    for(size_t istep=1;istep<ncombo;istep++){
+      size_t ihit(0);
+      while(!((istep>>ihit)&1)) ihit++;
+      size_t icombo = istep^(istep>>1);
+      size_t inew = 2*ihit + ((icombo>>ihit)&1);
+      size_t iold = 2*ihit + (((icombo>>ihit)&1)^1);
+      updateFit(resids[inew],tvars[inew],pcombo,chisq);
+      updateFit(resids[iold],-tvars[iold],pcombo,chisq);
+      chisqs[icombo] = chisq;
+    }
+    size_t best = std::distance(chisqs.begin(),std::min_element(chisqs.begin(),chisqs.end()));
+    for(size_t ihit=0;ihit<nhits;ihit++){
+      // best combination with this hit's ambiguity flipped
+      double altchisq = std::numeric_limits<double>::max();
+      for(size_t icombo=0;icombo<ncombo;icombo++)
+	if(((icombo^best)>>ihit)&1) altchisq = std::min(altchisq,chisqs[icombo]);
+      LRAmbig ambig = ((best>>ihit)&1) ? LRAmbig::right : LRAmbig::left;
+      if(altchisq - chisqs[best] < minchisqdiff_) ambig = LRAmbig::null;
+      wireHit(*group[ihit]->tHit())->setAmbig(ambig);
+    }
+  }
+
+  template <class PDATA, class RESIDUAL> void AmbigResolver::updateFit(RESIDUAL const& resid, double tvar, PDATA& pdata, double& chisq) {
+    typedef typename PDATA::DVEC DVEC;
+    DVEC cdrdp = pdata.covariance()*resid.dRdP();
+    double rvar = tvar + ROOT::Math::Dot(resid.dRdP(),cdrdp);
+    double dresid = resid.value() - ROOT::Math::Dot(pdata.parameters(),resid.dRdP());
+    chisq += dresid*dresid/rvar;
+    pdata.parameters() += cdrdp*(dresid/rvar);
+    for(size_t ipar=0;ipar<PDATA::PDim();ipar++)
+      for(size_t jpar=0;jpar<=ipar;jpar++)
+	pdata.covariance()(ipar,jpar) -= cdrdp[ipar]*cdrdp[jpar]/rvar;
+  }
+}
+#endif
@@ -7,6 +7,7 @@
 #include "KinKal/TRange.hh"
 #include "KinKal/Vectors.hh"
 #include "KinKal/BField.hh"
+#include "KinKal/KinState.hh"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
@@ -31,21 +32,23 @@ namespace KinKal {
     double dt = trange.range()/nsteps;
     // now integrate
     Vec3 dmom;
+    KinState kstate;
     for(unsigned istep=0; istep< nsteps; istep++){
       double tstep = trange.low() + istep*dt;
-      Vec3 vel = ktraj.velocity(tstep);
-      Vec3 db = bfield.fieldVect(ktraj.position(tstep)) - ktraj.bnom(tstep);
-      dmom += cbar()*ktraj.charge()*dt*vel.Cross(db);
+      ktraj.kinState(tstep,kstate);
+      Vec3 db = bfield.fieldVect(kstate.pos_) - ktraj.bnom(tstep);
+      dmom += cbar()*ktraj.charge()*dt*kstate.vel_.Cross(db);
     }
     return dmom;
   }
 
   template<class KTRAJ> double BFieldUtils::rangeInTolerance(double tstart, BField const& bfield, KTRAJ const& ktraj, double tol) {
     // compute scaling factor
-    double spd = ktraj.speed(tstart);
-    double sfac = fabs(cbar()*ktraj.charge()*spd*spd/ktraj.momentumMag(tstart));
+    KinState kstate;
+    ktraj.kinState(tstart,kstate);
+    double sfac = fabs(cbar()*ktraj.charge()*kstate.speed_*kstate.speed_/kstate.mom_);
     // estimate step size from initial BField difference
-    Vec3 tpos = ktraj.position(tstart);
+    Vec3 tpos = kstate.pos_;
     Vec3 bvec = bfield.fieldVect(tpos);
     auto db = (bvec - ktraj.bnom(tstart)).R();
     // estimate the step size for testing the position deviation.  This comes from 2 components:
@@ -54,7 +57,7 @@ namespace KinKal {
     // step increment from static difference from nominal field.  0.2 comes from sagitta geometry
     // protect against nominal field = exact field
     if(db > 1e-4) tstep = std::min(tstep,0.2*sqrt(tol/(sfac*db))); 
-    Vec3 dBdt = bfield.fieldDeriv(tpos,ktraj.velocity(tstart));
+    Vec3 dBdt = bfield.fieldDeriv(tpos,kstate.vel_);
     // the deviation goes as the cube root of the BField change.  0.5 comes from cosine expansion
     tstep = std::min(tstep, 0.5*std::cbrt(tol/(sfac*dBdt.R()))); //
     //
@@ -7,6 +7,8 @@
 #include "KinKal/LocalBasis.hh"
 #include "KinKal/MatXing.hh"
 #include "KinKal/TDir.hh"
+#include "KinKal/TPocaBase.hh"
+#include "MatEnv/MatDBInfo.hh"
 #include <vector>
 #include <stdexcept>
 #include <array>
@@ -22,16 +24,21 @@ namespace KinKal {
       virtual ~DXing() {}
       virtual void update(PKTRAJ const& pktraj) =0;
       virtual void update(PKTRAJ const& pktraj, double xtime) =0; // update including an estimate of the xing time
+      // update using TPOCA already computed between the trajectory and this piece's sensor (ie by an associated hit).
+      // By default only the TPOCA time is used, as an estimate of the xing time
+      virtual void update(PKTRAJ const& pktraj, TPocaBase const& tpoca) { update(pktraj,tpoca.particleToca()); }
       virtual void print(std::ostream& ost=std::cout,int detail=0) const =0;
+      // material store used to resolve the crossing material handles
+      virtual MatEnv::MatDBInfo const& materialDB() const =0;
       // accessors
       double crossingTime() const { return xtime_; }
       double& crossingTime() { return xtime_; }
-      std::vector<MatXing>const&  matXings() const { return mxings_; }
+      MatXingCol const&  matXings() const { return mxings_; }
       // calculate the cumulative material effect from these crossings
       void momEffects(PKTRAJ const& pktraj, TDir tdir, std::array<double,3>& dmom, std::array<double,3>& momvar) const;
     protected:
       double xtime_; // time on the reference trajectory when the xing occured
-      std::vector<MatXing> mxings_; // material crossings for this detector piece on this trajectory
+      MatXingCol mxings_; // material crossings for this detector piece on this trajectory
   };
 
   template <class KTRAJ> void DXing<KTRAJ>::momEffects(PKTRAJ const& pktraj, TDir tdir, std::array<double,3>& dmom, std::array<double,3>& momvar) const {
@@ -41,14 +48,16 @@ namespace KinKal {
     double dmFdE = sqrt(mom*mom+mass*mass)/(mom*mom); // dimension of 1/E
     if(tdir == TDir::backwards)dmFdE *= -1.0;
     // loop over crossings for this detector piece
+    auto const& matdb = materialDB();
     for(auto const& mxing : mxings_){
+      // evaluate all the material effects together
+      auto matint = matdb.detMaterial(mxing.mat_).interaction(mom,mxing.plen_,mass);
       // compute FRACTIONAL momentum change and variance on that in the given direction
-      momvar[LocalBasis::momdir] += mxing.dmat_.energyLossVar(mom,mxing.plen_,mass)*dmFdE*dmFdE;
-      dmom [LocalBasis::momdir]+= mxing.dmat_.energyLoss(mom,mxing.plen_,mass)*dmFdE;
-      double scatvar = mxing.dmat_.scatterAngleVar(mom,mxing.plen_,mass);
+      momvar[LocalBasis::momdir] += matint.elossvar_*dmFdE*dmFdE;
+      dmom [LocalBasis::momdir]+= matint.eloss_*dmFdE;
       // scattering is the same in each direction and has no net effect, it only adds noise
-      momvar[LocalBasis::perpdir] += scatvar;
-      momvar[LocalBasis::phidir] += scatvar;
+      momvar[LocalBasis::perpdir] += matint.scatvar_;
+      momvar[LocalBasis::phidir] += matint.scatvar_;
     }
     // correct for time direction
   }
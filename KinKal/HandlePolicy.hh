@@ -0,0 +1,25 @@
+#ifndef KinKal_HandlePolicy_hh
+#define KinKal_HandlePolicy_hh
+//
+//  Policies defining how KKTrk and its effects hold the hits and material crossings they are constructed from.
+//  These are supplied by the caller as std::shared_ptr; the policy defines the handle type stored inside the fit.
+//  SharedHandles: the fit shares ownership of the hits and crossings.  Each handle copy is an atomic reference count
+//  update, which can become contention when many threads fit tracks sharing hits.
+//  BorrowedHandles: the fit only borrows the hits and crossings, without any reference counting.  The caller must
+//  keep every hit and crossing (including those associated with hits) alive until the KKTrk has been destroyed.
+//  Used as part of the kinematic Kalman fit
+//
+#include <memory>
+
+namespace KinKal {
+  struct SharedHandles {
+    template <class T> using Handle = std::shared_ptr<T>;
+    template <class T> static Handle<T> const& handle(std::shared_ptr<T> const& ptr) { return ptr; }
+  };
+
+  struct BorrowedHandles {
+    template <class T> using Handle = T*;
+    template <class T> static Handle<T> handle(std::shared_ptr<T> const& ptr) { return ptr.get(); }
+  };
+}
+#endif
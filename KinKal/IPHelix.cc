@@ -151,6 +151,24 @@ namespace KinKal {
     return l2g_(Vec3((sang - sphi0) / omega() - d0() * sphi0, -(cang - cphi0) / omega() + d0() * cphi0, z0() + l * tanDip()));
   }
 
+  void IPHelix::posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const
+  {
+    double cDip = cosDip();
+    double phi00 = phi0();
+    double vtrans = speed(time) * cDip;
+    double l = vtrans * (time - t0());
+    double ang = phi00 + l * omega();
+    double cang = cos(ang);
+    double sang = sin(ang);
+    double sphi0 = sin(phi00);
+    double cphi0 = cos(phi00);
+    double tacc = vtrans * vtrans * omega(); // centripetal acceleration
+
+    pos = l2g_(Vec3((sang - sphi0) / omega() - d0() * sphi0, -(cang - cphi0) / omega() + d0() * cphi0, z0() + l * tanDip()));
+    dir = l2g_(Vec3(cDip * cang, cDip * sang, cDip * tanDip()));
+    acc = l2g_(Vec3(-tacc * sang, tacc * cang, 0.0));
+  }
+
   Mom4 IPHelix::momentum(double time) const
   {
 
@@ -60,6 +60,8 @@ namespace KinKal {
       Vec3 position(double time) const; // time is input
       Mom4 momentum(double time) const;
       Vec3 velocity(double time) const;
+      // position, direction, and acceleration at the given time, evaluated together
+      void posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const;
       Vec3 direction(double time, LocalBasis::LocDir mdir= LocalBasis::momdir) const;
       // scalar momentum and energy in MeV/c units
       double momentumMag(double time) const  { return mass_ * pbar() / mbar_; }
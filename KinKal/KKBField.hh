@@ -95,9 +95,9 @@ namespace KinKal {
       // adjust time if necessary
       double time = this->time()+ 1.0e-5; // slight buffer to make local piece selection more consistent
       double tlow = std::max(time,fit.back().range().low() + 1.0e-5);
-      TRange newrange(tlow,fit.range().high());
       KTRAJ newpiece(fit.back());
-      newpiece.range() = newrange;
+      // the piece starts here; appending it extends it to the end of the fit
+      newpiece.range() = TRange(tlow,tlow);
       // if we are using variable BField, update the parameters accordingly
       if(bfcorr_ == KKConfig::variable){
 	Vec3 newbnom = bfield_.fieldVect(fit.position(drange_.high()));
@@ -106,7 +106,7 @@ namespace KinKal {
       // adjust for the residual parameter change due to difference in bnom
       // don't double-count the effect due to bnom change; here we want just
       // the effect of the approximation of (piecewise) bnom vs the full field
-      newpiece.params().parameters() += dbint_;
+      newpiece.setParams(PDATA(newpiece.params().parameters() + dbint_,newpiece.params().covariance()));
       fit.append(newpiece);
     }
   }
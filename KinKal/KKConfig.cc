@@ -1,14 +1,22 @@
 #include "KinKal/KKConfig.hh"
+#include <atomic>
 namespace KinKal {
+  size_t HitUpdaterIndex::next() {
+    static std::atomic<size_t> nindex(0);
+    return nindex++;
+  }
+
   std::ostream& operator <<(std::ostream& ost, MConfig mconfig ) {
-      ost << "Meta-Iteration " << mconfig.miter_ << " temp " << mconfig.temp_;
+      ost << "Meta-Iteration " << mconfig.miter_ << " temp " << mconfig.temp_ << " TPOCA precision " << mconfig.tpconfig_.precision_;
+      if(mconfig.updtol_ > 0.0)
+	ost << " update tolerance " << mconfig.updtol_;
       if(mconfig.updatemat_)
 	ost << " Update Material Xings";
       if(mconfig.updatebfcorr_)
 	ost << " Update BField Correction";
       if(mconfig.updatehits_){
 	ost << " Update Hit Internals with ";
-	ost << mconfig.hitupdaters_.size() << " Hit updaters" << std::endl;
+	ost << mconfig.nHitUpdaters() << " Hit updaters" << std::endl;
       }
       ost << " converge, diverge, oscillating dchisq " << mconfig.convdchisq_ 
       << " "<< mconfig.divdchisq_  
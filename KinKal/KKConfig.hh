@@ -9,15 +9,27 @@
 // constant until the algebraic iteration implicit in the extended Kalman fit methodology converges.
 //
 #include "KinKal/BField.hh"
+#include "KinKal/TPocaBase.hh"
 
 #include <vector>
 #include <memory>
 #include <algorithm>
-#include <any>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cstddef>
+#include <cctype>
 #include <ostream>
 #include <istream>
 
 namespace KinKal {
+  // small integer identifying each hit updater type, assigned on first use.  This gives hits O(1) access to their updater
+  struct HitUpdaterIndex {
+    template <class UPDATER> static size_t index() { static const size_t index = next(); return index; }
+    private:
+    static size_t next();
+  };
+
   struct MConfig {
     bool updatemat_; // update material effects
     bool updatebfcorr_; // update magnetic field inhomogeneity effects
@@ -27,13 +39,43 @@ namespace KinKal {
     double divdchisq_; // minimum change in chisquared/dof for divergence
     double oscdchisq_; // maximum change in chisquared/dof for oscillation
     int miter_; // count of meta-iteration
-    // payload for hit updating; specific hit classes should find their particular payload inside the vector
-    std::vector<std::any> hitupdaters_;
-    MConfig() : updatemat_(false), updatebfcorr_(false), updatehits_(false), temp_(0.0), convdchisq_(0.01), divdchisq_(10.0), oscdchisq_(1.0), miter_(-1) {}
-    MConfig(std::istream& is) : miter_(-1) {
+    TPocaConfig tpconfig_; // TPOCA precision and limits for this meta-iteration
+    // maximum change of a hit's residual since its derivatives were computed, in units of the residual sigma, for which an algebraic iteration
+    // keeps the derivatives and only moves the reference.  0 (the default) always recomputes them
+    double updtol_;
+    MConfig() : updatemat_(false), updatebfcorr_(false), updatehits_(false), temp_(0.0), convdchisq_(0.01), divdchisq_(10.0), oscdchisq_(1.0), miter_(-1), updtol_(0.0) {}
+    MConfig(std::istream& is) : miter_(-1), updtol_(0.0) {
       is >> updatemat_ >> updatebfcorr_ >> updatehits_ >> temp_ >> convdchisq_ >> divdchisq_ >> oscdchisq_;
+      if(is.fail()) throw std::invalid_argument("MConfig: can't parse meta-iteration parameters");
+      // TPOCA precision is optional; the default is full precision.  The update tolerance is optional after that
+      double tprec;
+      if(is >> tprec){
+	tpconfig_.precision_ = tprec;
+	double updtol;
+	if(is >> updtol) updtol_ = updtol;
+      }
+      std::string extra;
+      is.clear();
+      if(is >> extra) throw std::invalid_argument("MConfig: unexpected meta-iteration parameter " + extra);
     }
     double varianceScale() const { return (1.0+temp_)*(1.0+temp_); } // variance scale so that temp=0 means no additional variance
+    // add a hit updater to this meta-iteration.  Only 1 updater of each type is allowed
+    template <class UPDATER> void addHitUpdater(UPDATER const& updater) {
+      size_t index = HitUpdaterIndex::index<UPDATER>();
+      if(index >= hitupdaters_.size()) hitupdaters_.resize(index+1);
+      if(hitupdaters_[index]) throw std::invalid_argument("MConfig: multiple " + std::string(UPDATER::name()) + " updaters");
+      hitupdaters_[index] = std::make_shared<const UPDATER>(updater);
+    }
+    // find the hit updater of the given type; null if there is none, in which case the hits are frozen this meta-iteration
+    template <class UPDATER> UPDATER const* hitUpdater() const {
+      size_t index = HitUpdaterIndex::index<UPDATER>();
+      return index < hitupdaters_.size() ? static_cast<UPDATER const*>(hitupdaters_[index].get()) : 0;
+    }
+    size_t nHitUpdaters() const { return std::count_if(hitupdaters_.begin(),hitupdaters_.end(),[](std::shared_ptr<const void> const& hu) { return bool(hu); }); }
+    private:
+    // payload for hit updating, indexed by HitUpdaterIndex.  The payload type is only known through the typed accessors above:
+    // specific hit classes find their particular payload with hitUpdater
+    std::vector<std::shared_ptr<const void>> hitupdaters_;
   };
 
   struct KKConfig {
@@ -41,23 +83,67 @@ namespace KinKal {
     enum BFieldCorr {nocorr=0, fixed, variable };
     typedef std::vector<MConfig> MConfigCol;
     KKConfig(BField const& bfield,std::vector<MConfig>const& schedule) : KKConfig(bfield) { schedule_ = schedule; }
-    KKConfig(BField const& bfield) : bfield_(bfield),  maxniter_(10), dwt_(1.0e6),  tbuff_(0.5), tol_(0.1), minndof_(5), addmat_(true), bfcorr_(fixed), plevel_(none) {} 
+    KKConfig(BField const& bfield) : bfield_(bfield),  maxniter_(10), maxnrefit_(5), dwt_(1.0e6),  tbuff_(0.5), tol_(0.1), minndof_(5), addmat_(true), bfcorr_(fixed), batchtpoca_(false), plevel_(none) {} 
     BField const& bfield() const { return bfield_; }
     MConfigCol const& schedule() const { return schedule_; }
+    // append meta-iterations read from a schedule stream.  Each line not starting with '#' either defines a new meta-iteration (see MConfig),
+    // or starts with the name of a hit updater type followed by its parameters, and adds that updater to the preceding meta-iteration.
+    // The updater types that can appear are given as the template arguments; they must provide name() and construction from a stream.
+    // A line that can't be parsed completely throws std::invalid_argument
+    template <class ... UPDATERS> void readSchedule(std::istream& is);
     BField const& bfield_;
     // algebraic iteration parameters
     int maxniter_; // maximum number of algebraic iterations for this config
+    int maxnrefit_; // maximum number of algebraic iterations when refitting after adding or removing hits
     double dwt_; // dweighting of initial seed covariance
     double tbuff_; // time buffer for final fit (ns)
     double tol_; // tolerance on position change in BField integration (mm)
     unsigned minndof_; // minimum number of DOFs to continue fit
     bool addmat_; // add material effects in the fit
     BFieldCorr bfcorr_; // how to make BField corrections in the fit
+    // compute the TPOCA of hits with linear sensors in batches, grouped by reference piece (see TPocaBatch).  This is off by default:
+    // the batch loop is only written for compiler vectorization (there is no SIMD kernel), and it hasn't been shown to speed up real fits
+    bool batchtpoca_;
     Vec3 origin_; // nominal origin for defining BNom
     printLevel plevel_; // print level
     // schedule of meta-iterations.  These will be executed sequentially until completion or failure
     MConfigCol schedule_; 
+    private:
+    // read the parameters of the named hit updater if it matches the given type
+    template <class UPDATER> static bool readHitUpdater(std::string const& name, std::istream& is, MConfig& mconfig);
   };
+
+  template <class ... UPDATERS> void KKConfig::readSchedule(std::istream& is) {
+    std::string line;
+    while(std::getline(is,line)){
+      std::istringstream ss(line);
+      std::string token;
+      if(!(ss >> token) || token[0] == '#') continue;
+      if(std::isalpha(static_cast<unsigned char>(token[0]))){
+	if(schedule_.empty()) throw std::invalid_argument("KKConfig: hit updater " + token + " precedes the first meta-iteration");
+	MConfig& mconfig = schedule_.back();
+	if(!mconfig.updatehits_) throw std::invalid_argument("KKConfig: hit updater " + token + " given for a meta-iteration that doesn't update hits");
+	// find the updater type with this name and construct it from the rest of the line
+	if(!(readHitUpdater<UPDATERS>(token,ss,mconfig) || ... || false))
+	  throw std::invalid_argument("KKConfig: unknown hit updater " + token);
+      } else {
+	std::istringstream mss(line);
+	MConfig mconfig(mss);
+	mconfig.miter_ = schedule_.size();
+	schedule_.push_back(mconfig);
+      }
+    }
+  }
+
+  template <class UPDATER> bool KKConfig::readHitUpdater(std::string const& name, std::istream& is, MConfig& mconfig) {
+    if(name != UPDATER::name()) return false;
+    UPDATER updater(is);
+    std::string extra;
+    if(is.fail() || is >> extra) throw std::invalid_argument("KKConfig: can't parse " + name + " parameters");
+    mconfig.addHitUpdater(updater);
+    return true;
+  }
+
   std::ostream& operator <<(std::ostream& os, KKConfig kkconfig );
   std::ostream& operator <<(std::ostream& os, MConfig mconfig );
 }
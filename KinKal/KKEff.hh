@@ -33,6 +33,9 @@ namespace KinKal {
       virtual void update(PKTRAJ const& ref) = 0;
       // update this effect for a new configuration and reference trajectory
       virtual void update(PKTRAJ const& ref, MConfig const& mconfig) = 0;
+      // update this effect for a new reference trajectory by only moving the reference, if the change is small enough that the derivatives
+      // can be kept (see MConfig::updtol_).  Returns false if the effect must be updated normally
+      virtual bool shiftReference(PKTRAJ const& ref) { return false; }
       // append this effects trajectory change (if appropriate)
       virtual void append(PKTRAJ& fit) {};
       virtual void print(std::ostream& ost=std::cout,int detail=0) const =0;
@@ -45,6 +45,9 @@ namespace KinKal {
 
   template <class KTRAJ> KKEnd<KTRAJ>::KKEnd(PKTRAJ const& pktraj, TDir tdir, double dweight) :
     tdir_(tdir) , dwt_(dweight), vscale_(1.0), endtraj_(tdir == TDir::forwards ? pktraj.front() : pktraj.back()){
+      // only the end time of the cache is used, which keeps caching the parameters cheap
+      double tend = tdir == TDir::forwards ? endtraj_.range().low() : endtraj_.range().high();
+      endtraj_.range() = TRange(tend,tend);
       update(pktraj);
     }
 
@@ -55,7 +58,7 @@ namespace KinKal {
       kkdata.append(endeff_);
     else
     // at the opposite end, cache the final parameters
-      endtraj_.params() = kkdata.pData();
+      endtraj_.setParams(kkdata.pData());
     KKEffBase::setStatus(tdir,KKEffBase::processed);
   }
 
@@ -72,10 +75,11 @@ namespace KinKal {
     // seed the fit with it
     if(tdir_ == TDir::forwards) {
       if(fit.pieces().size() == 0){
-	// start with a very large range 
-	endtraj_.range() = TRange(-std::numeric_limits<double>::max(),std::numeric_limits<double>::max());
+	// start with a very large range: the effects can move before the cached end time during the fit.  The range is set when the fit is complete
+	KTRAJ endpiece(endtraj_);
+	endpiece.range() = TRange(-std::numeric_limits<double>::max(),std::numeric_limits<double>::max());
 	// append this to the (empty) fit
-	fit.append(endtraj_);
+	fit.append(endpiece);
       } else
 	throw std::invalid_argument("Input PKTraj isn't empty");
     }
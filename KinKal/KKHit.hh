@@ -5,31 +5,44 @@
 //  Used as part of the kinematic Kalman fit
 //
 #include "KinKal/KKEff.hh"
+#include "KinKal/KKLineEff.hh"
 #include "KinKal/PKTraj.hh"
 #include "KinKal/THit.hh"
+#include "KinKal/LineHit.hh"
 #include "KinKal/TPocaBase.hh"
 #include "KinKal/Residual.hh"
+#include "KinKal/UnbiasedResid.hh"
+#include "KinKal/HandlePolicy.hh"
 #include <ostream>
 #include <memory>
 
 namespace KinKal {
-  template <class KTRAJ> class KKHit : public KKEff<KTRAJ> {
+  template <class KTRAJ, class HPOLICY=SharedHandles> class KKHit : public KKEff<KTRAJ>, public KKLineEff<KTRAJ> {
     public:
       typedef KKEff<KTRAJ> KKEFF;
+      typedef KKLineEff<KTRAJ> KKLINEEFF;
       typedef PKTraj<KTRAJ> PKTRAJ;
       typedef THit<KTRAJ> THIT;
+      typedef LineHit<KTRAJ> LHIT;
       typedef Residual<KTRAJ::NParams()> RESIDUAL;
-      typedef std::shared_ptr<THIT> THITPTR;
+      typedef UnbiasedResid<KTRAJ> URESID;
+      typedef typename HPOLICY::template Handle<THIT> THITPTR; // hit handle type, see HandlePolicy
       typedef typename KTRAJ::PDATA PDATA; // forward derivative type
       typedef typename KKEFF::WDATA WDATA; // forward the typedef
       typedef typename KKEFF::KKDATA KKDATA;
       typedef TData<PDATA::PDim()> TDATA;
       typedef typename KTRAJ::DVEC DVEC; // forward derivative type
+      typedef typename KKLINEEFF::TPOCA TPOCA;
       virtual unsigned nDOF() const override { return thit_->isActive() ? thit_->nDOF() : 0; }
       virtual double fitChi() const override; 
       virtual double chisq(PDATA const& pdata) const override{ double chival = chi(pdata); return chival*chival; } 
       virtual void update(PKTRAJ const& pktraj)  override;
       virtual void update(PKTRAJ const& pktraj, MConfig const& mconfig) override;
+      virtual bool shiftReference(PKTRAJ const& pktraj) override;
+      virtual TLine const* sensor() const override { return lhit_ != 0 ? &lhit_->sensor() : 0; }
+      virtual TPocaHint sensorHint() const override { return rresid_.tPoca().hint(); }
+      virtual void updateSensor(PKTRAJ const& pktraj, TPOCA const& tpoca) override;
+      virtual void updateSensor(PKTRAJ const& pktraj, MConfig const& mconfig, TPOCA const& tpoca) override;
       virtual void process(KKDATA& kkdata,TDir tdir) override;
       virtual bool isActive() const override { return thit_->isActive(); }
       virtual double time() const override { return rresid_.time(); } // time on the particle trajectory
@@ -37,30 +50,39 @@ namespace KinKal {
       virtual ~KKHit(){}
       // local functions
       void updateCache(PKTRAJ const& pktraj);
-      // construct from a hit and reference trajectory
+      // construct from a hit and reference trajectory.  How the hit is held depends on the handle policy
       KKHit(THITPTR const& thit, PKTRAJ const& reftraj);
       // interface for reduced residual
       double chi(PDATA const& pdata) const;
+      // unbiased residual from the fit information excluding this hit, given the fit trajectory.  This requires the hit to have been
+      // processed in both directions
+      bool unbiasedResid(PKTRAJ const& fittraj, URESID& uresid) const;
       // accessors
       THITPTR const& tHit() const { return thit_; }
       RESIDUAL const& refResid() const { return rresid_; }
       PDATA const& refParams() const { return ref_; }
-      WDATA const& weightCache() const { return wcache_; }
+      WDATA const& weightCache() const { return wcache_; } // only filled by processing an active hit
+      WDATA const& hitEffect() const { return hiteff_; }
+      double varianceScale() const { return vscale_; }
       // compute the reduced residual
     private:
       THITPTR thit_ ; // hit used for this constraint
+      LHIT* lhit_; // the same hit if it's measured against a linear sensor, otherwise null
       PDATA ref_; // reference parameters
       WDATA wcache_; // sum of processing weights in opposite directions, excluding this hit's information. used to compute chisquared and reduced residuals
       WDATA hiteff_; // wdata representation of this effect's constraint/measurement
       RESIDUAL rresid_; // residuals for this reference and hit
       double vscale_; // variance factor due to annealing 'temperature'
+      TPocaConfig tpconfig_; // TPOCA configuration of the current meta-iteration
+      double updtol_; // residual change tolerance for keeping the derivatives, see MConfig
   };
 
-  template<class KTRAJ> KKHit<KTRAJ>::KKHit(THITPTR const& thit, PKTRAJ const& reftraj) : thit_(thit), vscale_(1.0) {
+  template <class KTRAJ, class HPOLICY> KKHit<KTRAJ,HPOLICY>::KKHit(THITPTR const& thit, PKTRAJ const& reftraj) : thit_(thit),
+    lhit_(dynamic_cast<LHIT*>(&*thit)), vscale_(1.0), updtol_(0.0) {
     update(reftraj);
   }
  
-  template<class KTRAJ> void KKHit<KTRAJ>::process(KKDATA& kkdata,TDir tdir) {
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::process(KKDATA& kkdata,TDir tdir) {
     // direction is irrelevant for adding information
     if(this->isActive()){
       // cache the processing weights, adding both processing directions
@@ -71,25 +93,56 @@ namespace KinKal {
     KKEffBase::setStatus(tdir,KKEffBase::processed);
   }
 
-  template<class KTRAJ> void KKHit<KTRAJ>::update(PKTRAJ const& pktraj) {
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::update(PKTRAJ const& pktraj) {
     // compute residual and derivatives from hit using reference parameters
-    thit_->resid(pktraj, rresid_);
+    thit_->resid(pktraj, tpconfig_, rresid_);
     updateCache(pktraj);
   }
 
-  template<class KTRAJ> void KKHit<KTRAJ>::update(PKTRAJ const& pktraj, MConfig const& mconfig) {
-    // reset the annealing temp
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::update(PKTRAJ const& pktraj, MConfig const& mconfig) {
+    // reset the annealing temp and TPOCA configuration
     vscale_ = mconfig.varianceScale();
+    tpconfig_ = mconfig.tpconfig_;
+    updtol_ = mconfig.updtol_;
     // update the hit internal state; this can depend on specific configuration parameters
     if(mconfig.updatehits_)
       thit_->update(pktraj,mconfig, rresid_);
     else
-      thit_->resid(pktraj, rresid_);
+      thit_->resid(pktraj, tpconfig_, rresid_);
     // update the state of this object
     updateCache(pktraj);
   }
 
-  template<class KTRAJ> void KKHit<KTRAJ>::updateCache(PKTRAJ const& pktraj) {
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::updateSensor(PKTRAJ const& pktraj, TPOCA const& tpoca) {
+    lhit_->resid(tpoca, rresid_);
+    updateCache(pktraj);
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::updateSensor(PKTRAJ const& pktraj, MConfig const& mconfig, TPOCA const& tpoca) {
+    vscale_ = mconfig.varianceScale();
+    tpconfig_ = mconfig.tpconfig_;
+    updtol_ = mconfig.updtol_;
+    if(mconfig.updatehits_)
+      lhit_->update(tpoca,mconfig, rresid_);
+    else
+      lhit_->resid(tpoca, rresid_);
+    updateCache(pktraj);
+  }
+
+  template <class KTRAJ, class HPOLICY> bool KKHit<KTRAJ,HPOLICY>::shiftReference(PKTRAJ const& pktraj) {
+    if(!(updtol_ > 0.0)) return false;
+    // residual change predicted by the derivatives, from the reference they were computed at
+    DVEC dpvec = pktraj.nearestPiece(rresid_.time()).params().parameters() - ref_.parameters();
+    double dresid = ROOT::Math::Dot(dpvec,rresid_.dRdP());
+    if(dresid*dresid > updtol_*updtol_*rresid_.variance()*vscale_) return false;
+    // the linearized residual WRT the new reference gives the same weight as WRT the old, so the hit information and reference
+    // parameters can be kept as they are.  Only the processing cache is reset
+    wcache_ = WDATA();
+    KKEffBase::updateStatus();
+    return true;
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::updateCache(PKTRAJ const& pktraj) {
     // reset the processing cache
     wcache_ = WDATA();
     // scale resid variance by temp normalization
@@ -110,7 +163,7 @@ namespace KinKal {
     KKEffBase::updateStatus();
   }
 
-  template<class KTRAJ> double KKHit<KTRAJ>::fitChi() const {
+  template <class KTRAJ, class HPOLICY> double KKHit<KTRAJ,HPOLICY>::fitChi() const {
     double retval(0.0);
     if(this->isActive() && KKEffBase::wasProcessed(TDir::forwards) && KKEffBase::wasProcessed(TDir::backwards)) {
     // Invert the cache to get unbiased parameters at this hit
@@ -120,7 +173,7 @@ namespace KinKal {
     return retval;
   }
 
-  template<class KTRAJ> double KKHit<KTRAJ>::chi(PDATA const& pdata) const {
+  template <class KTRAJ, class HPOLICY> double KKHit<KTRAJ,HPOLICY>::chi(PDATA const& pdata) const {
     double retval(0.0);
     if(this->isActive()) {
       // compute the difference between these parameters and the reference parameters
@@ -137,7 +190,26 @@ namespace KinKal {
     return retval;
   }
 
-  template <class KTRAJ> void KKHit<KTRAJ>::print(std::ostream& ost, int detail) const {
+  template <class KTRAJ, class HPOLICY> bool KKHit<KTRAJ,HPOLICY>::unbiasedResid(PKTRAJ const& fittraj, URESID& uresid) const {
+    if(!(KKEffBase::wasProcessed(TDir::forwards) && KKEffBase::wasProcessed(TDir::backwards))) return false;
+    // the cache of an active hit holds the fit information excluding it; invert it to get the unbiased parameters.  An inactive hit
+    // doesn't add information, so the fit parameters at the hit already exclude it
+    PDATA unbiased = isActive() ? PDATA(wcache_) : fittraj.nearestPiece(time()).params();
+    DVEC dpvec = unbiased.parameters() - ref_.parameters();
+    DVEC cdrdp = unbiased.covariance()*rresid_.dRdP();
+    uresid.thit_ = &*thit_;
+    uresid.time_ = time();
+    uresid.active_ = isActive();
+    uresid.value_ = rresid_.value() - ROOT::Math::Dot(dpvec,rresid_.dRdP());
+    uresid.variance_ = ROOT::Math::Dot(rresid_.dRdP(),cdrdp) + rresid_.variance()*vscale_;
+    uresid.dchisq_ = uresid.value_*uresid.value_/uresid.variance_;
+    // adding this hit's information to the unbiased parameters is a rank-1 (gain) update; removing it reverses that
+    uresid.dpars_ = cdrdp*(uresid.value_/uresid.variance_);
+    if(uresid.active_) uresid.dpars_ = -uresid.dpars_;
+    return true;
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKHit<KTRAJ,HPOLICY>::print(std::ostream& ost, int detail) const {
     ost << "KKHit " << static_cast<KKEff<KTRAJ> const&>(*this) << " resid " << refResid()  << std::endl;
     if(detail > 0){
       thit_->print(ost,detail);    
@@ -145,7 +217,7 @@ namespace KinKal {
     }
   }
 
-  template <class KTRAJ> std::ostream& operator <<(std::ostream& ost, KKHit<KTRAJ> const& kkhit) {
+  template <class KTRAJ, class HPOLICY> std::ostream& operator <<(std::ostream& ost, KKHit<KTRAJ,HPOLICY> const& kkhit) {
     kkhit.print(ost,0);
     return ost;
   }
@@ -0,0 +1,27 @@
+#ifndef KinKal_KKLineEff_hh
+#define KinKal_KKLineEff_hh
+//
+// Interface of effects of hits measured against a linear sensor (see LineHit).  These can have their TPOCA computed in a batch with
+// others on the same reference piece (see TPocaBatch): they return the sensor and the starting point for the search, and are updated
+// from the result.  Effects implement this alongside KKEff; KKTrk finds it by dynamic_cast
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKConfig.hh"
+#include "KinKal/TPoca.hh"
+#include "KinKal/TLine.hh"
+
+namespace KinKal {
+  template<class KTRAJ> class KKLineEff {
+    public:
+      typedef PKTraj<KTRAJ> PKTRAJ;
+      typedef TPoca<PKTRAJ,TLine> TPOCA;
+      // the sensor, or null if this effect's hit doesn't have one
+      virtual TLine const* sensor() const = 0;
+      virtual TPocaHint sensorHint() const = 0;
+      // update for a new reference trajectory, or a new configuration and reference trajectory, from the TPOCA with the sensor
+      virtual void updateSensor(PKTRAJ const& ref, TPOCA const& tpoca) = 0;
+      virtual void updateSensor(PKTRAJ const& ref, MConfig const& mconfig, TPOCA const& tpoca) = 0;
+      virtual ~KKLineEff(){}
+  };
+}
+#endif
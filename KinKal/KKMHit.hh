@@ -6,21 +6,24 @@
 #include "KinKal/KKHit.hh"
 #include "KinKal/KKMat.hh"
 #include "KinKal/KKEff.hh"
+#include "KinKal/KKLineEff.hh"
 #include <stdexcept>
 #include <ostream>
 #include <memory>
 
 namespace KinKal {
-  template <class KTRAJ> class KKMHit : public KKEff<KTRAJ> {
+  template <class KTRAJ, class HPOLICY=SharedHandles> class KKMHit : public KKEff<KTRAJ>, public KKLineEff<KTRAJ> {
     public:
       typedef KKEff<KTRAJ> KKEFF;
-      typedef KKHit<KTRAJ> KKHIT;
-      typedef KKMat<KTRAJ> KKMAT;
+      typedef KKLineEff<KTRAJ> KKLINEEFF;
+      typedef KKHit<KTRAJ,HPOLICY> KKHIT;
+      typedef KKMat<KTRAJ,HPOLICY> KKMAT;
       typedef PKTraj<KTRAJ> PKTRAJ;
       typedef THit<KTRAJ> THIT;
-      typedef std::shared_ptr<THIT> THITPTR;
+      typedef typename KKHIT::THITPTR THITPTR;
       typedef typename KTRAJ::PDATA PDATA;
       typedef KKData<PDATA::PDim()> KKDATA;
+      typedef typename KKLINEEFF::TPOCA TPOCA;
       KKMHit(KKHIT& kkhit, KKMAT& kkmat) : kkhit_(kkhit), kkmat_(kkmat) {}
       KKMHit(THITPTR const& thit, PKTRAJ const& reftraj);
       // override the interface
@@ -32,6 +35,10 @@ namespace KinKal {
       virtual double chisq(PDATA const& pdata) const override { return kkhit_.chisq(pdata); }
       virtual void update(PKTRAJ const& ref) override;
       virtual void update(PKTRAJ const& ref, MConfig const& mconfig) override;
+      virtual TLine const* sensor() const override { return kkhit_.sensor(); }
+      virtual TPocaHint sensorHint() const override { return kkhit_.sensorHint(); }
+      virtual void updateSensor(PKTRAJ const& ref, TPOCA const& tpoca) override;
+      virtual void updateSensor(PKTRAJ const& ref, MConfig const& mconfig, TPOCA const& tpoca) override;
       virtual void append(PKTRAJ& fit) override { return kkmat_.append(fit); }
       virtual void print(std::ostream& ost=std::cout,int detail=0) const override;
       // accessors
@@ -42,10 +49,10 @@ namespace KinKal {
       KKMAT kkmat_; // associated material
   };
 
-  template <class KTRAJ> KKMHit<KTRAJ>::KKMHit(THITPTR const& thit, PKTRAJ const& pktraj) : kkhit_(thit,pktraj),
-    kkmat_(thit->detCrossing(), pktraj, thit->isActive()) { update(pktraj); }
+  template <class KTRAJ, class HPOLICY> KKMHit<KTRAJ,HPOLICY>::KKMHit(THITPTR const& thit, PKTRAJ const& pktraj) : kkhit_(thit,pktraj),
+    kkmat_(HPOLICY::handle(thit->detCrossing()), pktraj, thit->isActive()) { update(pktraj); }
 
-  template <class KTRAJ> void KKMHit<KTRAJ>::process(KKDATA& kkdata,TDir tdir) {
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::process(KKDATA& kkdata,TDir tdir) {
     // process in a fixed order to make material caching work
     bool hitfirst = (tdir == TDir::forwards && kkhit_.time() < kkmat_.time()) ||
       (tdir == TDir::backwards && kkhit_.time() > kkmat_.time());
@@ -59,7 +66,7 @@ namespace KinKal {
     KKEffBase::setStatus(tdir,KKEffBase::processed);
   }
 
-  template <class KTRAJ> void KKMHit<KTRAJ>::update(PKTRAJ const& pktraj) {
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::update(PKTRAJ const& pktraj) {
     if(pktraj.range().infinite())throw std::invalid_argument("Invalid range");
     // update the hit first, then use that to update the material 
     KKEffBase::updateStatus();
@@ -68,20 +75,36 @@ namespace KinKal {
     kkmat_.update(pktraj);
   }
   
-  template <class KTRAJ> void KKMHit<KTRAJ>::update(PKTRAJ const& pktraj, MConfig const& mconfig) {
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::update(PKTRAJ const& pktraj, MConfig const& mconfig) {
     KKEffBase::updateStatus();
     kkhit_.update(pktraj,mconfig);
     kkmat_.setTime(kkhit_.time());
-    kkmat_.update(pktraj,mconfig);
+    // the hit and material share the same sensor: reuse the hit TPOCA to update the material
+    kkmat_.update(pktraj,mconfig,kkhit_.refResid().tPoca());
   }
 
-  template <class KTRAJ> void KKMHit<KTRAJ>::print(std::ostream& ost, int detail) const {
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::updateSensor(PKTRAJ const& pktraj, TPOCA const& tpoca) {
+    if(pktraj.range().infinite())throw std::invalid_argument("Invalid range");
+    KKEffBase::updateStatus();
+    kkhit_.updateSensor(pktraj,tpoca);
+    kkmat_.setTime(kkhit_.time());
+    kkmat_.update(pktraj);
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::updateSensor(PKTRAJ const& pktraj, MConfig const& mconfig, TPOCA const& tpoca) {
+    KKEffBase::updateStatus();
+    kkhit_.updateSensor(pktraj,mconfig,tpoca);
+    kkmat_.setTime(kkhit_.time());
+    kkmat_.update(pktraj,mconfig,kkhit_.refResid().tPoca());
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKMHit<KTRAJ,HPOLICY>::print(std::ostream& ost, int detail) const {
     ost << "KKMHit " << static_cast<KKEff<KTRAJ> const&>(*this) << std::endl;
     hit().print(ost,detail);
     mat().print(ost,detail);
   }
   
-  template <class KTRAJ> std::ostream& operator <<(std::ostream& ost, KKMHit<KTRAJ> const& kkmhit) {
+  template <class KTRAJ, class HPOLICY> std::ostream& operator <<(std::ostream& ost, KKMHit<KTRAJ,HPOLICY> const& kkmhit) {
     kkmhit.print(ost,0);
     return ost;
   }
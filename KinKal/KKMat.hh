@@ -8,26 +8,30 @@
 #include "KinKal/DXing.hh"
 #include "KinKal/TPoca.hh"
 #include "KinKal/TDir.hh"
+#include "KinKal/HandlePolicy.hh"
 #include <iostream>
 #include <stdexcept>
 #include <array>
 #include <ostream>
 
 namespace KinKal {
-  template<class KTRAJ> class KKMat : public KKEff<KTRAJ> {
+  template <class KTRAJ, class HPOLICY=SharedHandles> class KKMat : public KKEff<KTRAJ> {
     public:
       typedef KKEff<KTRAJ> KKEFF;
       typedef PKTraj<KTRAJ> PKTRAJ;
       typedef DXing<KTRAJ> DXING;
-      typedef std::shared_ptr<DXING> DXINGPTR;
+      typedef typename HPOLICY::template Handle<DXING> DXINGPTR; // crossing handle type, see HandlePolicy
       typedef typename KKEFF::PDATA PDATA; // forward the typedef
       typedef typename KKEFF::WDATA WDATA; // forward the typedef
       typedef KKData<PDATA::PDim()> KKDATA;
       typedef typename KTRAJ::DVEC DVEC; // forward the typedef
-      virtual double time() const override { return dxing_->crossingTime() + 1.0e-3;} // small positive offset to disambiguate WRT hits should be a parameter FIXME!
+      static constexpr double toffset_ = 1.0e-3; // small positive time offset to disambiguate WRT hits should be a parameter FIXME!
+      virtual double time() const override { return dxing_->crossingTime() + toffset_;}
       virtual bool isActive() const override { return active_ && dxing_->matXings().size() > 0; }
       virtual void update(PKTRAJ const& ref) override;
       virtual void update(PKTRAJ const& ref, MConfig const& mconfig) override;
+      // update reusing TPOCA computed by an associated hit
+      void update(PKTRAJ const& ref, MConfig const& mconfig, TPocaBase const& tpoca);
       virtual void print(std::ostream& ost=std::cout,int detail=0) const override;
       virtual void process(KKDATA& kkdata,TDir tdir) override;
       virtual void append(PKTRAJ& fit) override;
@@ -49,12 +53,12 @@ namespace KinKal {
       bool active_;
   };
 
-   template<class KTRAJ> KKMat<KTRAJ>::KKMat(DXINGPTR const& dxing, PKTRAJ const& pktraj, bool active) : dxing_(dxing), 
+   template <class KTRAJ, class HPOLICY> KKMat<KTRAJ,HPOLICY>::KKMat(DXINGPTR const& dxing, PKTRAJ const& pktraj, bool active) : dxing_(dxing), 
    ref_(pktraj.nearestPiece(dxing->crossingTime())), vscale_(1.0), active_(active) {
      update(pktraj);
    }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::process(KKDATA& kkdata,TDir tdir) {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::process(KKDATA& kkdata,TDir tdir) {
     if(active_){
       // forwards, set the cache AFTER processing this effect
       if(tdir == TDir::forwards) {
@@ -72,14 +76,14 @@ namespace KinKal {
     KKEffBase::setStatus(tdir,KKEffBase::processed);
   }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::update(PKTRAJ const& ref) {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::update(PKTRAJ const& ref) {
     cache_ = WDATA();
     ref_ = ref.nearestPiece(dxing_->crossingTime()); 
     updateCache();
     KKEffBase::updateStatus();
   }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::update(PKTRAJ const& ref, MConfig const& mconfig) {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::update(PKTRAJ const& ref, MConfig const& mconfig) {
     vscale_ = mconfig.varianceScale();
     if(mconfig.updatemat_){
       // update the detector Xings for this effect
@@ -89,39 +93,48 @@ namespace KinKal {
     }
   }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::updateCache() {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::update(PKTRAJ const& ref, MConfig const& mconfig, TPocaBase const& tpoca) {
+    vscale_ = mconfig.varianceScale();
+    if(mconfig.updatemat_){
+      dxing_->update(ref,tpoca);
+      update(ref);
+    }
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::updateCache() {
     mateff_ = PDATA();
     if(dxing_->matXings().size() > 0){
-      // loop over the momentum change basis directions, adding up the effects on parameters from each
       std::array<double,3> dmom = {0.0,0.0,0.0}, momvar = {0.0,0.0,0.0};
       dxing_->momEffects(ref_,TDir::forwards, dmom, momvar); // rename matEffects FIXME!
+      // derivatives of the parameters WRT fractional momentum change along the basis directions
+      auto dPdm = ref_.momDerivs(time());
+      ROOT::Math::SVector<double,3> mdmom;
+      VMAT mvar;
       for(int idir=0;idir<LocalBasis::ndir; idir++) {
-	auto mdir = static_cast<LocalBasis::LocDir>(idir);
-	// get the derivatives of the parameters WRT material effects
-	// should call dPardM directly once and then project FIXME!
-	DVEC pder = ref_.momDeriv(time(), mdir);
-	// convert derivative vector to a Nx1 matrix
-	ROOT::Math::SMatrix<double,KTRAJ::NParams(),1> dPdm;
-	dPdm.Place_in_col(pder,0,0);
-	// update the transport for this effect; first the parameters.  Note these are for forwards time propagation (ie energy loss)
-	mateff_.parameters() += pder*dmom[idir];
-	// now the variance: this doesn't depend on time direction
-	ROOT::Math::SMatrix<double, 1,1, ROOT::Math::MatRepSym<double,1> > MVar;
-	MVar(0,0) = momvar[idir]*vscale_;
-	mateff_.covariance() += ROOT::Math::Similarity(dPdm,MVar);
+	mdmom[idir] = dmom[idir];
+	mvar(idir,idir) = momvar[idir]*vscale_;
       }
+      // update the transport for this effect; first the parameters.  Note these are for forwards time propagation (ie energy loss)
+      mateff_.parameters() = dPdm*mdmom;
+      // now the variance: this doesn't depend on time direction.  The basis directions are uncorrelated
+      mateff_.covariance() = ROOT::Math::Similarity(dPdm,mvar);
     }
   }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::append(PKTRAJ& fit) {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::append(PKTRAJ& fit) {
     if(active_){
       // create a trajectory piece from the cached weight
       double time = this->time();
       KTRAJ newpiece(ref_);
-      newpiece.params() = PDATA(cache_);
-      newpiece.range() = TRange(time,fit.range().high());
+      // the piece starts here; appending it extends it to the end of the fit
+      newpiece.range() = TRange(time,time);
+      newpiece.setParams(PDATA(cache_));
+      // the material of a hit is sorted by the hit time, so material closer than the time offset after it is appended first.
+      // The effects were processed in this order, so start this piece just after the previous one
+      double tlast = fit.back().range().low();
+      if(time <= tlast && time + toffset_ > tlast) newpiece.range() = TRange(tlast + TRange::tbuff_, tlast + TRange::tbuff_);
       // make sure the piece is appendable
-      if(time > fit.back().range().low()){
+      if(newpiece.range().low() > tlast){
 	fit.append(newpiece);
       } else {
 	throw std::invalid_argument("KKMat: Can't append piece");
@@ -129,7 +142,7 @@ namespace KinKal {
     }
   }
 
-  template<class KTRAJ> void KKMat<KTRAJ>::print(std::ostream& ost,int detail) const {
+  template <class KTRAJ, class HPOLICY> void KKMat<KTRAJ,HPOLICY>::print(std::ostream& ost,int detail) const {
     ost << "KKMat " << static_cast<KKEff<KTRAJ>const&>(*this);
     ost << " effect ";
     effect().print(ost,detail-2);
@@ -142,7 +155,7 @@ namespace KinKal {
     }
   }
 
-  template <class KTRAJ> std::ostream& operator <<(std::ostream& ost, KKMat<KTRAJ> const& kkmat) {
+  template <class KTRAJ, class HPOLICY> std::ostream& operator <<(std::ostream& ost, KKMat<KTRAJ,HPOLICY> const& kkmat) {
     kkmat.print(ost,0);
     return ost;
   }
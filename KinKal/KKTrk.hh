@@ -32,6 +32,13 @@
 //  material interactions.  The configuration object controls the fit iteration convergence testing, including simulated
 //  annealing and interactions with the external environment such as the material model and the magnetic field map.
 //  The fit is performed on construction.
+//  Hits can be added or removed, or their activity changed, after construction.  These refit incrementally, starting from
+//  the current fit result as reference and iterating with the configuration of the final meta-iteration, instead of
+//  re-running the schedule.
+//
+//  The hits and material crossings are provided as std::shared_ptr.  The optional HPOLICY template argument defines how KKTrk and
+//  its effects hold them: SharedHandles (the default) shares their ownership, BorrowedHandles avoids all reference counting,
+//  at the price of requiring the caller to keep them alive for the lifetime of the KKTrk.  See HandlePolicy.hh
 //
 //  The KinKal package is licensed under Adobe v2, and is hosted at https://github.com/KFTrack/KinKal.git
 //  David N. Brown, Lawrence Berkeley National Lab
@@ -39,21 +46,27 @@
 #include "KinKal/PKTraj.hh"
 #include "KinKal/KKData.hh"
 #include "KinKal/KKEff.hh"
+#include "KinKal/KKLineEff.hh"
 #include "KinKal/KKEnd.hh"
 #include "KinKal/KKMHit.hh"
 #include "KinKal/KKHit.hh"
 #include "KinKal/KKMat.hh"
 #include "KinKal/KKBField.hh"
 #include "KinKal/TPoca.hh"
+#include "KinKal/TPocaBatch.hh"
 #include "KinKal/THit.hh"
 #include "KinKal/KKConfig.hh"
+#include "KinKal/HandlePolicy.hh"
+#include "KinKal/AmbigResolver.hh"
 #include "KinKal/FitStatus.hh"
 #include "KinKal/BField.hh"
 #include "KinKal/BFieldUtils.hh"
 #include "TMath.h"
 #include <set>
 #include <vector>
+#include <utility>
 #include <iterator>
+#include <algorithm>
 #include <memory>
 #include <cmath>
 #include <limits>
@@ -61,13 +74,14 @@
 #include <ostream>
 
 namespace KinKal {
-  template<class KTRAJ> class KKTrk {
+  template<class KTRAJ, class HPOLICY=SharedHandles> class KKTrk {
     public:
       typedef KKEff<KTRAJ> KKEFF;
       typedef KKEnd<KTRAJ> KKEND;
-      typedef KKHit<KTRAJ> KKHIT;
-      typedef KKMHit<KTRAJ> KKMHIT;
-      typedef KKMat<KTRAJ> KKMAT;
+      typedef KKHit<KTRAJ,HPOLICY> KKHIT;
+      typedef KKMHit<KTRAJ,HPOLICY> KKMHIT;
+      typedef KKLineEff<KTRAJ> KKLINEEFF;
+      typedef KKMat<KTRAJ,HPOLICY> KKMAT;
       typedef KKBField<KTRAJ> KKBFIELD;
       typedef std::shared_ptr<KKConfig> KKCONFIGPTR;
       typedef PKTraj<KTRAJ> PKTRAJ;
@@ -77,8 +91,14 @@ namespace KinKal {
       typedef std::shared_ptr<DXING> DXINGPTR;
       typedef std::vector<THITPTR> THITCOL;
       typedef std::vector<DXINGPTR> DXINGCOL;
+      // handles held by the fit, according to the policy
+      typedef typename HPOLICY::template Handle<THIT> THITHANDLE;
+      typedef typename HPOLICY::template Handle<DXING> DXINGHANDLE;
+      typedef std::vector<THITHANDLE> THITHCOL;
+      typedef std::vector<DXINGHANDLE> DXINGHCOL;
       typedef typename KTRAJ::PDATA PDATA;
       typedef typename PDATA::DVEC DVEC;
+      typedef UnbiasedResid<KTRAJ> URESID;
       struct KKEFFComp { // comparator to sort effects by time
 	bool operator()(std::unique_ptr<KKEFF> const& a, std::unique_ptr<KKEFF> const&  b) const {
 	  if(a.get() != b.get())
@@ -89,8 +109,16 @@ namespace KinKal {
       };
       typedef std::vector<std::unique_ptr<KKEFF> > KKEFFCOL; // container type for effects
       // construct from a set of hits and passive material crossings
-      KKTrk(KKCONFIGPTR const& kkconfig, KTRAJ const& seedtraj, THITCOL& thits, DXINGCOL& dxings ); 
+      KKTrk(KKCONFIGPTR const& kkconfig, KTRAJ const& seedtraj, THITCOL const& thits, DXINGCOL const& dxings ); 
       void fit(); // process the effects.  This creates the fit
+      // incremental changes to the hits, each followed by a refit starting from the current fit result (see KKConfig::maxnrefit_).
+      // These require a usable fit, and throw if the hit isn't (or for addHit, is already) part of this fit
+      void addHit(THITPTR const& thit);
+      void removeHit(THITPTR const& thit);
+      void setHitActivity(THITPTR const& thit, bool active);
+      // unbiased residuals of all the hits in time order, with the effect of toggling each hit's activity, computed from the
+      // current fit without refitting (see UnbiasedResid).  Hits that weren't processed by the last fit iteration are skipped
+      void unbiasedResids(std::vector<URESID>& uresids) const;
       // accessors
       std::vector<FitStatus> const& history() const { return history_; }
       FitStatus const& fitStatus() const { return history_.back(); } // most recent status
@@ -98,30 +126,40 @@ namespace KinKal {
       PKTRAJ const& fitTraj() const { return fittraj_; }
       KKEFFCOL const& effects() const { return effects_; }
       KKConfig const& config() const { return *kkconfig_; }
-      THITCOL const& timeHits() const { return thits_; } 
-      DXINGCOL const& detMatXings() const { return dxings_; }
+      THITHCOL const& timeHits() const { return thits_; } 
+      DXINGHCOL const& detMatXings() const { return dxings_; }
       void print(std::ostream& ost=std::cout,int detail=0) const;
     private:
       // helper functions
       void update(FitStatus const& fstat, MConfig const& mconfig);
+      void updateSensors(MConfig const& mconfig, bool newconfig);
       void fitIteration(FitStatus& status, MConfig const& mconfig);
       bool canIterate() const;
       bool oscillating(FitStatus const& status, MConfig const& mconfig) const;
       void createRefTraj(KTRAJ const& seedtraj);
+      void refit();
+      void resolveAmbig(MConfig const& mconfig);
+      typename KKEFFCOL::iterator findHitEffect(THIT const* thit);
+      static KKHIT const* kkHit(KKEFF const* eff); // hit part of an effect, or null
+      static KKLINEEFF* lineEff(KKEFF* eff); // linear sensor interface of an effect, or null if it has no sensor
       // payload
       KKCONFIGPTR kkconfig_; // shared configuration
       std::vector<FitStatus> history_; // fit status history; records the current iteration
       PKTRAJ reftraj_; // reference against which the derivatives were evaluated and the current fit performed
       PKTRAJ fittraj_; // result of the current fit, becomes the reference when the fit is algebraically iterated
       KKEFFCOL effects_; // effects used in this fit, sorted by time
-      THITCOL thits_; // shared collection of hits
-      DXINGCOL dxings_; // shared collection of material crossings/interactions
+      THITHCOL thits_; // collection of hits
+      DXINGHCOL dxings_; // collection of material crossings/interactions
   };
 
 // construct from configuration, reference (seed) fit, hits,and materials specific to this fit.  Note that hits
 // can contain associated materials.
-  template <class KTRAJ> KKTrk<KTRAJ>::KKTrk(KKCONFIGPTR const& kkconfig, KTRAJ const& seedtraj,  THITCOL& thits, DXINGCOL& dxings) : 
-    kkconfig_(kkconfig), thits_(thits), dxings_(dxings) {
+  template <class KTRAJ, class HPOLICY> KKTrk<KTRAJ,HPOLICY>::KKTrk(KKCONFIGPTR const& kkconfig, KTRAJ const& seedtraj,  THITCOL const& thits, DXINGCOL const& dxings) : 
+    kkconfig_(kkconfig) {
+      thits_.reserve(thits.size());
+      for(auto const& thit : thits) thits_.push_back(HPOLICY::handle(thit));
+      dxings_.reserve(dxings.size()+thits.size());
+      for(auto const& dxing : dxings) dxings_.push_back(HPOLICY::handle(dxing));
       // Create the initial reference traj.  This also divides the range into domains of ~constant BField and creates correction effects for inhomogeneity
       createRefTraj(seedtraj);
       // create the effects.  First, loop over the hits
@@ -129,7 +167,7 @@ namespace KinKal {
 	// create the hit effects and insert them in the set
 	// if there's associated material, create a combined material and hit effect, otherwise just a hit effect
 	if(kkconfig_->addmat_ && thit->hasMaterial()){
-	  dxings_.push_back(thit->detCrossing());
+	  dxings_.push_back(HPOLICY::handle(thit->detCrossing()));
 	  effects_.emplace_back(std::make_unique<KKMHIT>(thit,reftraj_));
 	} else{ 
 	  effects_.emplace_back(std::make_unique<KKHIT>(thit,reftraj_));
@@ -137,8 +175,8 @@ namespace KinKal {
       }
       //add pure material effects
       if(kkconfig_->addmat_){
-	for(auto& dxing : dxings) {
-	  effects_.emplace_back(std::make_unique<KKMAT>(dxing,reftraj_));
+	for(size_t ixing=0; ixing < dxings.size(); ixing++) {
+	  effects_.emplace_back(std::make_unique<KKMAT>(dxings_[ixing],reftraj_));
 	}
       }
       // preliminary sort; this makes sure the range is accurate when computing BField corrections
@@ -155,7 +193,7 @@ namespace KinKal {
     }
 
   // fit iteration management 
-  template <class KTRAJ> void KKTrk<KTRAJ>::fit() {
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::fit() {
     // execute the schedule of meta-iterations
     for(auto imconfig=config().schedule().begin(); imconfig != config().schedule().end(); imconfig++){
       auto mconfig  = *imconfig;
@@ -180,8 +218,115 @@ namespace KinKal {
     }
   }
 
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::addHit(THITPTR const& thit) {
+    if(!fitStatus().usable()) throw std::logic_error("KKTrk: can't add a hit to an unusable fit");
+    if(findHitEffect(thit.get()) != effects_.end()) throw std::invalid_argument("KKTrk: hit is already in the fit");
+    thits_.push_back(HPOLICY::handle(thit));
+    auto const& hhandle = thits_.back();
+    // create the effect against the current fit result, which will be the reference for the refit
+    std::unique_ptr<KKEFF> eff;
+    if(kkconfig_->addmat_ && thit->hasMaterial()){
+      dxings_.push_back(HPOLICY::handle(thit->detCrossing()));
+      eff = std::make_unique<KKMHIT>(hhandle,fittraj_);
+    } else
+      eff = std::make_unique<KKHIT>(hhandle,fittraj_);
+    // configure it as the other effects were in the final meta-iteration
+    eff->update(fittraj_,config().schedule().back());
+    // insert in time order
+    auto ieff = std::upper_bound(effects_.begin(),effects_.end(),eff,KKEFFComp());
+    effects_.insert(ieff,std::move(eff));
+    refit();
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::removeHit(THITPTR const& thit) {
+    if(!fitStatus().usable()) throw std::logic_error("KKTrk: can't remove a hit from an unusable fit");
+    auto ieff = findHitEffect(thit.get());
+    if(ieff == effects_.end()) throw std::invalid_argument("KKTrk: hit isn't in the fit");
+    // the hit's material goes with it
+    if(dynamic_cast<KKMHIT const*>(ieff->get()) != 0){
+      auto ixing = std::find_if(dxings_.begin(),dxings_.end(),[&thit](DXINGHANDLE const& dxing){ return &*dxing == thit->detCrossing().get(); });
+      if(ixing != dxings_.end()) dxings_.erase(ixing);
+    }
+    effects_.erase(ieff);
+    thits_.erase(std::find_if(thits_.begin(),thits_.end(),[&thit](THITHANDLE const& hhandle){ return &*hhandle == thit.get(); }));
+    refit();
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::setHitActivity(THITPTR const& thit, bool active) {
+    if(!fitStatus().usable()) throw std::logic_error("KKTrk: can't change the hits of an unusable fit");
+    if(findHitEffect(thit.get()) == effects_.end()) throw std::invalid_argument("KKTrk: hit isn't in the fit");
+    thit->setActivity(active);
+    refit();
+  }
+
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::unbiasedResids(std::vector<URESID>& uresids) const {
+    uresids.clear();
+    uresids.reserve(thits_.size());
+    URESID uresid;
+    for(auto const& eff : effects_) {
+      KKHIT const* kkhit = kkHit(eff.get());
+      if(kkhit != 0 && kkhit->unbiasedResid(fittraj_,uresid)) uresids.push_back(uresid);
+    }
+  }
+
+  // resolve the hit ambiguities using the current effect caches, if this meta-iteration has a resolver
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::resolveAmbig(MConfig const& mconfig) {
+    AmbigResolver const* resolver = mconfig.hitUpdater<AmbigResolver>();
+    if(resolver == 0) return;
+    // mark the other effects between hits with null entries: the resolver doesn't group hits across them.  The material of
+    // a hit with material doesn't separate it from the following hits
+    std::vector<KKHIT const*> kkhits;
+    kkhits.reserve(2*thits_.size());
+    for(auto const& eff : effects_) {
+      if(auto kkhit = dynamic_cast<KKHIT const*>(eff.get()))
+	kkhits.push_back(kkhit);
+      else if(auto kkmhit = dynamic_cast<KKMHIT const*>(eff.get()))
+	kkhits.push_back(&kkmhit->hit());
+      else if(kkhits.size() > 0 && kkhits.back() != 0)
+	kkhits.push_back(0);
+    }
+    resolver->resolve(kkhits,reftraj_,mconfig.tpconfig_);
+  }
+
+  // iterate the fit starting from the current result, holding the effect configuration fixed.  Each refit is recorded as an additional meta-iteration
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::refit() {
+    MConfig mconfig = config().schedule().back();
+    mconfig.miter_ = fitStatus().miter_+1;
+    FitStatus fstat(mconfig.miter_);
+    fstat.iter_ = 0; // the effects are already configured: only the reference needs updating
+    history_.push_back(fstat);
+    if(kkconfig_->plevel_ >= KKConfig::basic)std::cout << "Refitting with " << mconfig << std::endl;
+    while(fitStatus().needsFit() && fitStatus().iter_ < config().maxnrefit_) {
+      try {
+	update(fstat,mconfig);
+	fitIteration(fstat,mconfig);
+      } catch (std::exception const& error) {
+	fstat.status_ = FitStatus::failed;
+	fstat.comment_ = error.what();
+      }
+      history_.push_back(fstat);
+    }
+  }
+
+  template <class KTRAJ, class HPOLICY> typename KKTrk<KTRAJ,HPOLICY>::KKEFFCOL::iterator KKTrk<KTRAJ,HPOLICY>::findHitEffect(THIT const* thit) {
+    return std::find_if(effects_.begin(),effects_.end(),[thit](std::unique_ptr<KKEFF> const& eff){
+	KKHIT const* kkhit = kkHit(eff.get());
+	return kkhit != 0 && &*kkhit->tHit() == thit; });
+  }
+
+  template <class KTRAJ, class HPOLICY> typename KKTrk<KTRAJ,HPOLICY>::KKLINEEFF* KKTrk<KTRAJ,HPOLICY>::lineEff(KKEFF* eff) {
+    KKLINEEFF* leff = dynamic_cast<KKLINEEFF*>(eff);
+    return leff != 0 && leff->sensor() != 0 ? leff : 0;
+  }
+
+  template <class KTRAJ, class HPOLICY> typename KKTrk<KTRAJ,HPOLICY>::KKHIT const* KKTrk<KTRAJ,HPOLICY>::kkHit(KKEFF const* eff) {
+    if(auto kkhit = dynamic_cast<KKHIT const*>(eff)) return kkhit;
+    if(auto kkmhit = dynamic_cast<KKMHIT const*>(eff)) return &kkmhit->hit();
+    return 0;
+  }
+
   // single algebraic iteration 
-  template <class KTRAJ> void KKTrk<KTRAJ>::fitIteration(FitStatus& fstat, MConfig const& mconfig) {
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::fitIteration(FitStatus& fstat, MConfig const& mconfig) {
     if(kkconfig_->plevel_ >= KKConfig::complete)std::cout << "Processing fit iteration " << fstat.iter_ << std::endl;
     // reset counters
     fstat.chisq_ = 0.0;
@@ -223,8 +368,9 @@ namespace KinKal {
     // trim the range to the physical elements (past the end sites)
     feff = effects_.begin(); feff++;
     beff = effects_.rbegin(); beff++;
-    fittraj_.front().range().low() = (*feff)->time() - config().tbuff_;
-    fittraj_.back().range().high() = (*beff)->time() + config().tbuff_;
+    // set the back first, so that a single piece is never set to the (open) upper range of the last piece appended
+    fittraj_.back().setRange(TRange(fittraj_.back().range().low(),(*beff)->time() + config().tbuff_));
+    fittraj_.front().setRange(TRange((*feff)->time() - config().tbuff_,fittraj_.front().range().high()));
     // update status.  Convergence criteria is iteration-dependent
     double dchisq = (fstat.chisq_ -fitStatus().chisq_)/fstat.ndof_;
     if (fstat.ndof_ < config().minndof_){
@@ -240,26 +386,81 @@ namespace KinKal {
   }
 
   // update between iterations 
-  template <class KTRAJ> void KKTrk<KTRAJ>::update(FitStatus const& fstat, MConfig const& mconfig) {
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::update(FitStatus const& fstat, MConfig const& mconfig) {
     if(fstat.iter_ < 0) { // 1st iteration of a meta-iteration: update the state
+      // resolve the hit ambiguities from the previous meta-iteration's result, before changing the reference
+      if(mconfig.updatehits_) resolveAmbig(mconfig);
       if(mconfig.miter_ > 0)// if this isn't the 1st meta-iteration, swap the fit trajectory to the reference
 	reftraj_ = fittraj_;
-      for(auto& ieff : effects_ ) ieff->update(reftraj_,mconfig);
+      if(config().batchtpoca_){
+	// update the effects with linear sensors together, then the rest
+	updateSensors(mconfig,true);
+	for(auto& ieff : effects_ ) if(lineEff(ieff.get()) == 0) ieff->update(reftraj_,mconfig);
+      } else
+	for(auto& ieff : effects_ ) ieff->update(reftraj_,mconfig);
     } else {
       //swap the fit trajectory to the reference
       reftraj_ = fittraj_;
       // update the effects to use the new reference
-      for(auto& ieff : effects_) ieff->update(reftraj_);
+      // effects whose reference moved little are only shifted; the rest are updated
+      if(config().batchtpoca_){
+	updateSensors(mconfig,false);
+	for(auto& ieff : effects_) if(lineEff(ieff.get()) == 0 && !ieff->shiftReference(reftraj_)) ieff->update(reftraj_);
+      } else
+	for(auto& ieff : effects_) if(!ieff->shiftReference(reftraj_)) ieff->update(reftraj_);
     }
     // sort the effects by time
     std::sort(effects_.begin(),effects_.end(),KKEFFComp ());
   }
 
-  template<class KTRAJ> bool KKTrk<KTRAJ>::canIterate() const {
+  // update the effects with linear sensors, computing their TPOCA in batches on each reference piece.  If newconfig is
+  // false only the reference has changed, and effects which can just shift their reference are skipped
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::updateSensors(MConfig const& mconfig, bool newconfig) {
+    typedef typename KKLINEEFF::TPOCA TPOCA;
+    // group the effects by the reference piece nearest their previous TOCA
+    std::vector<std::pair<size_t,KKLINEEFF*> > seffs;
+    for(auto& ieff : effects_){
+      KKLINEEFF* leff = lineEff(ieff.get());
+      if(leff != 0 && (newconfig || !ieff->shiftReference(reftraj_))){
+	TPocaHint hint = leff->sensorHint();
+	size_t index = hint.particleHint_ ? reftraj_.nearestIndex(hint.particleToca_) : reftraj_.pieces().size()/2;
+	seffs.emplace_back(index,leff);
+      }
+    }
+    std::stable_sort(seffs.begin(),seffs.end(),[](auto const& a, auto const& b){ return a.first < b.first; });
+    TPocaBatch<KTRAJ> tpbatch(mconfig.tpconfig_);
+    auto ibeg = seffs.begin();
+    while(ibeg != seffs.end()){
+      auto iend = ibeg;
+      tpbatch.clear();
+      while(iend != seffs.end() && iend->first == ibeg->first){
+	tpbatch.addSensor(*iend->second->sensor(),iend->second->sensorHint());
+	iend++;
+      }
+      size_t index = ibeg->first;
+      tpbatch.solve(reftraj_.pieces()[index]);
+      for(size_t isensor=0; isensor < tpbatch.size(); isensor++){
+	KKLINEEFF* eff = ibeg[isensor].second;
+	// solutions that failed or left this piece are recomputed on the full piecewise trajectory
+	bool onpiece = tpbatch.status(isensor) != TPocaBase::pocafailed && reftraj_.nearestIndex(tpbatch.particleToca(isensor)) == index;
+	TPOCA tpoca = onpiece ?
+	  TPOCA(reftraj_,tpbatch.sensor(isensor),tpbatch.particleToca(isensor),tpbatch.sensorToca(isensor),
+	      tpbatch.status(isensor),tpbatch.iterations(isensor),tpbatch.config().precision_) :
+	  TPOCA(reftraj_,tpbatch.sensor(isensor),eff->sensorHint(),mconfig.tpconfig_);
+	if(newconfig)
+	  eff->updateSensor(reftraj_,mconfig,tpoca);
+	else
+	  eff->updateSensor(reftraj_,tpoca);
+      }
+      ibeg = iend;
+    }
+  }
+
+  template <class KTRAJ, class HPOLICY> bool KKTrk<KTRAJ,HPOLICY>::canIterate() const {
     return fitStatus().needsFit() && fitStatus().iter_ < config().maxniter_;
   }
 
-  template<class KTRAJ> bool KKTrk<KTRAJ>::oscillating(FitStatus const& fstat, MConfig const& mconfig) const {
+  template <class KTRAJ, class HPOLICY> bool KKTrk<KTRAJ,HPOLICY>::oscillating(FitStatus const& fstat, MConfig const& mconfig) const {
     if(history_.size()>=3 &&history_[history_.size()-3].miter_ == fstat.miter_ ){
       double d1 = fstat.chisq_ - history_.back().chisq_;
       double d2 = fstat.chisq_ - history_[history_.size()-2].chisq_;
@@ -269,7 +470,7 @@ namespace KinKal {
     return false;
   }
 
-  template <class KTRAJ> void KKTrk<KTRAJ>::createRefTraj(KTRAJ const& seedtraj ) {
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::createRefTraj(KTRAJ const& seedtraj ) {
   // initialize the reftraj
     double tstart = seedtraj.range().low();
     Vec3 bf;
@@ -306,7 +507,7 @@ namespace KinKal {
     }
   }
 
-  template <class KTRAJ> void KKTrk<KTRAJ>::print(std::ostream& ost, int detail) const {
+  template <class KTRAJ, class HPOLICY> void KKTrk<KTRAJ,HPOLICY>::print(std::ostream& ost, int detail) const {
     using std::endl;
     if(detail == KKConfig::minimal) 
       ost <<  fitStatus();
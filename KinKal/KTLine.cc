@@ -0,0 +1,303 @@
+#include "KinKal/KTLine.hh"
+#include <math.h>
+#include <stdexcept>
+
+using namespace std;
+using namespace ROOT::Math;
+
+namespace KinKal {
+  typedef ROOT::Math::SVector<double,3> SVec3;
+  vector<string> KTLine::paramTitles_ = {
+    "Transverse DOCA to Z Axis",
+    "Azimuth of Momentum",
+    "Z at POCA",
+    "Cos Theta",
+    "Momentum Magnitude",
+    "Time at POCA"};
+  vector<string> KTLine::paramNames_ = {
+    "D0","Phi0","Z0","CosTheta","Momentum","Time0"};
+  vector<string> KTLine::paramUnits_ = {
+    "mm","radians","mm","","MeV/c","ns"};
+  string KTLine::trajName_("KTLine");
+  vector<string> const& KTLine::paramNames() { return paramNames_; }
+  vector<string> const& KTLine::paramUnits() { return paramUnits_; }
+  vector<string> const& KTLine::paramTitles() { return paramTitles_; }
+  string const& KTLine::paramName(ParamIndex index) { return paramNames_[static_cast<size_t>(index)];}
+  string const& KTLine::paramUnit(ParamIndex index) { return paramUnits_[static_cast<size_t>(index)];}
+  string const& KTLine::paramTitle(ParamIndex index) { return paramTitles_[static_cast<size_t>(index)];}
+  string const& KTLine::trajName() { return trajName_; }
+
+  KTLine::KTLine( Vec4 const& pos0, Mom4 const& mom0, int charge, double bnom, TRange const& range) : KTLine(pos0,mom0,charge,Vec3(0.0,0.0,bnom),range) {}
+  KTLine::KTLine( Vec4 const& pos0, Mom4 const& mom0, int charge, Vec3 const& bnom, TRange const& trange) : trange_(trange), mass_(mom0.M()), charge_(charge), bnom_(bnom) {
+    param(mom_) = mom0.P();
+    param(cost_) = mom0.Pz()/mom0.P();
+    param(phi0_) = mom0.Phi();
+    updateDerived();
+    double sint = sinTheta();
+    // the parameterization is singular for lines parallel to the Z axis
+    if(sint < 1.0e-8)throw invalid_argument("Line parallel to Z axis");
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    // signed transverse distance to the Z axis, and path length from the input position to the POCA
+    param(d0_) = -pos0.X()*sphi + pos0.Y()*cphi;
+    double slen = -(pos0.X()*cphi + pos0.Y()*sphi)/sint;
+    param(z0_) = pos0.Z() + slen*cost();
+    param(t0_) = pos0.T() + slen/speed(pos0.T());
+  }
+
+  KTLine::KTLine(KTLine const& other, Vec3 const& bnom, double trot) : KTLine(other) {
+    bnom_ = bnom;
+  }
+
+  KTLine::KTLine( PDATA const& pdata, KTLine const& other) : KTLine(other) {
+    setParams(pdata);
+  }
+
+  KTLine::KTLine(StateVector const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range) :
+    KTLine(Vec4(pstate.position().X(),pstate.position().Y(),pstate.position().Z(),time),
+	Mom4(pstate.momentum().X(),pstate.momentum().Y(),pstate.momentum().Z(),mass),
+	charge,bnom,range)
+  {}
+
+  KTLine::KTLine(StateVectorMeasurement const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range) :
+  KTLine(pstate.stateVector(),time,mass,charge,bnom,range) {
+  // derive the parameter space covariance from the global state space covariance
+    DPDS dpds = dPardState(time);
+    pars_.covariance() = ROOT::Math::Similarity(dpds,pstate.stateCovariance());
+  }
+
+  void KTLine::updateDerived() {
+    derived_.sint_ = sqrt(1.0-cost()*cost());
+    derived_.energy_ = sqrt(mom()*mom() + mass_*mass_);
+    derived_.beta_ = mom()/derived_.energy_;
+    derived_.dir_ = Vec3(derived_.sint_*cos(phi0()), derived_.sint_*sin(phi0()), cost());
+  }
+
+  void KTLine::invertCT() {
+    // reverse the direction and time; the POCA stays in place
+    charge_ *= -1;
+    param(t0_) *= -1.0;
+    param(d0_) *= -1.0;
+    param(cost_) *= -1.0;
+    param(phi0_) += phi0() > 0.0 ? -M_PI : M_PI;
+    updateDerived();
+  }
+
+  Vec3 KTLine::pos0() const {
+    return Vec3(-d0()*sin(phi0()), d0()*cos(phi0()), z0());
+  }
+
+  Vec4 KTLine::pos4(double time) const {
+    Vec3 temp = position(time);
+    return Vec4(temp.X(),temp.Y(),temp.Z(),time);
+  }
+
+  void KTLine::position(Vec4& pos) const {
+    Vec3 temp = position(pos.T());
+    pos.SetXYZT(temp.X(),temp.Y(),temp.Z(),pos.T());
+  }
+
+  Vec3 KTLine::position(double time) const {
+    return pos0() + ((time-t0())*speed(time))*dir();
+  }
+
+  void KTLine::positions(double const* times, size_t ntimes, Vec3* pos) const {
+    Vec3 p0 = pos0();
+    Vec3 vel = velocity(t0());
+    for(size_t itime=0;itime<ntimes;itime++)
+      pos[itime] = p0 + (times[itime]-t0())*vel;
+  }
+
+  void KTLine::posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const {
+    dir = this->dir();
+    pos = pos0() + ((time-t0())*speed(time))*dir;
+    acc = Vec3();
+  }
+
+  void KTLine::kinState(double time, KinState& kstate) const {
+    kstate.time_ = time;
+    kstate.speed_ = speed(time);
+    kstate.mom_ = mom();
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    kstate.dirs_[LocalBasis::momdir] = dir();
+    kstate.dirs_[LocalBasis::perpdir] = Vec3(cost()*cphi, cost()*sphi, -sinTheta());
+    kstate.dirs_[LocalBasis::phidir] = Vec3(-sphi, cphi, 0.0);
+    kstate.pos_ = pos0() + ((time-t0())*kstate.speed_)*kstate.dirs_[LocalBasis::momdir];
+    kstate.vel_ = kstate.speed_*kstate.dirs_[LocalBasis::momdir];
+    kstate.acc_ = Vec3();
+  }
+
+  void KTLine::kinState(double time, KinState& kstate, DPDV& dPdM) const {
+    kinState(time,kstate);
+    dPdM = dPardM(time);
+  }
+
+  Mom4 KTLine::momentum(double time) const{
+    Vec3 mom3 = mom()*dir();
+    return Mom4(mom3.X(), mom3.Y(), mom3.Z(), mass_);
+  }
+
+  Vec3 KTLine::direction(double time, LocalBasis::LocDir mdir) const {
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    switch ( mdir ) {
+      case LocalBasis::perpdir: // polar direction
+	return Vec3(cost()*cphi, cost()*sphi, -sinTheta());
+      case LocalBasis::phidir: // azimuthal direction
+	return Vec3(-sphi, cphi, 0.0);
+      case LocalBasis::momdir:
+	return dir();
+      default:
+	throw invalid_argument("Invalid direction");
+    }
+  }
+
+  // derivatives of momentum projected along the given basis WRT the parameters
+  KTLine::DVEC KTLine::momDeriv(double time, LocalBasis::LocDir mdir) const {
+    DPDV dPdM = dPardM(time);
+    auto dir = direction(time,mdir);
+    return mom()*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z()));
+  }
+
+  KTLine::DPDV KTLine::momDerivs(double time) const {
+    KinState kstate;
+    DPDV dPdM, retval;
+    kinState(time,kstate,dPdM);
+    for(int idir=0;idir<LocalBasis::ndir; idir++) {
+      auto const& dir = kstate.direction(static_cast<LocalBasis::LocDir>(idir));
+      retval.Place_in_col(kstate.mom_*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z())),0,idir);
+    }
+    return retval;
+  }
+
+  KTLine::DPDV KTLine::dPardX(double time) const {
+    // euclidean space is column, parameter space is row
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    // derivative of the path length from the position to the POCA
+    SVec3 ds_dX(-cphi/sinTheta(), -sphi/sinTheta(), 0.0);
+    SVec3 dd0_dX(-sphi, cphi, 0.0);
+    SVec3 dz0_dX = SVec3(0.0,0.0,1.0) + cost()*ds_dX;
+    SVec3 dt0_dX = ds_dX/speed(time);
+    KTLine::DPDV dPdX;
+    dPdX.Place_in_row(dd0_dX,d0_,0);
+    dPdX.Place_in_row(dz0_dX,z0_,0);
+    dPdX.Place_in_row(dt0_dX,t0_,0);
+    return dPdX;
+  }
+
+  KTLine::DPDV KTLine::dPardM(double time) const {
+    // euclidean space is column, parameter space is row
+    double sint = sinTheta();
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    double vel = speed(time);
+    // path length from the position at this time to the POCA
+    double slen = -(time-t0())*vel;
+    SVec3 udir(dir().X(), dir().Y(), dir().Z());
+    SVec3 phidir(-sphi, cphi, 0.0);
+    SVec3 zdir(0.0,0.0,1.0);
+    SVec3 dphi0_dM = phidir/(mom()*sint);
+    SVec3 dcost_dM = (zdir - cost()*udir)/mom();
+    SVec3 dmom_dM = udir;
+    SVec3 dd0_dM = (slen/mom())*phidir;
+    SVec3 ds_dM = (-d0()/sint)*dphi0_dM + (slen*cost()/(sint*sint))*dcost_dM;
+    SVec3 dz0_dM = cost()*ds_dM + slen*dcost_dM;
+    double dvdp = CLHEP::c_light*mass_*mass_/pow(energy(time),3);
+    SVec3 dt0_dM = ds_dM/vel - (slen*dvdp/(vel*vel))*udir;
+    KTLine::DPDV dPdM;
+    dPdM.Place_in_row(dd0_dM,d0_,0);
+    dPdM.Place_in_row(dphi0_dM,phi0_,0);
+    dPdM.Place_in_row(dz0_dM,z0_,0);
+    dPdM.Place_in_row(dcost_dM,cost_,0);
+    dPdM.Place_in_row(dt0_dM,t0_,0);
+    dPdM.Place_in_row(dmom_dM,mom_,0);
+    return dPdM;
+  }
+
+  KTLine::DVDP KTLine::dXdPar(double time) const {
+    // euclidean space is row, parameter space is column
+    double sint = sinTheta();
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    double dt = time-t0();
+    double vel = speed(time);
+    double len = dt*vel;
+    SVec3 udir(dir().X(), dir().Y(), dir().Z());
+    SVec3 dX_dd0(-sphi, cphi, 0.0);
+    SVec3 dX_dphi0(-d0()*cphi - len*sint*sphi, -d0()*sphi + len*sint*cphi, 0.0);
+    SVec3 dX_dz0(0.0,0.0,1.0);
+    SVec3 dX_dcost = len*SVec3(-cost()*cphi/sint, -cost()*sphi/sint, 1.0);
+    SVec3 dX_dt0 = -vel*udir;
+    SVec3 dX_dmom = (dt*CLHEP::c_light*mass_*mass_/pow(energy(time),3))*udir;
+    KTLine::DVDP dXdP;
+    dXdP.Place_in_col(dX_dd0,0,d0_);
+    dXdP.Place_in_col(dX_dphi0,0,phi0_);
+    dXdP.Place_in_col(dX_dz0,0,z0_);
+    dXdP.Place_in_col(dX_dcost,0,cost_);
+    dXdP.Place_in_col(dX_dt0,0,t0_);
+    dXdP.Place_in_col(dX_dmom,0,mom_);
+    return dXdP;
+  }
+
+  KTLine::DVDP KTLine::dMdPar(double time) const {
+    double sint = sinTheta();
+    double sphi = sin(phi0());
+    double cphi = cos(phi0());
+    SVec3 dM_dphi0 = mom()*sint*SVec3(-sphi, cphi, 0.0);
+    SVec3 dM_dcost = mom()*SVec3(-cost()*cphi/sint, -cost()*sphi/sint, 1.0);
+    SVec3 dM_dmom(dir().X(), dir().Y(), dir().Z());
+    KTLine::DVDP dMdP;
+    dMdP.Place_in_col(dM_dphi0,0,phi0_);
+    dMdP.Place_in_col(dM_dcost,0,cost_);
+    dMdP.Place_in_col(dM_dmom,0,mom_);
+    return dMdP;
+  }
+
+  DSDP KTLine::dPardState(double time) const{
+  // aggregate state from separate X and M derivatives; parameter space is row
+    KTLine::DPDV dPdX = dPardX(time);
+    KTLine::DPDV dPdM = dPardM(time);
+    DPDS dpds;
+    dpds.Place_at(dPdX,0,0);
+    dpds.Place_at(dPdM,0,3);
+    return dpds;
+  }
+
+  DPDS KTLine::dStatedPar(double time) const {
+  // aggregate state from separate X and M derivatives; parameter space is column
+    KTLine::DVDP dXdP = dXdPar(time);
+    KTLine::DVDP dMdP = dMdPar(time);
+    DSDP dsdp;
+    dsdp.Place_at(dXdP,0,0);
+    dsdp.Place_at(dMdP,3,0);
+    return dsdp;
+  }
+
+  StateVector KTLine::state(double time) const {
+    return StateVector(position(time),momentum(time).Vect());
+  }
+
+  StateVectorMeasurement KTLine::measurementState(double time) const {
+  // express the parameter space covariance in global state space
+    DSDP dsdp = dStatedPar(time);
+    return StateVectorMeasurement(state(time),ROOT::Math::Similarity(dsdp,pars_.covariance()));
+  }
+
+  void KTLine::print(ostream& ost, int detail) const {
+    auto perr = params().diagonal();
+    ost << " KTLine " << range() << " parameters: ";
+    for(size_t ipar=0;ipar < KTLine::npars_;ipar++){
+      ost << KTLine::paramName(static_cast<KTLine::ParamIndex>(ipar) ) << " " << paramVal(ipar) << " +- " << perr(ipar);
+      if(ipar < KTLine::npars_-1) ost << " ";
+    }
+    ost << " with nominal BField " << bnom_ << endl;
+  }
+
+  ostream& operator <<(ostream& ost, KTLine const& ktline) {
+    ktline.print(ost,0);
+    return ost;
+  }
+
+} // KinKal namespace
@@ -0,0 +1,153 @@
+#ifndef KinKal_KTLine_hh
+#define KinKal_KTLine_hh
+//
+// class describing a linear kinematic trajectory (constant momentum), for the kinematic Kalman fit.
+// It provides geometric, kinematic, and algebraic representation of a particle moving in a straight line,
+// ie a field-free track or the stiff limit of a helix.  The nominal BField is carried to satisfy the KKTrk
+// interface but does not affect the trajectory; field effects must be modeled as explicit corrections.
+// The parameters are defined at the point of closest approach to the Z axis
+// Adapted from LHelix (David Brown, LBNL)
+//
+
+#include "KinKal/Vectors.hh"
+#include "KinKal/TRange.hh"
+#include "KinKal/PData.hh"
+#include "KinKal/LocalBasis.hh"
+#include "KinKal/KinState.hh"
+#include "KinKal/StateVector.hh"
+#include "KinKal/BField.hh"
+#include "CLHEP/Units/PhysicalConstants.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+namespace KinKal {
+
+  class KTLine {
+    public:
+      // This class must provide the following to be used to instantiate the
+      // classes implementing the Kalman fit
+      // define the indices and names of the parameters
+      enum ParamIndex {d0_=0,phi0_=1,z0_=2,cost_=3,mom_=4,t0_=5,npars_=6};
+      constexpr static size_t NParams() { return npars_; }
+      typedef PData<npars_> PDATA; // Data payload for this class
+      typedef typename PDATA::DVEC DVEC; // derivative of parameters type
+      static std::vector<std::string> const& paramNames();
+      static std::vector<std::string> const& paramUnits();
+      static std::vector<std::string> const& paramTitles();
+      static std::string const& paramName(ParamIndex index);
+      static std::string const& paramUnit(ParamIndex index);
+      static std::string const& paramTitle(ParamIndex index);
+      static std::string const& trajName();
+
+      typedef ROOT::Math::SMatrix<double,npars_,3,ROOT::Math::MatRepStd<double,npars_,3> > DPDV; // parameter derivatives WRT space dimension type
+      typedef ROOT::Math::SMatrix<double,3,npars_,ROOT::Math::MatRepStd<double,3,npars_> > DVDP; // space dimension derivatives WRT parameter type
+
+      // interface needed for KKTrk instantiation
+      // construct from momentum, position, and particle properties.
+      // The nominal BField can be a vector (3d) or a scalar (B along z); it doesn't affect the trajectory
+      KTLine(Vec4 const& pos, Mom4 const& mom, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      KTLine(Vec4 const& pos, Mom4 const& mom, int charge, double bnom, TRange const& range=TRange());
+      // construct from the particle state at a given time, plus mass and charge
+      KTLine(StateVector const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      // same, including covariance information
+      KTLine(StateVectorMeasurement const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      // copy payload and change the nominal BField; the parameters are unchanged
+      KTLine(KTLine const& other, Vec3 const& bnom, double trot);
+      // copy payload and override the parameters
+      KTLine(PDATA const& pdata, KTLine const& other);
+      Vec4 pos4(double time) const;
+      void position(Vec4& pos) const; // time of pos is input
+      Vec3 position(double time) const;
+      // positions at many times together
+      void positions(double const* times, size_t ntimes, Vec3* pos) const;
+      void positions(std::vector<double> const& times, std::vector<Vec3>& pos) const {
+	pos.resize(times.size());
+	positions(times.data(),times.size(),pos.data()); }
+      Vec3 velocity(double time) const { return speed(time)*dir(); }
+      // position, direction, and acceleration at the given time, evaluated together
+      void posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const;
+      // full kinematic state at the given time, evaluated together.  The 2nd form also returns the parameter derivatives WRT momentum (see dPardM)
+      void kinState(double time, KinState& kstate) const;
+      void kinState(double time, KinState& kstate, DPDV& dPdM) const;
+      double speed(double time) const  {  return CLHEP::c_light*beta(); }
+      void print(std::ostream& ost, int detail) const;
+      TRange const& range() const { return trange_; }
+      TRange& range() { return trange_; }
+      void setRange(TRange const& trange) { trange_ = trange; }
+      // allow resetting the BField.  This has no effect on the parameters
+      void setBNom(double time, Vec3 const& bnom) { bnom_ = bnom; }
+      bool inRange(double time) const { return trange_.inRange(time); }
+      Mom4 momentum(double time) const;
+      double momentumMag(double time) const  { return  mom(); }
+      double momentumVar(double time) const  { return params().covariance()(mom_,mom_); }
+      double energy(double time) const  { return  derived().energy_; }
+      Vec3 direction(double time, LocalBasis::LocDir mdir= LocalBasis::momdir) const;
+      double mass() const { return mass_;} // mass
+      int charge() const { return charge_;} // charge in proton charge units
+      double paramVal(size_t index) const { return pars_.parameters()[index]; }
+      PDATA const& params() const { return pars_; }
+      // replace the parameters, updating the direction and kinematics that depend on them
+      void setParams(PDATA const& pdata) { pars_ = pdata; updateDerived(); }
+      // named parameter accessors
+      double d0() const { return paramVal(d0_); }
+      double phi0() const { return paramVal(phi0_); }
+      double z0() const { return paramVal(z0_); }
+      double cost() const { return paramVal(cost_); }
+      double t0() const { return paramVal(t0_); }
+      double mom() const { return paramVal(mom_); }
+      // express fit results as a state vector (global coordinates)
+      StateVector state(double time) const;
+      StateVectorMeasurement measurementState(double time) const;
+
+      // simple functions; those needing square roots are cached, see derived()
+      double sinTheta() const { return derived().sint_; }
+      Vec3 const& dir() const { return derived().dir_; } // momentum direction
+      double beta() const { return derived().beta_; } // relativistic beta
+      double gamma() const { return derived().energy_/mass_; } // relativistic gamma
+      double betaGamma() const { return mom()/mass_; } // relativistic betagamma
+      double ztime(double zpos) const { return t0() + (zpos-z0())/(speed(t0())*cost()); }
+      Vec3 const& bnom(double time=0.0) const { return bnom_; }
+      double bnomR() const { return bnom_.R(); }
+      // flip the line in time and charge; it remains unchanged geometrically
+      void invertCT();
+      // functions related to euclidean space to parameter space derivatives
+      DPDV dPardX(double time) const; // return the derivative of the parameters WRT the (global) position vector
+      DPDV dPardM(double time) const; // return the derivative of the parameters WRT the (global) momentum vector
+      DVDP dXdPar(double time) const; // return the derivative of the (global) position vector WRT the parameters
+      DVDP dMdPar(double time) const; // return the derivative of the (global) momentum vector WRT parameters
+      DSDP dPardState(double time) const; // derivative of parameters WRT global state
+      DPDS dStatedPar(double time) const; // derivative of global state WRT parameters
+      DVEC momDeriv(double time, LocalBasis::LocDir mdir) const; // projection of M derivatives onto direction basis
+      DPDV momDerivs(double time) const; // momDeriv for all the direction basis directions, as columns, sharing the dPardM evaluation
+      // Parameter derivatives given a change in BField.  These are intentionally null: a line doesn't depend on the field,
+      // so KKBField effects on a KTLine fit have no parameter change.  Field effects must be modeled explicitly if needed
+      DVEC dPardB(double time) const { return DVEC(); }
+      DVEC dPardB(double time, Vec3 const& BPrime) const { return DVEC(); }
+    private :
+      // direction and kinematics, functions of phi0, cost and mom only.  They are set by the constructors, setParams
+      // and invertCT, the only members that change those parameters
+      struct Derived {
+	double sint_, energy_, beta_;
+	Vec3 dir_;
+      };
+      Derived const& derived() const { return derived_; }
+      void updateDerived();
+      Vec3 pos0() const; // position at t0
+
+      TRange trange_;
+      PDATA pars_; // parameters
+      double mass_;  // in units of MeV/c^2
+      int charge_; // charge in units of proton charge
+      Vec3 bnom_; // nominal BField, in global coordinate system
+      Derived derived_ = {0.0,0.0,0.0,Vec3()};
+      static std::vector<std::string> paramTitles_;
+      static std::vector<std::string> paramNames_;
+      static std::vector<std::string> paramUnits_;
+      static std::string trajName_;
+      // non-const accessors
+      double& param(size_t index) { return pars_.parameters()[index]; }
+ };
+  std::ostream& operator <<(std::ostream& ost, KTLine const& ktline);
+}
+#endif
@@ -0,0 +1,25 @@
+#ifndef KinKal_KinState_hh
+#define KinKal_KinState_hh
+//
+// Kinematic state of a particle trajectory at a given time: position, velocity, acceleration and the local direction basis.
+// These are evaluated together by the trajectory (ie LHelix::kinState), sharing the phase computation, for callers that
+// need several of them at the same time.
+// Used as part of the kinematic Kalman fit
+//
+#include "KinKal/Vectors.hh"
+#include "KinKal/LocalBasis.hh"
+#include <array>
+namespace KinKal {
+  struct KinState {
+    double time_; // time the state was evaluated at
+    Vec3 pos_; // position
+    Vec3 vel_; // velocity
+    Vec3 acc_; // acceleration
+    std::array<Vec3,LocalBasis::ndir> dirs_; // direction basis, indexed by LocalBasis::LocDir
+    double speed_; // speed
+    double mom_; // momentum magnitude
+    Vec3 const& direction(LocalBasis::LocDir mdir=LocalBasis::momdir) const { return dirs_[mdir]; }
+    KinState() : time_(0.0), speed_(0.0), mom_(0.0) {}
+  };
+}
+#endif
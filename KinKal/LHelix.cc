@@ -38,13 +38,11 @@ namespace KinKal {
     // The transform is a pure rotation about the origin
     Vec4 pos(pos0);
     Mom4 mom(mom0);
-    g2l_ = Rotation3D(AxisAngle(Vec3(sin(bnom_.Phi()),-cos(bnom_.Phi()),0.0),bnom_.Theta()));
+    setRotation();
     if(fabs(g2l_(bnom_).Theta()) > 1.0e-6)throw invalid_argument("Rotation Error");
     // to convert global vectors into parameters they must first be rotated into the local system.
     pos = g2l_(pos);
     mom = g2l_(mom);
-    // create inverse rotation; this moves back into the global coordinate system
-    l2g_ = g2l_.Inverse();
     // compute some simple useful parameters
     double pt = mom.Pt(); 
     double phibar = mom.Phi();
@@ -56,6 +54,7 @@ namespace KinKal {
     param(rad_) = -pt*momToRad;
     // longitudinal wavelength
     param(lam_) = -mom.Z()*momToRad;
+    updateDerived();
     // time at z=0
     double om = omega();
     param(t0_) = pos.T() - pos.Z()/(om*lam());
@@ -81,19 +80,33 @@ namespace KinKal {
     pars_.parameters() += dPardB(time,bnom);
     bnom_ = bnom;
     // adjust rotations to global space
+    setRotation();
+    updateDerived();
+  }
+
+  void LHelix::setRotation() {
     g2l_ = Rotation3D(AxisAngle(Vec3(sin(bnom_.Phi()),-cos(bnom_.Phi()),0.0),bnom_.Theta()));
+    // create inverse rotation; this moves back into the global coordinate system
     l2g_ = g2l_.Inverse();
+    zaligned_ = bnom_.X() == 0.0 && bnom_.Y() == 0.0 && bnom_.Z() > 0.0;
+  }
+
+  void LHelix::updateDerived() {
+    derived_.pbar_ = sqrt(pbar2());
+    derived_.ebar_ = sqrt(ebar2());
+    derived_.omega_ = CLHEP::c_light*sign()/derived_.ebar_;
+    derived_.beta_ = derived_.pbar_/derived_.ebar_;
   }
 
   LHelix::LHelix(LHelix const& other, Vec3 const& bnom, double trot) : LHelix(other) {
     bnom_ = bnom;
     pars_.parameters() += other.dPardB(trot,bnom);
-    g2l_ = Rotation3D(AxisAngle(Vec3(sin(bnom_.Phi()),-cos(bnom_.Phi()),0.0),bnom_.Theta()));
-    l2g_ = g2l_.Inverse();
+    setRotation();
+    updateDerived();
   }
 
   LHelix::LHelix( PDATA const& pdata, LHelix const& other) : LHelix(other) {
-    pars_ = pdata;
+    setParams(pdata);
   }
 
   LHelix::LHelix(StateVector const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range) :
@@ -128,9 +141,72 @@ namespace KinKal {
   Vec3 LHelix::position(double time) const {
     double df = dphi(time);
     double phival = df + phi0();
-    return l2g_(Vec3(cx() + rad()*sin(phival), cy() - rad()*cos(phival), df*lam()));
+    return toGlobal(Vec3(cx() + rad()*sin(phival), cy() - rad()*cos(phival), df*lam()));
   } 
 
+  void LHelix::positions(double const* times, size_t ntimes, Vec3* pos) const {
+    // hoist the parameters out of the loop, leaving only the phase trigonometry per time
+    double omval = omega();
+    double rval = rad(), lamval = lam(), cxval = cx(), cyval = cy(), phi0val = phi0(), t0val = t0();
+    for(size_t itime=0;itime<ntimes;itime++){
+      double df = omval*(times[itime]-t0val);
+      double phival = df + phi0val;
+      pos[itime].SetXYZ(cxval + rval*sin(phival), cyval - rval*cos(phival), df*lamval);
+    }
+    if(!zaligned_){
+      for(size_t itime=0;itime<ntimes;itime++)
+	pos[itime] = l2g_(pos[itime]);
+    }
+  }
+
+  void LHelix::posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const {
+    double omval = omega();
+    double df = omval*(time-t0());
+    double phival = df + phi0();
+    double sphi = sin(phival);
+    double cphi = cos(phival);
+    double invpb = sign()/pbar();
+    double racc = rad()*omval*omval; // centripetal acceleration
+    pos = toGlobal(Vec3(cx() + rad()*sphi, cy() - rad()*cphi, df*lam()));
+    dir = toGlobal(Vec3(rad()*cphi*invpb, rad()*sphi*invpb, lam()*invpb));
+    acc = toGlobal(Vec3(-racc*sphi, racc*cphi, 0.0));
+  }
+
+  void LHelix::kinState(double time, KinState& kstate) const {
+    double dt = time-t0();
+    double phival = omega()*dt + phi0();
+    fillKinState(time,dt,sin(phival),cos(phival),kstate);
+  }
+
+  void LHelix::kinState(double time, KinState& kstate, DPDV& dPdM) const {
+    double dt = time-t0();
+    double phival = omega()*dt + phi0();
+    double sphi = sin(phival);
+    double cphi = cos(phival);
+    fillKinState(time,dt,sphi,cphi,kstate);
+    dPdM = dPardMLoc(dt,sphi,cphi);
+    if(!zaligned_){
+      RMAT g2lmat;
+      g2l_.GetRotationMatrix(g2lmat);
+      dPdM = dPdM*g2lmat;
+    }
+  }
+
+  void LHelix::fillKinState(double time, double dt, double sphi, double cphi, KinState& kstate) const {
+    double omval = omega();
+    double invpb = sign()/pbar();
+    double racc = rad()*omval*omval; // centripetal acceleration
+    kstate.time_ = time;
+    kstate.speed_ = speed(time);
+    kstate.mom_ = momentumMag(time);
+    kstate.pos_ = toGlobal(Vec3(cx() + rad()*sphi, cy() - rad()*cphi, omval*dt*lam()));
+    kstate.dirs_[LocalBasis::momdir] = toGlobal(Vec3(rad()*cphi*invpb, rad()*sphi*invpb, lam()*invpb));
+    kstate.dirs_[LocalBasis::perpdir] = toGlobal(Vec3(lam()*cphi*invpb, lam()*sphi*invpb, -rad()*invpb));
+    kstate.dirs_[LocalBasis::phidir] = toGlobal(Vec3(-sphi, cphi, 0.0));
+    kstate.vel_ = kstate.speed_*kstate.dirs_[LocalBasis::momdir];
+    kstate.acc_ = toGlobal(Vec3(-racc*sphi, racc*cphi, 0.0));
+  }
+
   Mom4 LHelix::momentum(double time) const{
     Vec3 dir = direction(time);
     double bgm = betaGamma()*mass_;
@@ -167,7 +243,7 @@ namespace KinKal {
   } 
 
   Vec3 LHelix::direction(double time, LocalBasis::LocDir mdir) const {
-    return l2g_(localDirection(time,mdir));
+    return toGlobal(localDirection(time,mdir));
   }
 
   // derivatives of momentum projected along the given basis WRT the 6 parameters, and the physical direction associated with that
@@ -179,6 +255,17 @@ namespace KinKal {
     return mommag*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z()));
   }
 
+  LHelix::DPDV LHelix::momDerivs(double time) const {
+    KinState kstate;
+    DPDV dPdM, retval;
+    kinState(time,kstate,dPdM);
+    for(int idir=0;idir<LocalBasis::ndir; idir++) {
+      auto const& dir = kstate.direction(static_cast<LocalBasis::LocDir>(idir));
+      retval.Place_in_col(kstate.mom_*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z())),0,idir);
+    }
+    return retval;
+  }
+
   LHelix::DPDV LHelix::dPardXLoc(double time) const {
     // euclidean space is column, parameter space is row
     double omval = omega();
@@ -196,13 +283,14 @@ namespace KinKal {
   }
 
   LHelix::DPDV LHelix::dPardMLoc(double time) const {
-    // euclidean space is column, parameter space is row
-    double omval = omega();
     double dt = time-t0();
-    double dphi = omval*dt;
-    double phival = dphi + phi0();
-    double sphi = sin(phival);
-    double cphi = cos(phival);
+    double phival = omega()*dt + phi0();
+    return dPardMLoc(dt,sin(phival),cos(phival));
+  }
+
+  LHelix::DPDV LHelix::dPardMLoc(double dt, double sphi, double cphi) const {
+    // euclidean space is column, parameter space is row
+    double dphi = omega()*dt;
     double inve2 = 1.0/ebar2();
     SVec3 T2(-sphi,cphi,0.0);
     SVec3 T3(cphi,sphi,0.0);
@@ -227,6 +315,7 @@ namespace KinKal {
 
   LHelix::DPDV LHelix::dPardX(double time) const {
 // rotate into local space
+    if(zaligned_)return dPardXLoc(time);
     RMAT g2lmat;
     g2l_.GetRotationMatrix(g2lmat);
     return dPardXLoc(time)*g2lmat;
@@ -234,6 +323,7 @@ namespace KinKal {
 
   LHelix::DPDV LHelix::dPardM(double time) const {
 // now rotate these into local space
+    if(zaligned_)return dPardMLoc(time);
     RMAT g2lmat;
     g2l_.GetRotationMatrix(g2lmat);
     return dPardMLoc(time)*g2lmat;
@@ -253,7 +343,7 @@ namespace KinKal {
 
   LHelix::DVEC LHelix::dPardB(double time, Vec3 const& BPrime) const {
   // rotate new B field difference into local coordinate system
-    Vec3 dB = g2l_(BPrime-bnom_);
+    Vec3 dB = toLocal(BPrime-bnom_);
     // find the parameter change due to BField magnitude change usng component parallel to the local nominal Bfield (always along z)
     LHelix::DVEC retval = dPardB(time)*dB.Z();
     // find the change in (local) position and momentum due to the rotation implied by the B direction change
@@ -298,6 +388,7 @@ namespace KinKal {
     dXdP.Place_in_col(dX_dphi0,0,phi0_);
     dXdP.Place_in_col(dX_dt0,0,t0_);
 // now rotate these into global space
+    if(zaligned_)return dXdP;
     RMAT l2gmat;
     l2g_.GetRotationMatrix(l2gmat);
     return l2gmat*dXdP;
@@ -325,6 +416,7 @@ namespace KinKal {
     dMdP.Place_in_col(dM_dt0,0,t0_);
     dMdP *= Q(); // scale to momentum
 // now rotate these into global space
+    if(zaligned_)return dMdP;
     RMAT l2gmat;
     l2g_.GetRotationMatrix(l2gmat);
     return l2gmat*dMdP;
@@ -11,6 +11,7 @@
 #include "KinKal/TRange.hh"
 #include "KinKal/PData.hh"
 #include "KinKal/LocalBasis.hh"
+#include "KinKal/KinState.hh"
 #include "KinKal/StateVector.hh"
 #include "KinKal/BField.hh"
 #include "CLHEP/Units/PhysicalConstants.h"
@@ -57,7 +58,17 @@ namespace KinKal {
       Vec4 pos4(double time) const;
       void position(Vec4& pos) const; // time of pos is input 
       Vec3 position(double time) const;
+      // positions at many times together
+      void positions(double const* times, size_t ntimes, Vec3* pos) const;
+      void positions(std::vector<double> const& times, std::vector<Vec3>& pos) const {
+	pos.resize(times.size());
+	positions(times.data(),times.size(),pos.data()); }
       Vec3 velocity(double time) const;
+      // position, direction, and acceleration at the given time, evaluated together
+      void posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const;
+      // full kinematic state at the given time, evaluated together.  The 2nd form also returns the parameter derivatives WRT momentum (see dPardM)
+      void kinState(double time, KinState& kstate) const;
+      void kinState(double time, KinState& kstate, DPDV& dPdM) const;
       double speed(double time) const  {  return CLHEP::c_light*beta(); }
       void print(std::ostream& ost, int detail) const;
       TRange const& range() const { return trange_; }
@@ -75,6 +86,11 @@ namespace KinKal {
       int charge() const { return charge_;} // charge in proton charge units
       double paramVal(size_t index) const { return pars_.parameters()[index]; }
       PDATA const& params() const { return pars_; }
+      // replace the parameters; the parameters can only be changed through this (or setBNom), so that derived() stays consistent
+      void setParams(PDATA const& pdata) { pars_ = pdata; updateDerived(); }
+      // deprecated: direct parameter access is kept for existing clients, use setParams instead.  Changes through this don't refresh
+      // the derived scalars, so they must be followed by setParams(params()) before using the helix.  This isn't marked with the
+      // deprecated attribute, as overload resolution picks it for any read access to a non-const helix
       PDATA& params() { return pars_; }
       // named parameter accessors
       double rad() const { return paramVal(rad_); }
@@ -87,16 +103,16 @@ namespace KinKal {
       StateVector state(double time) const;
       StateVectorMeasurement measurementState(double time) const;
       
-      // simple functions; these can be cached if they cause performance problems
+      // simple functions; those needing square roots are cached, see derived()
       double sign() const { return copysign(1.0,mbar_); } // combined bending sign including Bz and charge
       double pbar2() const { return  rad()*rad() + lam()*lam(); } 
-      double pbar() const { return  sqrt(pbar2()); } // momentum in mm
+      double pbar() const { return  derived().pbar_; } // momentum in mm
       double ebar2() const { return  pbar2() + mbar_*mbar_; }
-      double ebar() const { return  sqrt(ebar2()); } // energy in mm
+      double ebar() const { return  derived().ebar_; } // energy in mm
       double mbar() const { return mbar_; } // mass in mm; includes charge information!
       double Q() const { return mass_/mbar_; } // reduced charge
-      double omega() const { return CLHEP::c_light*sign()/ ebar(); } // rotational velocity, sign set by magnetic force
-      double beta() const { return pbar()/ebar(); } // relativistic beta
+      double omega() const { return derived().omega_; } // rotational velocity, sign set by magnetic force
+      double beta() const { return derived().beta_; } // relativistic beta
       double gamma() const { return fabs(ebar()/mbar_); } // relativistic gamma
       double betaGamma() const { return fabs(pbar()/mbar_); } // relativistic betagamma
       double dphi(double t) const { return omega()*(t - t0()); }
@@ -110,6 +126,7 @@ namespace KinKal {
 	mbar_ *= -1.0;
 	charge_ *= -1;
 	pars_.parameters()[t0_] *= -1.0;
+	updateDerived();
       }
       // functions related to euclidean space to parameter space derivatives
       DPDV dPardX(double time) const; // return the derivative of the parameters WRT the (global) position vector
@@ -119,17 +136,32 @@ namespace KinKal {
       DSDP dPardState(double time) const; // derivative of parameters WRT global state
       DPDS dStatedPar(double time) const; // derivative of global state WRT parameters
       DVEC momDeriv(double time, LocalBasis::LocDir mdir) const; // projection of M derivatives onto direction basis
+      DPDV momDerivs(double time) const; // momDeriv for all the direction basis directions, as columns, sharing the dPardM evaluation
       // package the above for full (global) state
       // Parameter derivatives given a change in BField
       DVEC dPardB(double time) const; // parameter derivative WRT change in BField magnitude
       DVEC dPardB(double time, Vec3 const& BPrime) const; // parameter change given a new BField vector
     private :
+      // scalars derived from rad, lam, and mbar, which need square roots.  They are computed whenever those
+      // change (construction, setParams, setBNom, invertCT), so const access never writes to the helix
+      struct Derived {
+	double pbar_, ebar_, omega_, beta_;
+      };
+      Derived const& derived() const { return derived_; }
+      void updateDerived();
+      // set the rotations between local and global coordinates from bnom_
+      void setRotation();
+      // rotate between local and global coordinates; the rotation is skipped when bnom is along z
+      Vec3 toGlobal(Vec3 const& lvec) const { return zaligned_ ? lvec : l2g_(lvec); }
+      Vec3 toLocal(Vec3 const& gvec) const { return zaligned_ ? gvec : g2l_(gvec); }
 // local coordinate system functions, used internally
       Vec3 localDirection(double time, LocalBasis::LocDir mdir= LocalBasis::momdir) const;
       Vec3 localMomentum(double time) const;
       Vec3 localPosition(double time) const;
       DPDV dPardXLoc(double time) const; // return the derivative of the parameters WRT the local (unrotated) position vector
       DPDV dPardMLoc(double time) const; // return the derivative of the parameters WRT the local (unrotated) momentum vector
+      DPDV dPardMLoc(double dt, double sphi, double cphi) const; // same, given the time WRT t0 and the phase
+      void fillKinState(double time, double dt, double sphi, double cphi, KinState& kstate) const;
       DSDP dPardStateLoc(double time) const; // derivative of parameters WRT local state
 
       TRange trange_;
@@ -139,6 +171,8 @@ namespace KinKal {
       double mbar_;  // reduced mass in units of mm, computed from the mass and nominal field
       Vec3 bnom_; // nominal BField, in global coordinate system
       ROOT::Math::Rotation3D l2g_, g2l_; // rotations between local and global coordinates 
+      bool zaligned_; // bnom is along z, so the rotations are the identity
+      Derived derived_ = {0.0,0.0,0.0,0.0};
       static std::vector<std::string> paramTitles_;
       static std::vector<std::string> paramNames_;
       static std::vector<std::string> paramUnits_;
@@ -0,0 +1,34 @@
+#ifndef KinKal_LineHit_hh
+#define KinKal_LineHit_hh
+//
+//  Interface of time hits measured against a linear sensor (a wire, a scintillator axis).  Their TPOCA can be computed
+//  together with other hits on the same trajectory piece (see TPocaBatch), so they return their sensor, and compute
+//  the residual (and update) from that TPOCA.  KKHit finds this interface by dynamic_cast when it's constructed
+//  Used as part of the kinematic Kalman fit
+//
+#include "KinKal/THit.hh"
+#include "KinKal/TPoca.hh"
+#include "KinKal/TLine.hh"
+
+namespace KinKal {
+  template <class KTRAJ> class LineHit : public THit<KTRAJ> {
+    public:
+      typedef THit<KTRAJ> THIT;
+      typedef typename THIT::PKTRAJ PKTRAJ;
+      typedef typename THIT::RESIDUAL RESIDUAL;
+      typedef typename THIT::DXINGPTR DXINGPTR;
+      typedef TPoca<PKTRAJ,TLine> TPOCA;
+      using THIT::resid;
+      using THIT::update;
+      virtual TLine const& sensor() const = 0;
+      // compute the residual from a TPOCA with the sensor
+      virtual void resid(TPOCA const& tpoca, RESIDUAL& resid) const = 0;
+      // update, and compute the residual, from a TPOCA with the sensor
+      virtual void update(TPOCA const& tpoca, MConfig const& config, RESIDUAL& resid) = 0;
+      virtual ~LineHit(){}
+    protected:
+      LineHit(bool active=true) : THIT(active) {}
+      LineHit(DXINGPTR const& dxing,bool active=true) : THIT(dxing,active) {}
+  };
+}
+#endif
@@ -1,17 +1,39 @@
 #ifndef KinKal_MatXing_hh
 #define KinKal_MatXing_hh
 //
-//  Struct to describe a path crossing a piece of material
+//  Struct to describe a path crossing a piece of material.  The material is referenced
+//  by its handle in the MatDBInfo store
 //
-#include "MatEnv/DetMaterial.hh"
-#include <vector>
+#include "MatEnv/MatHandle.hh"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
 namespace KinKal {
   struct MatXing {
-    MatEnv::DetMaterial const& dmat_; // material
+    MatEnv::MatHandle mat_; // material
     double plen_; // path length through this material
-    MatXing(MatEnv::DetMaterial const& dmat,double plen) : dmat_(dmat), plen_(plen) {}
+    MatXing(MatEnv::MatHandle mat,double plen) : mat_(mat), plen_(plen) {}
+    MatXing() : plen_(0.0) {}
+  };
+  // fixed-capacity crossing collection, so that updating crossings never allocates
+  class MatXingCol {
+    public:
+      static constexpr size_t maxXings = 4;
+      typedef MatXing const* const_iterator;
+      MatXingCol() : nxings_(0) {}
+      void clear() { nxings_ = 0; }
+      void push_back(MatXing const& mxing) {
+	if(nxings_ == maxXings)throw std::length_error("Too many material crossings");
+	xings_[nxings_++] = mxing; }
+      size_t size() const { return nxings_; }
+      bool empty() const { return nxings_ == 0; }
+      MatXing const& operator [] (size_t ixing) const { return xings_[ixing]; }
+      const_iterator begin() const { return xings_.data(); }
+      const_iterator end() const { return xings_.data() + nxings_; }
+    private:
+      std::array<MatXing,maxXings> xings_;
+      size_t nxings_;
   };
-  typedef std::vector<MatXing> MatXingCol;
 }
 #endif
 
@@ -6,6 +6,7 @@
 //
 #include "KinKal/PTTraj.hh"
 #include "KinKal/BField.hh"
+#include "KinKal/KinState.hh"
 #include <stdexcept>
 namespace KinKal {
 
@@ -33,9 +34,10 @@ namespace KinKal {
       double momentumMag(double time) const  { return PTTRAJ::nearestPiece(time).momentumMag(time); }
       double momentumVar(double time) const  { return PTTRAJ::nearestPiece(time).momentumVar(time); }
       double energy(double time) const  { return PTTRAJ::nearestPiece(time).energy(time); }
+      void kinState(double time, KinState& kstate) const { PTTRAJ::nearestPiece(time).kinState(time,kstate); }
       double mass() const { return PTTRAJ::front().mass(); } // this will throw for empty
       double charge() const { return PTTRAJ::front().charge(); } // this will throw for empty 
-      Vec3 const& bnom(double time) const { return PTTRAJ::nearestPiece(time).bnom(); }
+      Vec3 bnom(double time) const { return PTTRAJ::nearestPiece(time).bnom(time); }
   };
 }
 #endif
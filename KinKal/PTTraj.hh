@@ -9,6 +9,7 @@
 #include "KinKal/LocalBasis.hh"
 #include "KinKal/TRange.hh"
 #include <deque>
+#include <vector>
 #include <ostream>
 #include <stdexcept>
 #include <typeinfo>
@@ -21,6 +22,8 @@ namespace KinKal {
       // forward calls to the pieces 
       void position(Vec4& pos) const {nearestPiece(pos.T()).position(pos); }
       Vec3 position(double time) const { return nearestPiece(time).position(time); }
+      // positions at many times together.  The pieces are searched starting from the previous time, so increasing times are most efficient
+      void positions(std::vector<double> const& times, std::vector<Vec3>& pos) const;
       Vec3 velocity(double time) const { return nearestPiece(time).velocity(time); }
       double speed(double time) const { return nearestPiece(time).speed(time); }
       Vec3 direction(double time, LocalBasis::LocDir mdir=LocalBasis::momdir) const { return nearestPiece(time).direction(time,mdir); }
@@ -62,7 +65,7 @@ namespace KinKal {
       throw std::invalid_argument("Invalid Range");
     // update piece range
     pieces_.front().setRange(TRange(trange.low(),pieces_.front().range().high()));
-    pieces_.back().setRange(TRange(pieces_.front().range().low(),trange.high()));
+    pieces_.back().setRange(TRange(pieces_.back().range().low(),trange.high()));
   }
 
   template <class TTRAJ> PTTraj<TTRAJ>::PTTraj(TTRAJ const& piece) : pieces_(1,piece)
@@ -106,8 +109,9 @@ namespace KinKal {
 	if(ipiece == 0){
 	  // update ranges and add the piece
 	  double tmin = std::min(newpiece.range().low(),pieces_.front().range().low());
-	  pieces_.front().range().low() = newpiece.range().high() +TRange::tbuff_; 
+	  pieces_.front().setRange(TRange(newpiece.range().high() +TRange::tbuff_,pieces_.front().range().high()));
 	  pieces_.push_front(newpiece);
+	  // the extension of the new piece is provisional: its range is final once another piece is prepended, or the range is set
 	  pieces_.front().range().low() = tmin;
 	} else {
 	  throw std::invalid_argument("range error");
@@ -143,8 +147,9 @@ namespace KinKal {
 	  // first, make sure we don't loose range
 	  double tmax = std::max(newpiece.range().high(),pieces_.back().range().high());
 	  // truncate the range of the current back to match with the start of the new piece.  Leave a buffer on the upper range to prevent overlap
-	  pieces_.back().range().high() = newpiece.range().low()-TRange::tbuff_;
+	  pieces_.back().setRange(TRange(pieces_.back().range().low(),newpiece.range().low()-TRange::tbuff_));
 	  pieces_.push_back(newpiece);
+	  // the extension of the new piece is provisional: its range is final once another piece is appended, or the range is set
 	  pieces_.back().range().high() = tmax;
 	} else {
 	  throw std::invalid_argument("range error");
@@ -171,6 +176,34 @@ namespace KinKal {
     return retval;
   }
 
+  template <class TTRAJ> void PTTraj<TTRAJ>::positions(std::vector<double> const& times, std::vector<Vec3>& pos) const {
+    if(pieces_.empty())throw std::length_error("Empty PTTraj!");
+    pos.resize(times.size());
+    TRange prange = range();
+    size_t itime(0), ipiece(0);
+    while(itime < times.size()){
+      // find the piece for this time, as in nearestIndex.  For increasing times the scan can continue from the previous piece
+      double time = times[itime];
+      if(itime == 0 || time < times[itime-1] || time <= prange.low() || time >= prange.high())
+	ipiece = nearestIndex(time);
+      else {
+	while(ipiece < pieces_.size() && !pieces_[ipiece].range().inRange(time) && time > pieces_[ipiece].range().high())
+	  ipiece++;
+	if(ipiece == pieces_.size())throw std::range_error("Failed PTraj range search");
+      }
+      // collect the following times belonging to the same piece and evaluate them together
+      size_t iend = itime+1;
+      auto const& piece = pieces_[ipiece];
+      if(ipiece+1 < pieces_.size()){
+	while(iend < times.size() && times[iend] >= time && piece.range().inRange(times[iend]))iend++;
+      } else {
+	while(iend < times.size() && times[iend] >= time)iend++;
+      }
+      piece.positions(times.data()+itime,iend-itime,pos.data()+itime);
+      itime = iend;
+    }
+  }
+
   template <class TTRAJ> double PTTraj<TTRAJ>::gap(size_t ihigh) const {
     double retval(0.0);
     if(ihigh>0 && ihigh < pieces_.size()){
@@ -0,0 +1,455 @@
+#include "KinKal/RKTraj.hh"
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace ROOT::Math;
+
+namespace KinKal {
+  typedef ROOT::Math::SVector<double,3> SVec3;
+  string RKTraj::trajName_("RKTraj");
+  string const& RKTraj::trajName() { return trajName_; }
+
+  namespace {
+    SVec3 cross(SVec3 const& a, SVec3 const& b) {
+      return SVec3(a[1]*b[2]-a[2]*b[1], a[2]*b[0]-a[0]*b[2], a[0]*b[1]-a[1]*b[0]); }
+    // Cash-Karp Runge-Kutta coefficients.  The equations of motion do not depend explicitly on time, so the stage times are not needed
+    const double ck_b[6][5] = {
+      {0.0, 0.0, 0.0, 0.0, 0.0},
+      {1.0/5.0, 0.0, 0.0, 0.0, 0.0},
+      {3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0},
+      {3.0/10.0, -9.0/10.0, 6.0/5.0, 0.0, 0.0},
+      {-11.0/54.0, 5.0/2.0, -70.0/27.0, 35.0/27.0, 0.0},
+      {1631.0/55296.0, 175.0/512.0, 575.0/13824.0, 44275.0/110592.0, 253.0/4096.0}};
+    // 5th order weights, and the difference to the embedded 4th order weights
+    const double ck_c[6] = {37.0/378.0, 0.0, 250.0/621.0, 125.0/594.0, 0.0, 512.0/1771.0};
+    const double ck_dc[6] = {37.0/378.0-2825.0/27648.0, 0.0, 250.0/621.0-18575.0/48384.0,
+      125.0/594.0-13525.0/55296.0, -277.0/14336.0, 512.0/1771.0-0.25};
+  }
+
+  RKTraj::RKTraj( Vec4 const& pos0, Mom4 const& mom0, int charge, double bnom, TRange const& range) : RKTraj(pos0,mom0,charge,Vec3(0.0,0.0,bnom),range) {}
+  RKTraj::RKTraj( Vec4 const& pos0, Mom4 const& mom0, int charge, Vec3 const& bnom, TRange const& trange) : trange_(trange),
+    ref_(pos0,mom0,charge,bnom,trange), tref_(pos0.T()), bfield_(make_shared<UniformBField>(bnom)) {
+    integrate();
+  }
+
+  RKTraj::RKTraj( Vec4 const& pos0, Mom4 const& mom0, int charge, BField const& bfield, TRange const& trange, RKConfig const& config) : trange_(trange),
+    ref_(pos0,mom0,charge,bfield.fieldVect(Vec3(pos0.X(),pos0.Y(),pos0.Z())),trange), tref_(pos0.T()),
+    bfield_(shared_ptr<const BField>(),&bfield), config_(config) {
+    integrate();
+  }
+
+  RKTraj::RKTraj(RKTraj const& other, BField const& bfield) : RKTraj(other) {
+    // the field isn't owned; the path must be integrated through the new field
+    bfield_ = shared_ptr<const BField>(shared_ptr<const BField>(),&bfield);
+    integrate(true);
+  }
+
+  RKTraj::RKTraj( PDATA const& pdata, RKTraj const& other) : RKTraj(other) {
+    setParams(pdata);
+  }
+
+  RKTraj::RKTraj(StateVector const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range) :
+    RKTraj(Vec4(pstate.position().X(),pstate.position().Y(),pstate.position().Z(),time),
+	Mom4(pstate.momentum().X(),pstate.momentum().Y(),pstate.momentum().Z(),mass),
+	charge,bnom,range)
+  {}
+
+  RKTraj::RKTraj(StateVectorMeasurement const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range) :
+  RKTraj(pstate.stateVector(),time,mass,charge,bnom,range) {
+  // derive the parameter space covariance from the global state space covariance
+    DPDS dpds = dPardState(time);
+    // the path doesn't depend on the covariance, so isn't re-integrated
+    ref_.setParams(PDATA(ref_.params().parameters(),ROOT::Math::Similarity(dpds,pstate.stateCovariance())));
+  }
+
+  void RKTraj::invertCT() {
+    // the inverted reference helix passes through the reference point at the opposite time, with the opposite momentum
+    ref_.invertCT();
+    tref_ *= -1.0;
+    integrate(true);
+  }
+
+  void RKTraj::integrate(bool rebuild) {
+    // by default anchor at the reference time, where the state and its derivatives come directly from the reference helix
+    double tanchor = tref_;
+    SVEC sanchor = ref_.state(tref_).state();
+    DSDP dsdp = ref_.dStatedPar(tref_);
+    if(path_ && !rebuild){
+      Path const& oldpath = *path_;
+      double toldanchor = oldpath.nodes_[oldpath.iref_].time_;
+      // keep the anchor inside the range, so that only the range is integrated
+      tanchor = trange_.infinite() ? toldanchor : std::min(std::max(toldanchor,trange_.low()),trange_.high());
+      if(tanchor == toldanchor && oldpath.ipars_ == params().parameters()){
+	// same anchor and parameters: the path only needs extending
+	double tlow, thigh;
+	span(tanchor,tlow,thigh);
+	if(tlow < oldpath.nodes_.front().time_ || thigh > oldpath.nodes_.back().time_){
+	  auto newpath = make_shared<Path>(oldpath);
+	  extend(*newpath,tlow,thigh);
+	  path_ = newpath;
+	}
+	return;
+      }
+      if(tanchor != tref_){
+	// state at the anchor for the parameters the path was integrated with, extending the path to reach it if needed.
+	// The change of parameters moves the reference helix exactly; only the deviation of the path from that helix is
+	// followed linearly, so the update is exact in a uniform field
+	SVEC dsdt;
+	DSDS jac;
+	if(tanchor < oldpath.nodes_.front().time_ || tanchor > oldpath.nodes_.back().time_){
+	  Path extpath(oldpath);
+	  extend(extpath,tanchor,tanchor);
+	  interpolate(extpath,tanchor,sanchor,dsdt,&jac);
+	} else
+	  interpolate(oldpath,tanchor,sanchor,dsdt,&jac);
+	LHelix oldref(ref_);
+	oldref.setParams(PDATA(oldpath.ipars_,params().covariance()));
+	DSDP ddev = jac*oldpath.dsdp_ - oldref.dStatedPar(tanchor);
+	sanchor += ref_.state(tanchor).state() - oldref.state(tanchor).state() + ddev*(params().parameters() - oldpath.ipars_);
+	dsdp = ref_.dStatedPar(tanchor) + ddev;
+	// the momentum magnitude is set by the parameters
+	sanchor.Place_at(sanchor.Sub<SVec3>(3)*(momentumMag(tanchor)/Mag(sanchor.Sub<SVec3>(3))),3);
+      }
+    }
+    auto newpath = make_shared<Path>();
+    newpath->ipars_ = params().parameters();
+    newpath->dsdp_ = dsdp;
+    int ifail(0);
+    newpath->dpds_ = dsdp.Inverse(ifail);
+    if(ifail != 0) throw runtime_error("RKTraj anchor state derivative inversion failure");
+    Node anchor;
+    anchor.time_ = tanchor;
+    anchor.state_ = sanchor;
+    anchor.jac_ = DSDS(SMatrixIdentity());
+    deriv(anchor.state_,anchor.deriv_,&anchor.djac_);
+    newpath->nodes_.push_back(anchor);
+    newpath->iref_ = 0;
+    newpath->hfwd_ = config_.maxstep_/speed(tanchor);
+    newpath->hbwd_ = -newpath->hfwd_;
+    double tlow, thigh;
+    span(tanchor,tlow,thigh);
+    extend(*newpath,tlow,thigh);
+    path_ = newpath;
+  }
+
+  void RKTraj::deriv(SVEC const& state, SVEC& dsdt, DSDS* dfds) const {
+    SVec3 mom = state.Sub<SVec3>(3);
+    double ival = CLHEP::c_light/sqrt(Mag2(mom) + mass()*mass());
+    SVec3 vel = ival*mom;
+    Vec3 pos(state[0],state[1],state[2]);
+    Vec3 bf = bfield_->fieldVect(pos);
+    SVec3 bvec(bf.X(),bf.Y(),bf.Z());
+    // Lorentz force, in MeV/c/ns
+    double kq = CLHEP::c_light*charge()/1000.0;
+    dsdt.Place_at(vel,0);
+    dsdt.Place_at(kq*cross(vel,bvec),3);
+    if(dfds != 0){
+      DSDS& dfdsref = *dfds;
+      dfdsref = DSDS();
+      auto grad = bfield_->fieldGrad(pos);
+      // velocity derivatives WRT momentum: the speed depends on the momentum magnitude
+      double ival2 = ival*ival/(CLHEP::c_light*CLHEP::c_light);
+      for(size_t idim=0;idim<3;idim++){
+	for(size_t jdim=0;jdim<3;jdim++)
+	  dfdsref(idim,jdim+3) = ival*((idim==jdim ? 1.0 : 0.0) - mom[idim]*mom[jdim]*ival2);
+      }
+      for(size_t jdim=0;jdim<3;jdim++){
+	// force derivative WRT position through the field gradient
+	SVec3 dFdx = kq*cross(vel,SVec3(grad(0,jdim),grad(1,jdim),grad(2,jdim)));
+	// force derivative WRT momentum through the velocity
+	SVec3 dFdp = kq*cross(SVec3(dfdsref(0,jdim+3),dfdsref(1,jdim+3),dfdsref(2,jdim+3)),bvec);
+	for(size_t idim=0;idim<3;idim++){
+	  dfdsref(idim+3,jdim) = dFdx[idim];
+	  dfdsref(idim+3,jdim+3) = dFdp[idim];
+	}
+      }
+    }
+  }
+
+  void RKTraj::step(Node const& start, double& hstep, Node& end) const {
+    double pmag = momentumMag(start.time_);
+    // limit the step by the bending angle and the path length
+    double hmax = config_.maxstep_/speed(start.time_);
+    double bendrate = Mag(start.deriv_.Sub<SVec3>(3))/pmag;
+    if(bendrate > 0.0) hmax = std::min(hmax,config_.maxbend_/bendrate);
+    double hval = copysign(std::min(fabs(hstep),hmax),hstep);
+    SVEC kval[6];
+    SVEC send;
+    kval[0] = start.deriv_;
+    while(true){
+      for(size_t istage=1;istage<6;istage++){
+	SVEC sstage = start.state_;
+	for(size_t jstage=0;jstage<istage;jstage++)
+	  if(ck_b[istage][jstage] != 0.0) sstage += (hval*ck_b[istage][jstage])*kval[jstage];
+	deriv(sstage,kval[istage],0);
+      }
+      send = start.state_;
+      SVEC serr;
+      for(size_t istage=0;istage<6;istage++){
+	if(ck_c[istage] != 0.0) send += (hval*ck_c[istage])*kval[istage];
+	if(ck_dc[istage] != 0.0) serr += (hval*ck_dc[istage])*kval[istage];
+      }
+      // momentum errors are converted to position errors over 1 meter
+      double err = std::max(Mag(serr.Sub<SVec3>(0)),1000.0*Mag(serr.Sub<SVec3>(3))/pmag)/config_.tol_;
+      if(err <= 1.0){
+	hstep = hval*std::min(5.0,0.9*pow(std::max(err,1.0e-10),-0.2));
+	break;
+      }
+      hval *= std::max(0.1,0.9*pow(err,-0.25));
+      if(fabs(hval) < 1.0e-12) throw runtime_error("RKTraj integration step underflow");
+    }
+    // the momentum magnitude is conserved
+    send.Place_at(send.Sub<SVec3>(3)*(pmag/Mag(send.Sub<SVec3>(3))),3);
+    end.time_ = start.time_ + hval;
+    end.state_ = send;
+    DSDS aend;
+    deriv(end.state_,end.deriv_,&aend);
+    // integrate the transport Jacobian with RK4, evaluating the linearized motion at the step midpoint from cubic Hermite interpolation
+    SVEC smid = 0.5*(start.state_ + end.state_) + (0.125*hval)*(start.deriv_ - end.deriv_);
+    SVEC dmid;
+    DSDS amid;
+    deriv(smid,dmid,&amid);
+    DSDS k1 = start.djac_;
+    DSDS k2 = amid*(start.jac_ + (0.5*hval)*k1);
+    DSDS k3 = amid*(start.jac_ + (0.5*hval)*k2);
+    DSDS k4 = aend*(start.jac_ + hval*k3);
+    end.jac_ = start.jac_ + (hval/6.0)*(k1 + 2.0*k2 + 2.0*k3 + k4);
+    end.djac_ = aend*end.jac_;
+  }
+
+  void RKTraj::span(double tanchor, double& tlow, double& thigh) const {
+    // an infinite range is only integrated at the anchor
+    tlow = trange_.infinite() ? tanchor : std::max(trange_.low(),tanchor-config_.maxspan_);
+    thigh = trange_.infinite() ? tanchor : std::min(trange_.high(),tanchor+config_.maxspan_);
+  }
+
+  void RKTraj::extend(Path& path, double tlow, double thigh) const {
+    auto& nodes = path.nodes_;
+    while(thigh > nodes.back().time_){
+      if(nodes.size() > config_.maxnodes_) throw runtime_error("RKTraj exceeded maximum number of steps");
+      Node next;
+      step(nodes.back(),path.hfwd_,next);
+      nodes.push_back(next);
+    }
+    while(tlow < nodes.front().time_){
+      if(nodes.size() > config_.maxnodes_) throw runtime_error("RKTraj exceeded maximum number of steps");
+      Node prev;
+      step(nodes.front(),path.hbwd_,prev);
+      nodes.push_front(prev);
+      path.iref_++;
+    }
+    // helices osculating the ends, used outside the path
+    path.ends_.clear();
+    for(size_t iend=0;iend<2;iend++){
+      Node const& node = iend == 0 ? nodes.front() : nodes.back();
+      Vec3 pos(node.state_[0],node.state_[1],node.state_[2]);
+      Vec3 mom(node.state_[3],node.state_[4],node.state_[5]);
+      path.ends_.emplace_back(StateVector(pos,mom),node.time_,mass(),charge(),bfield_->fieldVect(pos));
+      path.endjac_[iend] = path.ends_.back().dPardState(node.time_)*node.jac_;
+    }
+  }
+
+  void RKTraj::interpolate(Path const& path, double time, SVEC& state, SVEC& dsdt, DSDS* jac) const {
+    auto const& nodes = path.nodes_;
+    if(time < nodes.front().time_ || time > nodes.back().time_){
+      // follow the helix osculating the nearest end
+      size_t iend = time < nodes.front().time_ ? 0 : 1;
+      LHelix const& endhel = path.ends_[iend];
+      KinState kstate;
+      endhel.kinState(time,kstate);
+      Vec3 mom = kstate.mom_*kstate.direction();
+      Vec3 dpdt = (energy(time)/CLHEP::c_light)*kstate.acc_;
+      state = SVEC(kstate.pos_.X(),kstate.pos_.Y(),kstate.pos_.Z(),mom.X(),mom.Y(),mom.Z());
+      dsdt = SVEC(kstate.vel_.X(),kstate.vel_.Y(),kstate.vel_.Z(),dpdt.X(),dpdt.Y(),dpdt.Z());
+      if(jac != 0) *jac = endhel.dStatedPar(time)*path.endjac_[iend];
+      return;
+    }
+    if(nodes.size() == 1){
+      state = nodes.front().state_;
+      dsdt = nodes.front().deriv_;
+      if(jac != 0) *jac = nodes.front().jac_;
+      return;
+    }
+    auto inode = upper_bound(nodes.begin(),nodes.end(),time,[](double val, Node const& node){ return val < node.time_; });
+    size_t index = std::distance(nodes.begin(),inode);
+    index = std::min(index == 0 ? 0 : index-1, nodes.size()-2);
+    Node const& n0 = nodes[index];
+    Node const& n1 = nodes[index+1];
+    double hval = n1.time_ - n0.time_;
+    double uval = (time - n0.time_)/hval;
+    double umin = 1.0 - uval;
+    // cubic Hermite basis functions and their derivatives
+    double h00 = (1.0+2.0*uval)*umin*umin;
+    double h10 = uval*umin*umin*hval;
+    double h01 = uval*uval*(3.0-2.0*uval);
+    double h11 = -uval*uval*umin*hval;
+    double d00 = 6.0*uval*(uval-1.0)/hval;
+    double d10 = umin*(1.0-3.0*uval);
+    double d01 = -d00;
+    double d11 = uval*(3.0*uval-2.0);
+    state = h00*n0.state_ + h10*n0.deriv_ + h01*n1.state_ + h11*n1.deriv_;
+    dsdt = d00*n0.state_ + d10*n0.deriv_ + d01*n1.state_ + d11*n1.deriv_;
+    if(jac != 0) *jac = h00*n0.jac_ + h10*n0.djac_ + h01*n1.jac_ + h11*n1.djac_;
+    // the momentum magnitude is conserved
+    state.Place_at(state.Sub<SVec3>(3)*(momentumMag(time)/Mag(state.Sub<SVec3>(3))),3);
+  }
+
+  RKTraj::DSDS RKTraj::transport(double time) const {
+    SVEC state, dsdt;
+    DSDS jac;
+    interpolate(time,state,dsdt,&jac);
+    return jac;
+  }
+
+  Vec4 RKTraj::pos4(double time) const {
+    Vec3 temp = position(time);
+    return Vec4(temp.X(),temp.Y(),temp.Z(),time);
+  }
+
+  void RKTraj::position(Vec4& pos) const {
+    Vec3 temp = position(pos.T());
+    pos.SetXYZT(temp.X(),temp.Y(),temp.Z(),pos.T());
+  }
+
+  Vec3 RKTraj::position(double time) const {
+    SVEC state, dsdt;
+    interpolate(time,state,dsdt);
+    return Vec3(state[0],state[1],state[2]);
+  }
+
+  void RKTraj::positions(double const* times, size_t ntimes, Vec3* pos) const {
+    SVEC state, dsdt;
+    for(size_t itime=0;itime<ntimes;itime++){
+      interpolate(times[itime],state,dsdt);
+      pos[itime] = Vec3(state[0],state[1],state[2]);
+    }
+  }
+
+  void RKTraj::posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const {
+    KinState kstate;
+    kinState(time,kstate);
+    pos = kstate.pos_;
+    dir = kstate.dirs_[LocalBasis::momdir];
+    acc = kstate.acc_;
+  }
+
+  void RKTraj::kinState(double time, KinState& kstate) const {
+    SVEC state, dsdt;
+    interpolate(time,state,dsdt);
+    kstate.time_ = time;
+    kstate.speed_ = speed(time);
+    kstate.mom_ = momentumMag(time);
+    Vec3 mdir = Vec3(state[3],state[4],state[5]).Unit();
+    // the azimuthal direction is defined WRT the reference field direction
+    Vec3 phidir = ref_.bnom().Unit().Cross(mdir).Unit();
+    kstate.dirs_[LocalBasis::momdir] = mdir;
+    kstate.dirs_[LocalBasis::phidir] = phidir;
+    kstate.dirs_[LocalBasis::perpdir] = phidir.Cross(mdir);
+    kstate.pos_ = Vec3(state[0],state[1],state[2]);
+    kstate.vel_ = kstate.speed_*mdir;
+    kstate.acc_ = (CLHEP::c_light/energy(time))*Vec3(dsdt[3],dsdt[4],dsdt[5]);
+  }
+
+  void RKTraj::kinState(double time, KinState& kstate, DPDV& dPdM) const {
+    kinState(time,kstate);
+    dPdM = dPardM(time);
+  }
+
+  Mom4 RKTraj::momentum(double time) const{
+    SVEC state, dsdt;
+    interpolate(time,state,dsdt);
+    return Mom4(state[3],state[4],state[5],mass());
+  }
+
+  Vec3 RKTraj::direction(double time, LocalBasis::LocDir mdir) const {
+    if(mdir >= LocalBasis::ndir) throw invalid_argument("Invalid direction");
+    KinState kstate;
+    kinState(time,kstate);
+    return kstate.dirs_[mdir];
+  }
+
+  double RKTraj::momentumVar(double time) const {
+    Vec3 mdir = direction(time);
+    SVec3 momvec(mdir.X(), mdir.Y(), mdir.Z());
+    DVEC dMdP = momvec*dMdPar(time);
+    return ROOT::Math::Similarity(dMdP,params().covariance());
+  }
+
+  // derivatives of momentum projected along the given basis WRT the parameters
+  RKTraj::DVEC RKTraj::momDeriv(double time, LocalBasis::LocDir mdir) const {
+    DPDV dPdM = dPardM(time);
+    auto dir = direction(time,mdir);
+    return momentumMag(time)*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z()));
+  }
+
+  RKTraj::DPDV RKTraj::momDerivs(double time) const {
+    KinState kstate;
+    DPDV dPdM, retval;
+    kinState(time,kstate,dPdM);
+    for(int idir=0;idir<LocalBasis::ndir; idir++) {
+      auto const& dir = kstate.direction(static_cast<LocalBasis::LocDir>(idir));
+      retval.Place_in_col(kstate.mom_*(dPdM*SVec3(dir.X(), dir.Y(), dir.Z())),0,idir);
+    }
+    return retval;
+  }
+
+  // the state derivatives are the reference helix derivatives at the reference time, transported along the path
+  DPDS RKTraj::dStatedPar(double time) const {
+    DSDS jac = transport(time);
+    return jac*path_->dsdp_;
+  }
+
+  DSDP RKTraj::dPardState(double time) const{
+    DSDS jac = transport(time);
+    int ifail(0);
+    DSDS jacinv = jac.Inverse(ifail);
+    if(ifail != 0) throw runtime_error("RKTraj transport inversion failure");
+    return path_->dpds_*jacinv;
+  }
+
+  RKTraj::DPDV RKTraj::dPardX(double time) const {
+    return dPardState(time).Sub<DPDV>(0,0);
+  }
+
+  RKTraj::DPDV RKTraj::dPardM(double time) const {
+    return dPardState(time).Sub<DPDV>(0,3);
+  }
+
+  RKTraj::DVDP RKTraj::dXdPar(double time) const {
+    return dStatedPar(time).Sub<DVDP>(0,0);
+  }
+
+  RKTraj::DVDP RKTraj::dMdPar(double time) const {
+    return dStatedPar(time).Sub<DVDP>(3,0);
+  }
+
+  StateVector RKTraj::state(double time) const {
+    return StateVector(position(time),momentum(time).Vect());
+  }
+
+  StateVectorMeasurement RKTraj::measurementState(double time) const {
+  // express the parameter space covariance in global state space
+    DSDP dsdp = dStatedPar(time);
+    return StateVectorMeasurement(state(time),ROOT::Math::Similarity(dsdp,params().covariance()));
+  }
+
+  void RKTraj::print(ostream& ost, int detail) const {
+    auto perr = params().diagonal();
+    ost << " RKTraj " << range() << " parameters: ";
+    for(size_t ipar=0;ipar < RKTraj::npars_;ipar++){
+      ost << RKTraj::paramName(static_cast<RKTraj::ParamIndex>(ipar) ) << " " << paramVal(ipar) << " +- " << perr(ipar);
+      if(ipar < RKTraj::npars_-1) ost << " ";
+    }
+    ost << " at reference time " << tref_ << " with reference BField " << ref_.bnom() << endl;
+    if(detail > 0) ost << " integrated from " << anchorTime() << " over [" << path_->nodes_.front().time_ << "," << path_->nodes_.back().time_
+      << "] with " << nSteps() << " steps" << endl;
+  }
+
+  ostream& operator <<(ostream& ost, RKTraj const& rktraj) {
+    rktraj.print(ost,0);
+    return ost;
+  }
+
+} // KinKal namespace
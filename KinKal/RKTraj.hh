@@ -0,0 +1,206 @@
+#ifndef KinKal_RKTraj_hh
+#define KinKal_RKTraj_hh
+//
+// class describing a kinematic trajectory numerically integrated through a (possibly strongly inhomogeneous) BField, for the kinematic Kalman fit.
+// The parameters are those of the looping helix (LHelix) osculating the trajectory at a reference time, computed with the field at that point.
+// The particle state is propagated through the full BField map with an adaptive Runge-Kutta (Cash-Karp 4/5) integration, starting
+// from an anchor time, together with the transport Jacobian (derivative of the state at a time WRT the anchor state).  A single
+// trajectory can then span an inhomogeneous region that would otherwise require many LHelix pieces and KKBField corrections.
+// In a uniform field the trajectory reproduces the reference helix.
+// A new trajectory is anchored at the reference time, where its state is that of the reference helix.  When a range change leaves
+// the anchor outside the range, the trajectory is re-anchored inside it using the current path, so fit pieces copied from a long
+// reference only integrate over their own range.  Away from the reference time a parameter change moves the anchor state exactly
+// as it moves the reference helix; only the deviation of the path from that helix follows the change linearly.
+// The path is integrated when the trajectory is created, and whenever its parameters change (setParams) or its range is set
+// (setRange).  It is never changed afterwards, so const access has no side effects, and copies share it.  Outside the
+// integrated times (which include changes made through the non-const range() accessor) the trajectory follows the helix
+// osculating the nearest end of the path.
+// The BField must outlive the trajectory, unless the trajectory is constructed from a nominal (uniform) field, which it then owns.
+// Used as part of the kinematic Kalman fit
+//
+
+#include "KinKal/Vectors.hh"
+#include "KinKal/TRange.hh"
+#include "KinKal/PData.hh"
+#include "KinKal/LocalBasis.hh"
+#include "KinKal/KinState.hh"
+#include "KinKal/StateVector.hh"
+#include "KinKal/BField.hh"
+#include "KinKal/LHelix.hh"
+#include "CLHEP/Units/PhysicalConstants.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <ostream>
+
+namespace KinKal {
+
+  // configuration of the numerical integration
+  struct RKConfig {
+    double tol_; // maximum position error per step (mm).  Momentum errors are converted to position over 1 meter
+    double maxbend_; // maximum bending angle per step; this also controls the accuracy of the interpolation between steps
+    double maxstep_; // maximum path length per step (mm), to sample the field
+    size_t maxnodes_; // maximum number of steps
+    double maxspan_; // maximum time (ns) integrated on either side of the anchor; this bounds effectively unlimited ranges
+    RKConfig(double tol=1.0e-5, double maxbend=0.1, double maxstep=100.0, size_t maxnodes=100000, double maxspan=100.0) :
+      tol_(tol), maxbend_(maxbend), maxstep_(maxstep), maxnodes_(maxnodes), maxspan_(maxspan) {}
+  };
+
+  class RKTraj {
+    public:
+      // This class must provide the following to be used to instantiate the
+      // classes implementing the Kalman fit
+      // define the indices and names of the parameters.  These are the same as the reference LHelix
+      enum ParamIndex {rad_=0,lam_=1,cx_=2,cy_=3,phi0_=4,t0_=5,npars_=6};
+      constexpr static size_t NParams() { return npars_; }
+      typedef PData<npars_> PDATA; // Data payload for this class
+      typedef typename PDATA::DVEC DVEC; // derivative of parameters type
+      static std::vector<std::string> const& paramNames() { return LHelix::paramNames(); }
+      static std::vector<std::string> const& paramUnits() { return LHelix::paramUnits(); }
+      static std::vector<std::string> const& paramTitles() { return LHelix::paramTitles(); }
+      static std::string const& paramName(ParamIndex index) { return LHelix::paramName(static_cast<LHelix::ParamIndex>(index)); }
+      static std::string const& paramUnit(ParamIndex index) { return LHelix::paramUnit(static_cast<LHelix::ParamIndex>(index)); }
+      static std::string const& paramTitle(ParamIndex index) { return LHelix::paramTitle(static_cast<LHelix::ParamIndex>(index)); }
+      static std::string const& trajName();
+
+      typedef ROOT::Math::SMatrix<double,npars_,3,ROOT::Math::MatRepStd<double,npars_,3> > DPDV; // parameter derivatives WRT space dimension type
+      typedef ROOT::Math::SMatrix<double,3,npars_,ROOT::Math::MatRepStd<double,3,npars_> > DVDP; // space dimension derivatives WRT parameter type
+
+      // interface needed for KKTrk instantiation
+      // construct from momentum, position, and particle properties.  The time of the position is the reference time.
+      // Given a nominal BField the trajectory integrates through that (uniform) field, and so is equivalent to an LHelix
+      RKTraj(Vec4 const& pos, Mom4 const& mom, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      RKTraj(Vec4 const& pos, Mom4 const& mom, int charge, double bnom, TRange const& range=TRange());
+      // same, integrating through a field map.  The reference helix uses the field at the given position
+      RKTraj(Vec4 const& pos, Mom4 const& mom, int charge, BField const& bfield, TRange const& range=TRange(), RKConfig const& config=RKConfig());
+      // construct from the particle state at a given time, plus mass and charge
+      RKTraj(StateVector const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      // same, including covariance information
+      RKTraj(StateVectorMeasurement const& pstate, double time, double mass, int charge, Vec3 const& bnom, TRange const& range=TRange());
+      // copy payload.  The trajectory follows its own field, so a change of nominal BField doesn't affect it
+      RKTraj(RKTraj const& other, Vec3 const& bnom, double trot) : RKTraj(other) {}
+      // copy payload and integrate through a different field.  The parameters and the state at the anchor are unchanged
+      RKTraj(RKTraj const& other, BField const& bfield);
+      // copy payload and override the parameters
+      RKTraj(PDATA const& pdata, RKTraj const& other);
+      Vec4 pos4(double time) const;
+      void position(Vec4& pos) const; // time of pos is input
+      Vec3 position(double time) const;
+      // positions at many times together
+      void positions(double const* times, size_t ntimes, Vec3* pos) const;
+      void positions(std::vector<double> const& times, std::vector<Vec3>& pos) const {
+	pos.resize(times.size());
+	positions(times.data(),times.size(),pos.data()); }
+      Vec3 velocity(double time) const { return speed(time)*direction(time); }
+      // position, direction, and acceleration at the given time, evaluated together
+      void posDirAccel(double time, Vec3& pos, Vec3& dir, Vec3& acc) const;
+      // full kinematic state at the given time, evaluated together.  The 2nd form also returns the parameter derivatives WRT momentum (see dPardM)
+      void kinState(double time, KinState& kstate) const;
+      void kinState(double time, KinState& kstate, DPDV& dPdM) const;
+      // a magnetic field doesn't change the speed
+      double speed(double time) const  {  return CLHEP::c_light*ref_.beta(); }
+      void print(std::ostream& ost, int detail) const;
+      TRange const& range() const { return trange_; }
+      TRange& range() { return trange_; }
+      // set the range and integrate over it
+      void setRange(TRange const& trange) { trange_ = trange; integrate(); }
+      // the field is integrated, so there's no nominal field to reset
+      void setBNom(double time, Vec3 const& bnom) {}
+      bool inRange(double time) const { return trange_.inRange(time); }
+      Mom4 momentum(double time) const;
+      double momentumMag(double time) const  { return ref_.momentumMag(tref_); }
+      double momentumVar(double time) const;
+      double energy(double time) const  { return ref_.energy(tref_); }
+      Vec3 direction(double time, LocalBasis::LocDir mdir= LocalBasis::momdir) const;
+      double mass() const { return ref_.mass();} // mass
+      int charge() const { return ref_.charge();} // charge in proton charge units
+      double paramVal(size_t index) const { return params().parameters()[index]; }
+      PDATA const& params() const { return ref_.params(); }
+      void setParams(PDATA const& pdata) { ref_.setParams(pdata); integrate(); }
+      // named parameter accessors
+      double rad() const { return paramVal(rad_); }
+      double lam() const { return paramVal(lam_); }
+      double cx() const { return paramVal(cx_); }
+      double cy() const { return paramVal(cy_); }
+      double phi0() const { return paramVal(phi0_); }
+      double t0() const { return paramVal(t0_); }
+      // express fit results as a state vector (global coordinates)
+      StateVector state(double time) const;
+      StateVectorMeasurement measurementState(double time) const;
+      // reference helix, time, and field
+      LHelix const& refHelix() const { return ref_; }
+      double refTime() const { return tref_; }
+      // time the integration starts from
+      double anchorTime() const { return path_->nodes_[path_->iref_].time_; }
+      BField const& bField() const { return *bfield_; }
+      RKConfig const& config() const { return config_; }
+      // number of integration steps taken so far
+      size_t nSteps() const { return path_->nodes_.size()-1; }
+      double beta() const { return ref_.beta(); } // relativistic beta
+      double gamma() const { return ref_.gamma(); } // relativistic gamma
+      double betaGamma() const { return ref_.betaGamma(); } // relativistic betagamma
+      // estimate the time the trajectory reaches the given Z from the reference helix
+      double ztime(double zpos) const { return ref_.ztime(zpos); }
+      // the field at the trajectory position
+      Vec3 bnom(double time=0.0) const { return bfield_->fieldVect(position(time)); }
+      double bnomR() const { return ref_.bnomR(); }
+      // flip the trajectory in time and charge; it remains unchanged geometrically
+      void invertCT();
+      // functions related to euclidean space to parameter space derivatives
+      DPDV dPardX(double time) const; // return the derivative of the parameters WRT the (global) position vector
+      DPDV dPardM(double time) const; // return the derivative of the parameters WRT the (global) momentum vector
+      DVDP dXdPar(double time) const; // return the derivative of the (global) position vector WRT the parameters
+      DVDP dMdPar(double time) const; // return the derivative of the (global) momentum vector WRT parameters
+      DSDP dPardState(double time) const; // derivative of parameters WRT global state
+      DPDS dStatedPar(double time) const; // derivative of global state WRT parameters
+      DVEC momDeriv(double time, LocalBasis::LocDir mdir) const; // projection of M derivatives onto direction basis
+      DPDV momDerivs(double time) const; // momDeriv for all the direction basis directions, as columns, sharing the dPardM evaluation
+      // Parameter derivatives given a change in BField.  These are null, as the full field is integrated
+      DVEC dPardB(double time) const { return DVEC(); }
+      DVEC dPardB(double time, Vec3 const& BPrime) const { return DVEC(); }
+    private :
+      typedef ROOT::Math::SMatrix<double,6,6,ROOT::Math::MatRepStd<double,6,6> > DSDS; // transport Jacobian type
+      // integration step end point: state, its time derivative, the transport Jacobian WRT the reference state, and its time derivative
+      struct Node {
+	double time_;
+	SVEC state_, deriv_;
+	DSDS jac_, djac_;
+      };
+      // integrated path, with the parameters it was computed from
+      struct Path {
+	SVEC ipars_; // input parameters
+	DSDP dsdp_; // derivative of the anchor state WRT the parameters
+	DSDP dpds_; // inverse of the above
+	std::deque<Node> nodes_; // steps in time order; the anchor is one of these
+	size_t iref_; // index of the anchor node
+	double hfwd_, hbwd_; // next step sizes in each direction
+	std::vector<LHelix> ends_; // helices osculating the first and last nodes, in the field there
+	DSDS endjac_[2]; // derivative of the end helix parameters WRT the anchor state
+      };
+      // build the path for the current parameters and range, re-anchoring it if needed.  The anchor is reset to the reference time if rebuild is set
+      void integrate(bool rebuild=false);
+      // times to integrate over given the anchor: the range, limited by maxspan
+      void span(double tanchor, double& tlow, double& thigh) const;
+      // extend the given path to cover the time range, and set its end helices
+      void extend(Path& path, double tlow, double thigh) const;
+      // integrate a step
+      void step(Node const& start, double& hstep, Node& end) const;
+      // time derivative of the state and (optionally) its derivative WRT the state
+      void deriv(SVEC const& state, SVEC& dsdt, DSDS* dfds) const;
+      // interpolate the state and its time derivative, and (optionally) the transport Jacobian, between steps.  Outside the path, use the end helices
+      void interpolate(Path const& path, double time, SVEC& state, SVEC& dsdt, DSDS* jac=0) const;
+      void interpolate(double time, SVEC& state, SVEC& dsdt, DSDS* jac=0) const { interpolate(*path_,time,state,dsdt,jac); }
+      DSDS transport(double time) const; // transport Jacobian at the given time
+
+      TRange trange_;
+      LHelix ref_; // reference helix, providing the parameters
+      double tref_; // reference time
+      std::shared_ptr<const BField> bfield_; // field to integrate through
+      RKConfig config_;
+      std::shared_ptr<const Path> path_; // integrated path.  This is replaced, never modified, so copies can share it
+      static std::string trajName_;
+ };
+  std::ostream& operator <<(std::ostream& ost, RKTraj const& rktraj);
+}
+#endif
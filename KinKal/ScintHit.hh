@@ -5,7 +5,7 @@
 //  class representing a timing measurement using scintillator light from a crystal or plastic scintillator
 //  Used as part of the kinematic Kalman fit
 //
-#include "KinKal/THit.hh"
+#include "KinKal/LineHit.hh"
 #include "KinKal/D2T.hh"
 #include "KinKal/TLine.hh"
 #include "KinKal/TPoca.hh"
@@ -13,15 +13,18 @@
 #include <stdexcept>
 namespace KinKal {
 
-  template <class KTRAJ> class ScintHit : public THit<KTRAJ> {
+  template <class KTRAJ> class ScintHit : public LineHit<KTRAJ> {
     public:
       typedef PKTraj<KTRAJ> PKTRAJ;
       typedef Residual<KTRAJ::NParams()> RESIDUAL;
       typedef TPoca<PKTRAJ,TLine> TPOCA;
       typedef typename KTRAJ::DVEC DVEC; 
-      // THit interface overrrides
-      virtual void resid(PKTRAJ const& pktraj, RESIDUAL& resid) const override;
+      // THit and LineHit interface overrrides
+      virtual void resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& resid) const override;
+      virtual void resid(TPOCA const& tpoca, RESIDUAL& resid) const override;
       virtual void update(PKTRAJ const& pktraj, MConfig const& config, RESIDUAL& resid) override;
+      virtual void update(TPOCA const& tpoca, MConfig const& config, RESIDUAL& residual) override { resid(tpoca,residual); }
+      virtual TLine const& sensor() const override { return saxis_; }
       virtual unsigned nDOF() const override { return 1; }
 //      virtual double tension() const override { return tpoca_.doca()/sqrt(wvar_); } 
       virtual double tension() const override { return 0.0; }  // FIXME!
@@ -29,7 +32,7 @@ namespace KinKal {
       // the line encapsulates both the measurement value (through t0), and the light propagation model (through the velocity)
       TLine const& sensorAxis() const { return saxis_; }
       ScintHit(TLine const& sensorAxis, double tvar, double wvar, bool active=true) : 
-	THit<KTRAJ>(active), saxis_(sensorAxis), tvar_(tvar), wvar_(wvar) {}
+	LineHit<KTRAJ>(active), saxis_(sensorAxis), tvar_(tvar), wvar_(wvar) {}
       virtual ~ScintHit(){}
       double timeVariance() const { return tvar_; }
       double widthVariance() const { return wvar_; }
@@ -39,13 +42,18 @@ namespace KinKal {
       double wvar_; // variance in transverse position of the sensor/measurement in mm.  Assumes cylindrical error, Should be more general FIXME!
   };
 
-  template <class KTRAJ> void ScintHit<KTRAJ>::resid(PKTRAJ const& pktraj,  RESIDUAL& resid) const {
-    // compute TPOCA
-    TPocaHint tphint;
-    tphint.particleHint_ = true;
-    tphint.particleToca_ = saxis_.t0();
-    TPOCA tpoca(pktraj,saxis_,tphint);
- 
+  template <class KTRAJ> void ScintHit<KTRAJ>::resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& residual) const {
+    // compute TPOCA, starting from the previous solution if there is one, otherwise the measurement time
+    TPocaHint tphint = residual.tPoca().hint();
+    if(!tphint.particleHint_){
+      tphint.particleHint_ = true;
+      tphint.particleToca_ = saxis_.t0();
+    }
+    TPOCA tpoca(pktraj,saxis_,tphint,tpconfig);
+    resid(tpoca,residual);
+  }
+
+  template <class KTRAJ> void ScintHit<KTRAJ>::resid(TPOCA const& tpoca,  RESIDUAL& resid) const {
     if(tpoca.usable()){
       // residual is just delta-T at POCA. 
       // the variance includes the measurement variance and the tranvserse size (which couples to the relative direction)
@@ -58,7 +66,7 @@ namespace KinKal {
 
   template <class KTRAJ> void ScintHit<KTRAJ>::update(PKTRAJ const& pktraj, MConfig const& mconfig, RESIDUAL& residual) {
   // for now, no updates are needed.  Eventually could be tests for consistency, tension etc FIXME!
-    resid(pktraj,residual);
+    resid(pktraj,mconfig.tpconfig_,residual);
   }
 
   template<class KTRAJ> void ScintHit<KTRAJ>::print(std::ostream& ost, int detail) const {
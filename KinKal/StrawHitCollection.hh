@@ -0,0 +1,198 @@
+#ifndef KinKal_StrawHitCollection_hh
+#define KinKal_StrawHitCollection_hh
+//
+//  Collection of the straw hits of a track, sharing a BField, distance-to-time relationship and straw material description.
+//  The hit state (wire geometry and measured time, ambiguity, activity, null variance, drift field cache and material crossing)
+//  is stored in arrays indexed by hit.  The fit sees the hits through lightweight index handles (StrawHitHandle) implementing
+//  the LineHit interface, which are stored contiguously in the collection.  The handles and their material crossings are given
+//  to the fit as pointers sharing ownership of the collection, so a track needs one allocation instead of one per hit and
+//  crossing.  Fitting these with BorrowedHandles avoids any reference counting.  The physics is the same as StrawHit, except
+//  that AmbigResolver only resolves WireHits: these hits always take their ambiguity from the WireHitUpdater.
+//  Used as part of the kinematic Kalman fit
+//
+#include "KinKal/LineHit.hh"
+#include "KinKal/WireHit.hh"
+#include "KinKal/StrawXing.hh"
+#include "KinKal/StrawMat.hh"
+#include <vector>
+#include <memory>
+#include <limits>
+#include <stdexcept>
+#include <ostream>
+
+namespace KinKal {
+  template <class KTRAJ> class StrawHitCollection;
+
+  // handle to a hit in a StrawHitCollection: all of the hit state is in the collection
+  template <class KTRAJ> class StrawHitHandle : public LineHit<KTRAJ> {
+    public:
+      typedef LineHit<KTRAJ> LHIT;
+      typedef THit<KTRAJ> THIT;
+      typedef typename LHIT::PKTRAJ PKTRAJ;
+      typedef typename LHIT::TPOCA TPOCA;
+      typedef typename LHIT::RESIDUAL RESIDUAL;
+      typedef typename LHIT::DXINGPTR DXINGPTR;
+      typedef StrawHitCollection<KTRAJ> SHCOL;
+      StrawHitHandle(SHCOL& shcol, size_t index) : shcol_(&shcol), index_(index) {}
+      virtual ~StrawHitHandle(){}
+      // THit and LineHit interface overrrides
+      virtual void resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& residual) const override;
+      virtual void resid(TPOCA const& tpoca, RESIDUAL& residual) const override { shcol_->resid(index_,tpoca,residual); }
+      virtual void update(PKTRAJ const& pktraj, MConfig const& mconfig, RESIDUAL& residual) override;
+      virtual void update(TPOCA const& tpoca, MConfig const& mconfig, RESIDUAL& residual) override { shcol_->update(index_,tpoca,mconfig,residual); }
+      virtual TLine const& sensor() const override { return shcol_->wire(index_); }
+      virtual unsigned nDOF() const override { return 1; }
+      virtual double tension() const override { return 0.0; } // check against straw diameter, length, any other measurement content FIXME!
+      virtual bool isActive() const override { return shcol_->isActive(index_); }
+      virtual bool setActivity(bool newstate) override { return shcol_->setActivity(index_,newstate); }
+      virtual DXINGPTR const& detCrossing() const override { return shcol_->detCrossing(index_); }
+      virtual void print(std::ostream& ost=std::cout,int detail=0) const override;
+      // accessors
+      size_t index() const { return index_; }
+      SHCOL const& collection() const { return *shcol_; }
+      LRAmbig ambig() const { return shcol_->ambig(index_); }
+    private:
+      SHCOL* shcol_; // collection holding this hit's state
+      size_t index_; // index of this hit in the collection
+  };
+
+  template <class KTRAJ> class StrawHitCollection {
+    public:
+      typedef THit<KTRAJ> THIT;
+      typedef std::shared_ptr<THIT> THITPTR;
+      typedef std::vector<THITPTR> THITCOL;
+      typedef PKTraj<KTRAJ> PKTRAJ;
+      typedef TPoca<PKTRAJ,TLine> TPOCA;
+      typedef Residual<KTRAJ::NParams()> RESIDUAL;
+      typedef DXing<KTRAJ> DXING;
+      typedef std::shared_ptr<DXING> DXINGPTR;
+      typedef StrawXing<KTRAJ> STRAWXING;
+      typedef StrawHitHandle<KTRAJ> SHHANDLE;
+      StrawHitCollection(BField const& bfield, D2T const& d2t, StrawMat const& smat, double ftol=10.0) :
+	bfield_(bfield), d2t_(d2t), smat_(smat), ftol_(ftol) {}
+      // the handles and crossing pointers refer to this object, so it can't be copied
+      StrawHitCollection(StrawHitCollection const&) = delete;
+      StrawHitCollection& operator = (StrawHitCollection const&) = delete;
+      // reserve space for the expected number of hits
+      void reserve(size_t nhits);
+      // add a hit without material, or with the material crossing found from the TPOCA between the straw and a reference trajectory.
+      // The wire time is the measured time.  The return value is the hit index.  Hits can only be added before the handles are created
+      size_t addHit(TLine const& wire, LRAmbig ambig=LRAmbig::null);
+      size_t addHit(TLine const& wire, TPOCA const& tpoca, LRAmbig ambig=LRAmbig::null);
+      // create the handles of all the hits, and append them to the given hits for fitting.  The handles share ownership of the
+      // collection, which must be managed by the given shared_ptr.  This can only be called once
+      static void createHandles(std::shared_ptr<StrawHitCollection> const& shcol, THITCOL& thits);
+      // accessors
+      size_t size() const { return wires_.size(); }
+      BField const& bField() const { return bfield_; }
+      D2T const& d2T() const { return d2t_; }
+      StrawMat const& strawMat() const { return smat_; }
+      double cellSize() const { return smat_.strawRadius(); }
+      std::vector<SHHANDLE> const& handles() const { return handles_; }
+      // per-hit state
+      TLine const& wire(size_t ihit) const { return wires_[ihit]; }
+      LRAmbig ambig(size_t ihit) const { return ambigs_[ihit]; }
+      void setAmbig(size_t ihit, LRAmbig newambig) { ambigs_[ihit] = newambig; }
+      bool isActive(size_t ihit) const { return actives_[ihit]; }
+      bool setActivity(size_t ihit, bool newstate) { bool retval = newstate == actives_[ihit]; actives_[ihit] = newstate; return retval; }
+      double nullVar(size_t ihit) const { return nullvars_[ihit]; }
+      DXINGPTR const& detCrossing(size_t ihit) const { return dxings_[ihit]; }
+      // residual computation and update of a single hit, from the TPOCA with its wire
+      void resid(size_t ihit, TPOCA const& tpoca, RESIDUAL& residual) const;
+      void update(size_t ihit, TPOCA const& tpoca, MConfig const& mconfig, RESIDUAL& residual);
+    private:
+      static constexpr size_t noxing_ = std::numeric_limits<size_t>::max();
+      BField const& bfield_;
+      D2T const& d2t_;
+      StrawMat const& smat_;
+      double ftol_; // field cache tolerance (mm), see WireFieldCache
+      // per-hit state, indexed by hit
+      std::vector<TLine> wires_; // local linear approximation to each wire, holding the measured time
+      std::vector<LRAmbig> ambigs_; // current ambiguity assignments: can change during a fit
+      std::vector<char> actives_; // activity: can change during a fit
+      std::vector<double> nullvars_; // variance of the error in space for null ambiguity
+      std::vector<WireFieldCache> fcaches_; // drift directions and azimuths
+      std::vector<size_t> ixings_; // index into the material crossings, or noxing_
+      std::vector<DXINGPTR> dxings_; // material crossing pointers given to the fit; null for hits without material
+      // material crossings of the hits that have them
+      std::vector<STRAWXING> xings_;
+      // handles for fitting; these are created once all the hits are added
+      std::vector<SHHANDLE> handles_;
+  };
+
+  template <class KTRAJ> void StrawHitCollection<KTRAJ>::reserve(size_t nhits) {
+    wires_.reserve(nhits);
+    ambigs_.reserve(nhits);
+    actives_.reserve(nhits);
+    nullvars_.reserve(nhits);
+    fcaches_.reserve(nhits);
+    ixings_.reserve(nhits);
+    xings_.reserve(nhits);
+  }
+
+  template <class KTRAJ> size_t StrawHitCollection<KTRAJ>::addHit(TLine const& wire, LRAmbig ambig) {
+    if(handles_.size() > 0) throw std::logic_error("StrawHitCollection: can't add hits after creating handles");
+    size_t ihit = wires_.size();
+    wires_.push_back(wire);
+    ambigs_.push_back(ambig);
+    actives_.push_back(true);
+    nullvars_.push_back(cellSize()*cellSize()/3.0);
+    fcaches_.push_back(WireFieldCache(bfield_,wire));
+    ixings_.push_back(noxing_);
+    return ihit;
+  }
+
+  template <class KTRAJ> size_t StrawHitCollection<KTRAJ>::addHit(TLine const& wire, TPOCA const& tpoca, LRAmbig ambig) {
+    size_t ihit = addHit(wire,ambig);
+    ixings_[ihit] = xings_.size();
+    xings_.push_back(STRAWXING(tpoca,smat_));
+    return ihit;
+  }
+
+  template <class KTRAJ> void StrawHitCollection<KTRAJ>::createHandles(std::shared_ptr<StrawHitCollection> const& shcol, THITCOL& thits) {
+    if(shcol->handles_.size() > 0) throw std::logic_error("StrawHitCollection: handles already created");
+    // the handles and crossings are never resized after this, so the pointers to them stay valid for the lifetime of the collection
+    size_t nhits = shcol->size();
+    shcol->handles_.reserve(nhits);
+    shcol->dxings_.reserve(nhits);
+    thits.reserve(thits.size() + nhits);
+    for(size_t ihit=0;ihit<nhits;ihit++){
+      size_t ixing = shcol->ixings_[ihit];
+      shcol->dxings_.push_back(ixing != noxing_ ? DXINGPTR(shcol,&shcol->xings_[ixing]) : DXINGPTR());
+      shcol->handles_.emplace_back(*shcol,ihit);
+      thits.push_back(THITPTR(shcol,&shcol->handles_.back()));
+    }
+  }
+
+  template <class KTRAJ> void StrawHitCollection<KTRAJ>::resid(size_t ihit, TPOCA const& tpoca, RESIDUAL& residual) const {
+    wireResid(tpoca,ambigs_[ihit],fcaches_[ihit],d2t_,nullvars_[ihit],residual);
+  }
+
+  template <class KTRAJ> void StrawHitCollection<KTRAJ>::update(size_t ihit, TPOCA const& tpoca, MConfig const& mconfig, RESIDUAL& residual) {
+    // find the wire hit updater for this meta-iteration; allow no updater: hits may be frozen this meta-iteration
+    const WireHitUpdater* whupdater = mconfig.hitUpdater<WireHitUpdater>();
+    if(whupdater != 0) setActivity(ihit,whupdater->update(tpoca.doca(),cellSize(),ambigs_[ihit],nullvars_[ihit]));
+    if(tpoca.usable()) fcaches_[ihit].update(bfield_,wires_[ihit],tpoca.sensorPoca().Vect(),tpoca.delta().Vect(),ftol_);
+    resid(ihit,tpoca,residual);
+  }
+
+  template <class KTRAJ> void StrawHitHandle<KTRAJ>::resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& residual) const {
+    // compute TPOCA, starting from the previous solution if there is one
+    TPOCA tpoca(pktraj,sensor(),residual.tPoca().hint(),tpconfig);
+    resid(tpoca,residual);
+  }
+
+  template <class KTRAJ> void StrawHitHandle<KTRAJ>::update(PKTRAJ const& pktraj, MConfig const& mconfig, RESIDUAL& residual) {
+    TPOCA tpoca(pktraj,sensor(),residual.tPoca().hint(),mconfig.tpconfig_);
+    update(tpoca,mconfig,residual);
+  }
+
+  template<class KTRAJ> void StrawHitHandle<KTRAJ>::print(std::ostream& ost, int detail) const {
+    if(this->isActive())
+      ost<<"Active ";
+    else
+      ost<<"Inactive ";
+    ost << " StrawHit " << index_ << " LRAmbig " << ambig() << " " << std::endl;
+  }
+}
+#endif
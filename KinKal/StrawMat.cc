@@ -14,12 +14,10 @@ namespace KinKal {
       double rad = std::min(doca,srad_-thick_);
       retval = 2.0*sqrt(srad2_-rad*rad); 
     } else { 
-      // integrate +- 1 sigma from DOCA.  Restrict rmax to physical values
-      // Note that negative rdmin is handled naturally
-      double rdmax = std::min(rdmax_,(doca+ddoca)/srad_);
-      double rdmin = std::min(std::max(wrad_,doca-ddoca)/srad_,rdmax-thick_);
-      retval = srad_*(asin(rdmax) - asin(rdmin) +
-	  rdmax*sqrt(1.0-rdmax*rdmax) - rdmin*sqrt(1.0-rdmin*rdmin) )/(rdmax-rdmin);
+      // integrate +- 1 sigma from DOCA.
+      double rdmax, rdmin;
+      integrationLimits(doca,ddoca,rdmax,rdmin);
+      retval = nbins_ > 0 ? interpolate(gastable_,rdmax,rdmin) : gasPathInt(rdmax,rdmin);
       if(isnan(retval))throw std::runtime_error("Invalid pathlength");
     }
     // correct for the angle
@@ -35,11 +33,10 @@ namespace KinKal {
       double rad = std::min(doca,srad_-thick_);
       retval = 2.0*thick_*srad_/sqrt(srad2_-rad*rad);
     } else {
-      // integrate +- 1 sigma from DOCA.  Restrict rmax to physical values
-      // Note that negative rdmin is handled naturally
-      double rdmax = std::min(rdmax_,(doca+ddoca)/srad_);
-      double rdmin = std::min(std::max(wrad_,doca-ddoca)/srad_,rdmax-thick_);
-      retval = 2.0*thick_*(asin(rdmax) - asin(rdmin))/(rdmax-rdmin);
+      // integrate +- 1 sigma from DOCA.
+      double rdmax, rdmin;
+      integrationLimits(doca,ddoca,rdmax,rdmin);
+      retval = nbins_ > 0 ? interpolate(walltable_,rdmax,rdmin) : wallPathInt(rdmax,rdmin);
       if(isnan(retval))throw std::runtime_error("Invalid pathlength");
     }
     // correct for the angle
@@ -47,14 +44,73 @@ namespace KinKal {
     return retval;
   }
 
-  void StrawMat::findXings(double doca, double ddoca, double adot, std::vector<MatXing>& mxings) const {
+  void StrawMat::integrationLimits(double doca, double ddoca, double& rdmax, double& rdmin) const {
+    // Restrict rmax to physical values
+    // Note that negative rdmin is handled naturally
+    rdmax = std::min(rdmax_,(doca+ddoca)/srad_);
+    rdmin = std::min(std::max(wrad_,doca-ddoca)/srad_,rdmax-thick_);
+  }
+
+  double StrawMat::gasPathInt(double rdmax, double rdmin) const {
+    return srad_*(asin(rdmax) - asin(rdmin) +
+	rdmax*sqrt(1.0-rdmax*rdmax) - rdmin*sqrt(1.0-rdmin*rdmin) )/(rdmax-rdmin);
+  }
+
+  double StrawMat::wallPathInt(double rdmax, double rdmin) const {
+    return 2.0*thick_*(asin(rdmax) - asin(rdmin))/(rdmax-rdmin);
+  }
+
+  void StrawMat::setPathTable(unsigned nbins) {
+    nbins_ = nbins;
+    gastable_.clear();
+    walltable_.clear();
+    if(nbins_ == 0) return;
+    // The integrals are smooth functions of the (relative) integration limits, which are clipped linear functions
+    // of doca and ddoca.  Tabulate them as functions of the limits, so that the clipping doesn't degrade the
+    // interpolation.  The limits are mapped to u = 1-sqrt(1-r), which removes the square-root behavior of
+    // the integrals as r approaches 1.
+    du_ = (1.0-sqrt(1.0-rdmax_))/nbins_;
+    unsigned nnodes = nbins_+1;
+    gastable_.reserve(nnodes*nnodes);
+    walltable_.reserve(nnodes*nnodes);
+    for(unsigned imin=0;imin<nnodes;imin++){
+      double rdmin = 1.0 - pow(1.0-imin*du_,2);
+      for(unsigned imax=0;imax<nnodes;imax++){
+	double rdmax = 1.0 - pow(1.0-imax*du_,2);
+	if(imax != imin){
+	  gastable_.push_back(gasPathInt(rdmax,rdmin));
+	  walltable_.push_back(wallPathInt(rdmax,rdmin));
+	} else {
+	  // equal limits: use the derivatives of the integrals
+	  gastable_.push_back(2.0*srad_*sqrt(1.0-rdmax*rdmax));
+	  walltable_.push_back(2.0*thick_/sqrt(1.0-rdmax*rdmax));
+	}
+      }
+    }
+  }
+
+  double StrawMat::interpolate(std::vector<double> const& table, double rdmax, double rdmin) const {
+    // bilinear interpolation in the mapped limits.  The error scales as the square of the bin size
+    double umax = (1.0-sqrt(1.0-std::max(rdmax,0.0)))/du_;
+    double umin = (1.0-sqrt(1.0-std::max(rdmin,0.0)))/du_;
+    unsigned imax = std::min(unsigned(umax),nbins_-1);
+    unsigned imin = std::min(unsigned(umin),nbins_-1);
+    double fmax = umax - imax;
+    double fmin = umin - imin;
+    unsigned nnodes = nbins_+1;
+    auto const* t0 = &table[imin*nnodes + imax];
+    auto const* t1 = t0 + nnodes;
+    return (1.0-fmin)*((1.0-fmax)*t0[0] + fmax*t0[1]) + fmin*((1.0-fmax)*t1[0] + fmax*t1[1]);
+  }
+
+  void StrawMat::findXings(double doca, double ddoca, double adot, MatXingCol& mxings) const {
     mxings.clear();
     double wpath = wallPath(doca,ddoca,adot);
-    if(wpath > 0.0) mxings.push_back(MatXing(*wallmat_,wpath));
+    if(wpath > 0.0) mxings.push_back(MatXing(wallmat_,wpath));
     double gpath = gasPath(doca,ddoca,adot);
-    if(gpath > 0.0) mxings.push_back(MatXing(*gasmat_,gpath));
+    if(gpath > 0.0) mxings.push_back(MatXing(gasmat_,gpath));
 // for now, ignore the wire: this should be based on the probability that the wire was hit given doca and ddoca FIXME!
-    if(wrad_<0.0) mxings.push_back(MatXing(*wiremat_,0.0));
+    if(wrad_<0.0) mxings.push_back(MatXing(wiremat_,0.0));
   }
 
 }
@@ -7,14 +7,15 @@
 #include "MatEnv/DetMaterial.hh"
 #include "KinKal/MatXing.hh"
 #include "MatEnv/MatDBInfo.hh"
+#include <vector>
 
 namespace KinKal {
   class StrawMat {
     public:
-    // explicit constructor from geometry and materials
-      StrawMat(double srad, double thick, double wrad,
-	  const MatEnv::DetMaterial *wallmat, const MatEnv::DetMaterial *gasmat, const MatEnv::DetMaterial *wiremat) :
-	srad_(srad), thick_(thick), wrad_(wrad), wallmat_(wallmat), gasmat_(gasmat), wiremat_(wiremat) { 
+    // explicit constructor from geometry and material handles in the given store
+      StrawMat(MatEnv::MatDBInfo const& matdbinfo, double srad, double thick, double wrad,
+	  MatEnv::MatHandle wallmat, MatEnv::MatHandle gasmat, MatEnv::MatHandle wiremat) :
+	srad_(srad), thick_(thick), wrad_(wrad), matdb_(&matdbinfo), wallmat_(wallmat), gasmat_(gasmat), wiremat_(wiremat), nbins_(0) { 
 	  srad2_ = srad_*srad_;
 	  rdmax_ = (srad_ - thick_)/srad_;
 	  wpmax_ = sqrt(8.0*srad_*thick_);
@@ -22,9 +23,9 @@ namespace KinKal {
 	}
       // construct using default materials
       StrawMat(MatEnv::MatDBInfo const& matdbinfo,double srad, double thick, double wrad) :
-	StrawMat(srad,thick,wrad, matdbinfo.findDetMaterial("straw-wall"),
-	matdbinfo.findDetMaterial("straw-gas"),
-	matdbinfo.findDetMaterial("straw-wire")) {}
+	StrawMat(matdbinfo,srad,thick,wrad, matdbinfo.findMaterialHandle("straw-wall"),
+	matdbinfo.findMaterialHandle("straw-gas"),
+	matdbinfo.findMaterialHandle("straw-wire")) {}
       // pathlength through gas, give DOCA to the axis, uncertainty on that,
       // and the dot product of the path direction WRT the axis.
       double gasPath(double doca, double ddoca, double adot) const;
@@ -32,13 +33,18 @@ namespace KinKal {
       double wallPath(double doca, double ddoca, double adot) const; 
       // should add function to compute wire effect (probabilstically) FIXME!
       // find the material crossings given doca and error on doca.  Should allow for straw and wire to have different axes FIXME!
-      void findXings(double doca, double ddoca, double adot, std::vector<MatXing>& mxings) const;
+      void findXings(double doca, double ddoca, double adot, MatXingCol& mxings) const;
+      // Tabulate the +-1 sigma integrated pathlengths using the given number of bins in each dimension, and use
+      // interpolation of these instead of the analytic functions.  0 bins reverts to the analytic functions.
+      void setPathTable(unsigned nbins);
+      unsigned pathTableBins() const { return nbins_; }
       double strawRadius() const { return srad_; }
       double wallThickness() const { return thick_; }
       double wireRadius() const { return wrad_; }
-      MatEnv::DetMaterial const& wallMaterial() const { return *wallmat_; }
-      MatEnv::DetMaterial const& gasMaterial() const { return *gasmat_; }
-      MatEnv::DetMaterial const& wireMaterial() const { return *wiremat_; }
+      MatEnv::MatDBInfo const& materialDB() const { return *matdb_; }
+      MatEnv::DetMaterial const& wallMaterial() const { return matdb_->detMaterial(wallmat_); }
+      MatEnv::DetMaterial const& gasMaterial() const { return matdb_->detMaterial(gasmat_); }
+      MatEnv::DetMaterial const& wireMaterial() const { return matdb_->detMaterial(wiremat_); }
     private:
       double srad_; // outer transverse radius of the straw
       double srad2_; // outer transverse radius of the straw squared
@@ -47,9 +53,20 @@ namespace KinKal {
       double ddmax_; // max ddoca to integrate
       double thick_; // straw wall thickness
       double wrad_; // transverse radius of the wire
-      const MatEnv::DetMaterial* wallmat_; // material of the straw wall
-      const MatEnv::DetMaterial* gasmat_; // material of the straw gas
-      const MatEnv::DetMaterial* wiremat_; // material of the wire
+      const MatEnv::MatDBInfo* matdb_; // material store
+      MatEnv::MatHandle wallmat_; // material of the straw wall
+      MatEnv::MatHandle gasmat_; // material of the straw gas
+      MatEnv::MatHandle wiremat_; // material of the wire
+      // pathlength tables, as a function of the relative integration limits.  Values are without the angle factor
+      unsigned nbins_; // bins in each dimension, 0 means no table
+      double du_; // table spacing
+      std::vector<double> gastable_, walltable_;
+      // relative integration limits for +-1 sigma integration
+      void integrationLimits(double doca, double ddoca, double& rdmax, double& rdmin) const;
+      // analytic integrated pathlengths, without the angle factor
+      double gasPathInt(double rdmax, double rdmin) const;
+      double wallPathInt(double rdmax, double rdmin) const;
+      double interpolate(std::vector<double> const& table, double rdmax, double rdmin) const;
   };
 }
 #endif
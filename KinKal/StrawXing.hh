@@ -25,9 +25,11 @@ namespace KinKal {
       // DXing interface
       virtual void update(PKTRAJ const& pktraj) override;
       virtual void update(PKTRAJ const& pktraj, double xtime) override;
+      virtual void update(PKTRAJ const& pktraj, TPocaBase const& tpoca) override { update(tpoca); }
       // specific interface: this xing is based on TPOCA
-      void update(TPOCA const& tpoca);
+      void update(TPocaBase const& tpoca);
       virtual void print(std::ostream& ost=std::cout,int detail=0) const override;
+      virtual MatEnv::MatDBInfo const& materialDB() const override { return smat_.materialDB(); }
       // accessors
       StrawMat const& strawMat() const { return smat_; }
     private:
@@ -35,7 +37,7 @@ namespace KinKal {
       TLine axis_; // straw axis, expressed as a timeline
   };
 
-  template <class KTRAJ> void StrawXing<KTRAJ>::update(TPOCA const& tpoca) {
+  template <class KTRAJ> void StrawXing<KTRAJ>::update(TPocaBase const& tpoca) {
     if(tpoca.usable()){
       DXING::mxings_.clear();
       smat_.findXings(tpoca.doca(),sqrt(tpoca.docaVar()),tpoca.dirDot(),DXING::mxings_);
@@ -63,7 +65,7 @@ namespace KinKal {
     ost <<"Straw Xing time " << this->crossingTime();
     if(detail > 0){
       for(auto const& mxing : this->matXings()){
-	ost << " " << mxing.dmat_.name() << " pathLen " << mxing.plen_;
+	ost << " " << materialDB().detMaterial(mxing.mat_).name() << " pathLen " << mxing.plen_;
       }
     }
     if(detail > 1){
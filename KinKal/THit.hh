@@ -26,21 +26,22 @@ namespace KinKal {
       // optionally create with an associated detector material crossing
       THit(DXINGPTR const& dxing,bool active=true) : dxing_(dxing), active_(active) {}
       virtual ~THit(){}
-      // compute residual and errors WRT a predicted trajectory
-      virtual void resid(PKTRAJ const& pktraj, RESIDUAL& resid) const =0;
+      // compute residual and errors WRT a predicted trajectory, finding TPOCA with the given configuration.  On input, resid may
+      // hold the previous residual of this hit: its TPOCA is then used as the starting point of the TPOCA search
+      virtual void resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& resid) const =0;
       // count number of degrees of freedom constrained by this measurement (typically 1)
       virtual unsigned nDOF() const = 0;
-      // update, and compute residual
+      // update, and compute residual.  TPOCA is found using the configuration of this meta-iteration
       virtual void update(PKTRAJ const& pktraj, MConfig const& config, RESIDUAL& resid) = 0;
       // consistency of ancillary information not used in the residual computation
       // return value is the dimensionless number of sigma outside range, 0.0 = perfectly consistent, 1.0 is '1 sigma' tension
       virtual double tension() const = 0;
-      // hits may get deactivated during the fit
-      bool isActive() const { return active_; }
-      bool setActivity(bool newstate) { bool retval = newstate == active_; active_ = newstate; return retval; }
-      // associated material information; null use_count means no material
-      DXINGPTR const& detCrossing() const { return dxing_; }
-      bool hasMaterial() const { return dxing_.use_count() > 0; }
+      // hits may get deactivated during the fit.  Hits keeping their state elsewhere (see StrawHitCollection) override these
+      virtual bool isActive() const { return active_; }
+      virtual bool setActivity(bool newstate) { bool retval = newstate == active_; active_ = newstate; return retval; }
+      // associated material information; a null pointer means no material
+      virtual DXINGPTR const& detCrossing() const { return dxing_; }
+      bool hasMaterial() const { return detCrossing() != nullptr; }
       virtual void print(std::ostream& ost=std::cout,int detail=0) const =0;
     private:
       DXINGPTR dxing_;
@@ -20,8 +20,10 @@ namespace KinKal {
       DVEC const& dDdP() const { return dDdP_; }
       DVEC const& dTdP() const { return dTdP_; }
       // construct from the particle and sensor trajectories; POCA is computed on construction, using possible hints
-      // default precision = 1 Ps (~300 um) along the trajectories
-      TPoca(KTRAJ const& ktraj, STRAJ const& straj, TPocaHint const& hint=TPocaHint(), double precision=0.001);
+      // precision and iteration limits are taken from the configuration
+      TPoca(KTRAJ const& ktraj, STRAJ const& straj, TPocaHint const& hint=TPocaHint(), TPocaConfig const& config=TPocaConfig());
+      // construct from a solution found externally (ie by TPocaBatch): only the POCA, DOCA, and derivatives are computed
+      TPoca(KTRAJ const& ktraj, STRAJ const& straj, double ptoca, double stoca, TPStat status, unsigned niter, double precision);
       // accessors
       KTRAJ const& particleTraj() const { return *ktraj_; }
       STRAJ const& sensorTraj() const { return *straj_; }
@@ -32,8 +34,30 @@ namespace KinKal {
       const STRAJ* straj_; // sensor trajectory
       DVEC dDdP_; // derivative of DOCA WRT Parameters
       DVEC dTdP_; // derivative of Dt WRT Parameters
+      // set the POCA from the TOCA values, and compute the DOCA and derivatives.  This must be specialized with the constructor
+      void finalize(double ptoca, double stoca);
+      // copy the POCA state from a TPoca computed on a single piece of this (piecewise) particle trajectory
+      template<class PTPOCA> void copyPiece(PTPOCA const& tpoca);
   };
 
+  template<class KTRAJ, class STRAJ> TPoca<KTRAJ,STRAJ>::TPoca(KTRAJ const& ktraj, STRAJ const& straj, double ptoca, double stoca,
+      TPStat status, unsigned niter, double precision) : TPocaBase(precision), ktraj_(&ktraj), straj_(&straj) {
+    status_ = status;
+    niter_ = niter;
+    if(status_ != pocafailed) finalize(ptoca,stoca);
+  }
+
+  template<class KTRAJ, class STRAJ> template<class PTPOCA> void TPoca<KTRAJ,STRAJ>::copyPiece(PTPOCA const& tpoca) {
+    partPoca_ = tpoca.particlePoca();
+    sensPoca_ = tpoca.sensorPoca();
+    doca_ = tpoca.doca();
+    dDdP_ = tpoca.dDdP();
+    dTdP_ = tpoca.dTdP();
+    docavar_ = tpoca.docaVar();
+    tocavar_ = tpoca.tocaVar();
+    ddot_ = tpoca.dirDot();
+  }
+
   template<class KTRAJ, class STRAJ> void TPoca<KTRAJ,STRAJ>::print(std::ostream& ost,int detail) const {
     ost << "TPoca " << TPocaBase::statusName(status()) << " Doca " << doca() << " +- " << sqrt(docaVar())
       << " dToca " << deltaT() << " +- " << sqrt(tocaVar()) << " cos(theta) " << dirDot() << " Precision " << precision() << std::endl;
@@ -16,6 +16,16 @@ namespace KinKal {
     TPocaHint() : particleHint_(false), sensorHint_(false), particleToca_(0.0), sensorToca_(0.0) {}
   };
 
+  // Configuration of the TPOCA calculation: convergence criterion and iteration limits
+  struct TPocaConfig {
+    double precision_; // convergence criterion on the change in TOCA between iterations (ns)
+    unsigned maxiter_; // maximum number of solver iterations on a single trajectory
+    unsigned maxpieceiter_; // maximum number of pieces visited on a piecewise trajectory
+    // default precision = 1 Ps (~300 um) along the trajectories
+    TPocaConfig(double precision=0.001, unsigned maxiter=100, unsigned maxpieceiter=10) :
+      precision_(precision), maxiter_(maxiter), maxpieceiter_(maxpieceiter) {}
+  };
+
   class TPocaBase {
     public:
       enum TPStat{converged=0,unconverged,pocafailed,derivfailed,invalid,unknown};
@@ -32,16 +42,28 @@ namespace KinKal {
       double tocaVar() const { return tocavar_; } // uncertainty on toca due to particle trajectory parameter uncertainties (NOT sensory uncertainties)
       double dirDot() const { return ddot_; } // cosine of angle between traj directions at POCA
       double precision() const { return precision_; }
+      unsigned iterations() const { return niter_; } // number of iterations used in the computation
+      // hint to start a new computation at this solution, if it converged
+      TPocaHint hint() const {
+	TPocaHint retval;
+	if(status_ == converged){
+	  retval.particleHint_ = retval.sensorHint_ = true;
+	  retval.particleToca_ = particleToca();
+	  retval.sensorToca_ = sensorToca();
+	}
+	return retval;
+      }
       // utility functions
       Vec4 delta() const { return sensPoca_-partPoca_; } // measurement - prediction convention
       double deltaT() const { return sensPoca_.T() - partPoca_.T(); }
       bool usable() const { return status_ != pocafailed && status_ != unknown; }
-      TPocaBase(double precision=1e-2) : status_(invalid), doca_(-1.0), docavar_(-1.0), tocavar_(-1.0), ddot_(-1.0), precision_(precision)  {}
+      TPocaBase(double precision=1e-2) : status_(invalid), doca_(-1.0), docavar_(-1.0), tocavar_(-1.0), ddot_(-1.0), precision_(precision), niter_(0)  {}
     protected:
       TPStat status_; // status of computation
       double doca_, docavar_, tocavar_;
       double ddot_;
       double precision_; // precision used to define convergence
+      unsigned niter_; // iterations used
       Vec4 partPoca_, sensPoca_; //POCA for particle and sensor
       void reset() {status_ = unknown;}
     private:
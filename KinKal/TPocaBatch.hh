@@ -0,0 +1,147 @@
+#ifndef KinKal_TPocaBatch_hh
+#define KinKal_TPocaBatch_hh
+//
+//  Batched TPOCA calculation between a single (simple) particle trajectory and many linear sensors (ie wires).
+//  The sensors and the solver state are stored as structure-of-arrays, and the Newton iteration used by TPoca<KTRAJ,TLine>
+//  advances all the sensors together: the trajectory is evaluated once per sensor per iteration, and the step arithmetic
+//  then runs over contiguous arrays without calls or branches, so that the compiler can vectorize it.
+//  Only the TOCA values are solved for; the DOCA and derivatives of each sensor are computed from the solution by TPoca.
+//  KTRAJ must provide posDirAccel, speed, and ztime
+//  Used as part of the kinematic Kalman fit
+//
+#include "KinKal/TPoca.hh"
+#include "KinKal/TLine.hh"
+#include <vector>
+#include <cmath>
+
+namespace KinKal {
+  template<class KTRAJ> class TPocaBatch {
+    public:
+      typedef TPoca<KTRAJ,TLine> TPOCA;
+      TPocaBatch(TPocaConfig const& config=TPocaConfig()) : config_(config) {}
+      // add a sensor, optionally with a starting point for the search.  The line must outlive the batch
+      void addSensor(TLine const& tline, TPocaHint const& hint=TPocaHint());
+      void clear();
+      size_t size() const { return lines_.size(); }
+      // solve for the TOCA of all the sensors against the given trajectory
+      void solve(KTRAJ const& ktraj);
+      // results for each sensor
+      TLine const& sensor(size_t isensor) const { return *lines_[isensor]; }
+      double particleToca(size_t isensor) const { return htoca_[isensor]; }
+      double sensorToca(size_t isensor) const { return stoca_[isensor]; }
+      TPocaBase::TPStat status(size_t isensor) const { return status_[isensor]; }
+      unsigned iterations(size_t isensor) const { return niter_[isensor]; }
+      TPocaConfig const& config() const { return config_; }
+      // full TPOCA (DOCA and derivatives) of a sensor against the trajectory used in the last solve
+      TPOCA tPoca(KTRAJ const& ktraj, size_t isensor) const {
+	return TPOCA(ktraj,*lines_[isensor],htoca_[isensor],stoca_[isensor],status_[isensor],niter_[isensor],config_.precision_); }
+    private:
+      TPocaConfig config_;
+      std::vector<TLine const*> lines_;
+      std::vector<TPocaHint> hints_;
+      // sensor line parameters
+      std::vector<double> px_, py_, pz_; // reference position
+      std::vector<double> dx_, dy_, dz_; // direction
+      std::vector<double> lt0_, lspeed_; // reference time and speed
+      // solver state
+      std::vector<double> htoca_, stoca_; // current TOCA values
+      std::vector<double> dhtoca_, dstoca_, denom_; // last step and direction test
+      std::vector<TPocaBase::TPStat> status_;
+      std::vector<unsigned> niter_;
+      std::vector<unsigned char> active_; // sensors still iterating
+      // particle trajectory state at the current TOCA
+      std::vector<double> hx_, hy_, hz_, hdx_, hdy_, hdz_, hax_, hay_, haz_;
+  };
+
+  template<class KTRAJ> void TPocaBatch<KTRAJ>::addSensor(TLine const& tline, TPocaHint const& hint) {
+    lines_.push_back(&tline);
+    hints_.push_back(hint);
+    px_.push_back(tline.pos0().X());
+    py_.push_back(tline.pos0().Y());
+    pz_.push_back(tline.pos0().Z());
+    dx_.push_back(tline.dir().X());
+    dy_.push_back(tline.dir().Y());
+    dz_.push_back(tline.dir().Z());
+    lt0_.push_back(tline.t0());
+    lspeed_.push_back(tline.speed());
+  }
+
+  template<class KTRAJ> void TPocaBatch<KTRAJ>::clear() {
+    lines_.clear(); hints_.clear();
+    px_.clear(); py_.clear(); pz_.clear();
+    dx_.clear(); dy_.clear(); dz_.clear();
+    lt0_.clear(); lspeed_.clear();
+  }
+
+  template<class KTRAJ> void TPocaBatch<KTRAJ>::solve(KTRAJ const& ktraj) {
+    size_t nsensor = size();
+    for(auto* vec : {&htoca_, &stoca_, &dhtoca_, &dstoca_, &denom_, &hx_, &hy_, &hz_, &hdx_, &hdy_, &hdz_, &hax_, &hay_, &haz_})
+      vec->resize(nsensor);
+    status_.assign(nsensor,TPocaBase::unconverged);
+    niter_.assign(nsensor,0);
+    active_.assign(nsensor,1);
+    // initialize using hints, as in the single-sensor TPOCA
+    for(size_t isensor=0;isensor<nsensor;isensor++){
+      TPocaHint const& hint = hints_[isensor];
+      htoca_[isensor] = hint.particleHint_ ? hint.particleToca_ : ktraj.ztime(lines_[isensor]->z0());
+      stoca_[isensor] = hint.sensorHint_ ? hint.sensorToca_ : lt0_[isensor];
+    }
+    // speed of a simple trajectory doesn't change
+    double hspeed = ktraj.speed(ktraj.t0());
+    double hspeed2 = hspeed*hspeed;
+    size_t nactive = nsensor;
+    Vec3 hpos, hdir, hacc;
+    for(unsigned iter=0; nactive > 0 && iter < config_.maxiter_; iter++){
+      // evaluate the particle trajectory for the active sensors
+      for(size_t isensor=0;isensor<nsensor;isensor++){
+	if(active_[isensor]){
+	  ktraj.posDirAccel(htoca_[isensor],hpos,hdir,hacc);
+	  hx_[isensor] = hpos.X(); hy_[isensor] = hpos.Y(); hz_[isensor] = hpos.Z();
+	  hdx_[isensor] = hdir.X(); hdy_[isensor] = hdir.Y(); hdz_[isensor] = hdir.Z();
+	  hax_[isensor] = hacc.X(); hay_[isensor] = hacc.Y(); haz_[isensor] = hacc.Z();
+	}
+      }
+      // Newton step on the squared distance for all sensors together, see TPoca<KTRAJ,TLine>.  Inactive sensors take no step
+      for(size_t isensor=0;isensor<nsensor;isensor++){
+	double ex = hx_[isensor] - px_[isensor];
+	double ey = hy_[isensor] - py_[isensor];
+	double ez = hz_[isensor] - pz_[isensor];
+	double ldd = ex*dx_[isensor] + ey*dy_[isensor] + ez*dz_[isensor];
+	double ddot = hdx_[isensor]*dx_[isensor] + hdy_[isensor]*dy_[isensor] + hdz_[isensor]*dz_[isensor];
+	double denom = 1.0 - ddot*ddot;
+	// separation perpendicular to the line
+	double perpx = ex - ldd*dx_[isensor];
+	double perpy = ey - ldd*dy_[isensor];
+	double perpz = ez - ldd*dz_[isensor];
+	double dfdt = (perpx*hdx_[isensor] + perpy*hdy_[isensor] + perpz*hdz_[isensor])*hspeed;
+	double d2lin = denom*hspeed2;
+	double d2fdt2 = d2lin + perpx*hax_[isensor] + perpy*hay_[isensor] + perpz*haz_[isensor];
+	d2fdt2 = (d2fdt2 < 0.5*d2lin || fabs(dfdt) > 0.1*d2lin) ? d2lin : d2fdt2;
+	double dhtoca = active_[isensor] ? -dfdt/d2fdt2 : 0.0;
+	double snew = lt0_[isensor] + (ldd + ddot*hspeed*dhtoca)/lspeed_[isensor];
+	double dstoca = active_[isensor] ? snew - stoca_[isensor] : 0.0;
+	htoca_[isensor] += dhtoca;
+	stoca_[isensor] += dstoca;
+	dhtoca_[isensor] = dhtoca;
+	dstoca_[isensor] = dstoca;
+	denom_[isensor] = denom;
+      }
+      // test convergence
+      for(size_t isensor=0;isensor<nsensor;isensor++){
+	if(active_[isensor]){
+	  niter_[isensor]++;
+	  if(denom_[isensor] < 1.0e-5 || std::isnan(dhtoca_[isensor]))
+	    status_[isensor] = TPocaBase::pocafailed;
+	  else if(fabs(dhtoca_[isensor]) <= config_.precision_ && fabs(dstoca_[isensor]) <= config_.precision_)
+	    status_[isensor] = TPocaBase::converged;
+	  if(status_[isensor] != TPocaBase::unconverged){
+	    active_[isensor] = 0;
+	    nactive--;
+	  }
+	}
+      }
+    }
+  }
+
+}
+#endif
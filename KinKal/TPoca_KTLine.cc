@@ -0,0 +1,111 @@
+#include "KinKal/TPoca.hh"
+#include "KinKal/KTLine.hh"
+#include "KinKal/TLine.hh"
+#include "KinKal/PKTraj.hh"
+// specializations for TPoca
+using namespace std;
+namespace KinKal {
+  // finalize the POCA between a kinematic line and a sensor line, given the TOCA values
+  template<> void TPoca<KTLine,TLine>::finalize(double ptoca, double stoca) {
+    KTLine const& ktline = particleTraj();
+    TLine const& tline = sensorTraj();
+    // set the TPOCA 4-vectors
+    partPoca_.SetE(ptoca);
+    sensPoca_.SetE(stoca);
+    ktline.position(partPoca_);
+    tline.position(sensPoca_);
+    double doca = (sensPoca_.Vect()-partPoca_.Vect()).R();
+    // sign doca by angular momentum projected onto difference vector
+    double lsign = tline.dir().Cross(ktline.dir()).Dot(sensPoca_.Vect()-partPoca_.Vect());
+    double dsign = copysign(1.0,lsign);
+    doca_ = doca*dsign;
+
+    // DOCA derivatives are the projection of the position derivatives onto the DOCA direction.
+    // Motion along the particle direction doesn't change DOCA to first order, as it's perpendicular at POCA
+    Vec3 ddir = delta().Vect().Unit();// direction vector along D(POCA) from particle to sensor
+    auto dXdP = ktline.dXdPar(ptoca);
+    for(size_t ipar=0;ipar<KTLine::NParams();ipar++)
+      dDdP_[ipar] = -dsign*(ddir.X()*dXdP(0,ipar) + ddir.Y()*dXdP(1,ipar) + ddir.Z()*dXdP(2,ipar));
+
+    // dot product between directions at POCA
+    ddot_ = ktline.dir().Dot(tline.dir());
+    // A line constrains its momentum only through the speed, so DT must include the full parameter dependence.
+    // Linearize the POCA conditions (D.dir = D.tdir = 0) to get the change in each TOCA given the particle position (at fixed time)
+    // and direction changes. The direction change is orthogonal to D for momentum magnitude changes, so dMdPar can be used directly
+    auto dMdP = ktline.dMdPar(ptoca);
+    double pspeed = ktline.speed(ptoca);
+    double denom = 1.0 - ddot_*ddot_;
+    Vec3 dvec = delta().Vect();
+    for(size_t ipar=0;ipar<KTLine::NParams();ipar++){
+      Vec3 dX(dXdP(0,ipar),dXdP(1,ipar),dXdP(2,ipar));
+      Vec3 dM(dMdP(0,ipar),dMdP(1,ipar),dMdP(2,ipar));
+      double ldX = dX.Dot(tline.dir());
+      double dptoca = (ddot_*ldX - dX.Dot(ktline.dir()) + dvec.Dot(dM)/ktline.mom())/(pspeed*denom);
+      double dstoca = (ldX + pspeed*ddot_*dptoca)/tline.speed();
+      dTdP_[ipar] = dstoca - dptoca;
+    }
+    // propagate parameter covariance to variance on doca and toca
+    docavar_ = ROOT::Math::Similarity(dDdP(),ktline.params().covariance());
+    tocavar_ = ROOT::Math::Similarity(dTdP(),ktline.params().covariance());
+  }
+
+  // specialization between a kinematic line and a sensor line.  This is solved in closed form
+  template<> TPoca<KTLine,TLine>::TPoca(KTLine const& ktline, TLine const& tline, TPocaHint const& hint, TPocaConfig const& config) : TPocaBase(config.precision_),ktraj_(&ktline), straj_(&tline) {
+    // reset status
+    reset();
+    // separation between the reference points at each line's t0
+    Vec3 dpos = ktline.position(ktline.t0()) - tline.pos0();
+    double ddot = ktline.dir().Dot(tline.dir());
+    double denom = 1.0 - ddot*ddot;
+    // check for parallel
+    if(denom<1.0e-5){
+      status_ = pocafailed;
+    } else {
+      double pdd = dpos.Dot(ktline.dir());
+      double ldd = dpos.Dot(tline.dir());
+      // distance along each line from the reference points to POCA
+      double plen = (ddot*ldd - pdd)/denom;
+      double llen = (ldd - ddot*pdd)/denom;
+      double ptoca = ktline.t0() + plen/ktline.speed(ktline.t0());
+      double stoca = tline.t0() + llen/tline.speed(tline.t0());
+      niter_ = 1;
+      status_ = converged;
+      finalize(ptoca,stoca);
+    }
+  }
+
+  // specialization between a piecewise KTLine and a line
+  typedef PKTraj<KTLine> PKTLINE;
+  template<> TPoca<PKTLINE,TLine>::TPoca(PKTLINE const& pktline, TLine const& tline, TPocaHint const& hint, TPocaConfig const& config) : TPocaBase(config.precision_), ktraj_(&pktline), straj_(&tline)  {
+    // iteratively find the nearest piece, and POCA for that piece.  Start at hints if availalble, otherwise the middle
+    unsigned niter=0;
+    size_t oldindex= pktline.pieces().size();
+    size_t index;
+    if(hint.particleHint_)
+      index = pktline.nearestIndex(hint.particleToca_);
+    else
+      index = size_t(rint(oldindex/2.0));
+    status_ = converged;
+    TPocaHint phint(hint);
+    while(status_ == converged && niter++ < config.maxpieceiter_ && index != oldindex){
+      // call down to KTLine TPoca
+      // prepare for the next iteration
+      KTLine const& piece = pktline.pieces()[index];
+      TPoca<KTLine,TLine> tpoca(piece,tline,phint,config);
+      status_ = tpoca.status();
+      niter_ += tpoca.iterations();
+      if(tpoca.usable())copyPiece(tpoca);
+      oldindex = index;
+      index = pktline.nearestIndex(tpoca.particlePoca().T());
+      if(tpoca.status() == converged) phint = tpoca.hint();
+    }
+    if(status_ == converged && niter >= config.maxpieceiter_) status_ = unconverged;
+  }
+
+  template<> void TPoca<PKTLINE,TLine>::finalize(double ptoca, double stoca) {
+    // finalize on the piece containing the solution
+    TPoca<KTLine,TLine> tpoca(particleTraj().nearestPiece(ptoca),sensorTraj(),ptoca,stoca,status_,niter_,precision_);
+    if(tpoca.usable())copyPiece(tpoca);
+  }
+
+}
@@ -0,0 +1,151 @@
+#include "KinKal/TPoca.hh"
+#include "KinKal/RKTraj.hh"
+#include "KinKal/TLine.hh"
+#include "KinKal/PKTraj.hh"
+#include <limits>
+// specializations for TPoca
+using namespace std;
+namespace KinKal {
+  // finalize the POCA between a Runge-Kutta trajectory and a line, given the TOCA values
+  template<> void TPoca<RKTraj,TLine>::finalize(double ptoca, double stoca) {
+    RKTraj const& rktraj = particleTraj();
+    TLine const& tline = sensorTraj();
+    // evaluate the trajectory state at POCA once
+    KinState kstate;
+    rktraj.kinState(ptoca,kstate);
+    // set the TPOCA 4-vectors
+    partPoca_.SetXYZT(kstate.pos_.X(),kstate.pos_.Y(),kstate.pos_.Z(),ptoca);
+    sensPoca_.SetE(stoca);
+    tline.position(sensPoca_);
+    double doca = (sensPoca_.Vect()-partPoca_.Vect()).R();
+    // sign doca by angular momentum projected onto difference vector
+    double lsign = tline.dir().Cross(kstate.direction()).Dot(sensPoca_.Vect()-partPoca_.Vect());
+    double dsign = copysign(1.0,lsign);
+    doca_ = doca*dsign;
+
+    // The parameters are not local, so the derivatives come from the transported state derivatives.
+    // DOCA derivatives are the projection of the position derivatives onto the DOCA direction
+    Vec3 ddir = delta().Vect().Unit();// direction vector along D(POCA) from particle to sensor
+    DPDS dsdp = rktraj.dStatedPar(ptoca);
+    for(size_t ipar=0;ipar<RKTraj::NParams();ipar++)
+      dDdP_[ipar] = -dsign*(ddir.X()*dsdp(0,ipar) + ddir.Y()*dsdp(1,ipar) + ddir.Z()*dsdp(2,ipar));
+
+    // dot product between directions at POCA
+    Vec3 const& pdir = kstate.direction();
+    ddot_ = pdir.Dot(tline.dir());
+    // Linearize the POCA conditions (D.dir = D.tdir = 0) to get the change in each TOCA given the particle position and direction
+    // changes at fixed time, including the curvature of the trajectory
+    double pspeed = kstate.speed_;
+    Vec3 dvec = delta().Vect();
+    double denom = pspeed*(1.0 - ddot_*ddot_) - dvec.Dot(kstate.acc_)/pspeed;
+    for(size_t ipar=0;ipar<RKTraj::NParams();ipar++){
+      Vec3 dX(dsdp(0,ipar),dsdp(1,ipar),dsdp(2,ipar));
+      Vec3 dM(dsdp(3,ipar),dsdp(4,ipar),dsdp(5,ipar));
+      double ldX = dX.Dot(tline.dir());
+      double dptoca = (ddot_*ldX - dX.Dot(pdir) + dvec.Dot(dM)/kstate.mom_)/denom;
+      double dstoca = (ldX + pspeed*ddot_*dptoca)/tline.speed(stoca);
+      dTdP_[ipar] = dstoca - dptoca;
+    }
+    // propagate parameter covariance to variance on doca and toca
+    docavar_ = ROOT::Math::Similarity(dDdP(),rktraj.params().covariance());
+    tocavar_ = ROOT::Math::Similarity(dTdP(),rktraj.params().covariance());
+  }
+
+  // specialization between a Runge-Kutta trajectory and a line
+  template<> TPoca<RKTraj,TLine>::TPoca(RKTraj const& rktraj, TLine const& tline, TPocaHint const& hint, TPocaConfig const& config) : TPocaBase(config.precision_),ktraj_(&rktraj), straj_(&tline) {
+    // reset status
+    reset();
+    double ptoca;
+    // initialize the particle time using hints, if available.  If not, use the Z of the line from the reference helix
+    if(hint.particleHint_)
+      ptoca = hint.particleToca_;
+    else
+      ptoca = rktraj.ztime(tline.z0());
+    // the line TOCA follows from the particle position; the hint only serves the convergence test
+    double stoca = hint.sensorHint_ ? hint.sensorToca_ : tline.t0();
+    // use Newton iteration on the squared distance between the trajectory and the line until the desired precision on TOCA is met.
+    // The line is solved analytically at each step, so only the particle time is iterated
+    double dptoca(std::numeric_limits<double>::max()), dstoca(std::numeric_limits<double>::max());
+    unsigned niter(0);
+    // speed doesn't change in a magnetic field
+    double pspeed = rktraj.speed(ptoca);
+    Vec3 ppos, pdir, pacc;
+    // iterate until change in TOCA is less than precision
+    while((fabs(dptoca) > precision_ || fabs(dstoca) > precision_) && niter++ < config.maxiter_) {
+      // find the particle position, direction, and acceleration in one call
+      rktraj.posDirAccel(ptoca,ppos,pdir,pacc);
+      auto dpos = ppos-tline.pos0();
+      // dot products
+      double ddot = tline.dir().Dot(pdir);
+      double denom = 1.0 - ddot*ddot;
+      // check for parallel)
+      if(denom<1.0e-5){
+        status_ = pocafailed;
+        break;
+      }
+      double ldd = dpos.Dot(tline.dir());
+      // separation perpendicular to the line; its derivative WRT particle time is the perpendicular particle velocity
+      Vec3 perp = dpos - ldd*tline.dir();
+      // first and second derivatives of half the squared distance WRT particle time, as for LHelix
+      double dfdt = perp.Dot(pdir)*pspeed;
+      double d2lin = denom*pspeed*pspeed;
+      double d2fdt2 = d2lin + perp.Dot(pacc);
+      if(d2fdt2 < 0.5*d2lin || fabs(dfdt) > 0.1*d2lin) d2fdt2 = d2lin;
+      dptoca = -dfdt/d2fdt2;
+      if(isnan(dptoca)){
+        status_ = pocafailed;
+        break;
+      }
+      ptoca += dptoca; // particle time is iterative
+      // line time is always WRT t0, since it uses p0.  Project the (linearly) extrapolated particle position onto the line
+      double snew = tline.t0() + (ldd + ddot*pspeed*dptoca)/tline.speed(stoca);
+      dstoca = snew - stoca;
+      stoca = snew;
+    }
+    niter_ = std::min(niter,config.maxiter_);
+    // if successfull, finalize TPoca
+    if(status_ != pocafailed){
+      if(niter < config.maxiter_)
+        status_ = TPoca::converged;
+      else
+        status_ = TPoca::unconverged;
+      finalize(ptoca,stoca);
+    }
+  }
+
+  // specialization between a piecewise RKTraj and a line
+  typedef PKTraj<RKTraj> PRKTRAJ;
+  template<> TPoca<PRKTRAJ,TLine>::TPoca(PRKTRAJ const& prktraj, TLine const& tline, TPocaHint const& hint, TPocaConfig const& config) : TPocaBase(config.precision_), ktraj_(&prktraj), straj_(&tline)  {
+    // iteratively find the nearest piece, and POCA for that piece.  Start at hints if availalble, otherwise the middle
+    unsigned niter=0;
+    size_t oldindex= prktraj.pieces().size();
+    size_t index;
+    if(hint.particleHint_)
+      index = prktraj.nearestIndex(hint.particleToca_);
+    else
+      index = size_t(rint(oldindex/2.0));
+    status_ = converged;
+    TPocaHint phint(hint);
+    while(status_ == converged && niter++ < config.maxpieceiter_ && index != oldindex){
+      // call down to RKTraj TPoca
+      // prepare for the next iteration
+      RKTraj const& piece = prktraj.pieces()[index];
+      TPoca<RKTraj,TLine> tpoca(piece,tline,phint,config);
+      status_ = tpoca.status();
+      niter_ += tpoca.iterations();
+      if(tpoca.usable())copyPiece(tpoca);
+      oldindex = index;
+      index = prktraj.nearestIndex(tpoca.particlePoca().T());
+      // start the next piece from this solution
+      if(tpoca.status() == converged) phint = tpoca.hint();
+    }
+    if(status_ == converged && niter >= config.maxpieceiter_) status_ = unconverged;
+  }
+
+  template<> void TPoca<PRKTRAJ,TLine>::finalize(double ptoca, double stoca) {
+    // finalize on the piece containing the solution
+    TPoca<RKTraj,TLine> tpoca(particleTraj().nearestPiece(ptoca),sensorTraj(),ptoca,stoca,status_,niter_,precision_);
+    if(tpoca.usable())copyPiece(tpoca);
+  }
+
+}
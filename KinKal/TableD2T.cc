@@ -0,0 +1,173 @@
+#include "KinKal/TableD2T.hh"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace KinKal {
+
+  static const char tableMagic[8] = {'K','K','D','2','T','\0','\0','\0'};
+  static const std::uint32_t tableByteOrder = 0x01020304;
+
+  TableD2T::TableD2T(Grid const& grid, std::vector<double> const& tdrift, std::vector<double> const& tdriftvar, std::vector<double> const& dspeed) :
+    grid_(grid) {
+      build(tdrift,tdriftvar,dspeed);
+    }
+
+  TableD2T::TableD2T(std::string const& filename) {
+    std::ifstream ifs(filename.c_str(),std::ios::binary);
+    if(!ifs) throw std::runtime_error("TableD2T: can't open " + filename);
+    Header header;
+    ifs.read(reinterpret_cast<char*>(&header),sizeof(header));
+    if(!ifs || std::memcmp(header.magic_,tableMagic,sizeof(tableMagic)) != 0)
+      throw std::runtime_error("TableD2T: incompatible file " + filename);
+    if(header.byteorder_ != tableByteOrder)
+      throw std::runtime_error("TableD2T: byte order doesn't match in file " + filename);
+    if(header.version_ != version || header.nchannels_ != nchannels_)
+      throw std::runtime_error("TableD2T: incompatible file " + filename);
+    grid_ = Grid(header.nr_,header.nphi_,header.rmax_,header.phimin_,header.phimax_);
+    std::vector<float> fvals(grid_.size()*nchannels_);
+    ifs.read(reinterpret_cast<char*>(fvals.data()),fvals.size()*sizeof(float));
+    if(!ifs || ifs.peek() != std::ifstream::traits_type::eof())
+      throw std::runtime_error("TableD2T: incompatible file " + filename);
+    std::vector<double> vals[nchannels_];
+    for(size_t ichan=0;ichan<nchannels_;ichan++)
+      vals[ichan].assign(fvals.begin()+ichan*grid_.size(),fvals.begin()+(ichan+1)*grid_.size());
+    build(vals[time_],vals[timevar_],vals[speed_]);
+  }
+
+  void TableD2T::write(std::string const& filename, Grid const& grid, std::vector<double> const& tdrift,
+      std::vector<double> const& tdriftvar, std::vector<double> const& dspeed) {
+    // check the content before writing it
+    TableD2T check(grid,tdrift,tdriftvar,dspeed);
+    Header header;
+    std::memset(&header,0,sizeof(header));
+    std::memcpy(header.magic_,tableMagic,sizeof(tableMagic));
+    header.byteorder_ = tableByteOrder;
+    header.version_ = version;
+    header.nchannels_ = nchannels_;
+    header.nr_ = grid.nr_;
+    header.nphi_ = grid.nphi_;
+    header.rmax_ = grid.rmax_;
+    header.phimin_ = grid.phimin_;
+    header.phimax_ = grid.phimax_;
+    std::vector<float> fvals;
+    fvals.reserve(grid.size()*nchannels_);
+    for(auto const* vals : {&tdrift,&tdriftvar,&dspeed})
+      fvals.insert(fvals.end(),vals->begin(),vals->end());
+    std::ofstream ofs(filename.c_str(),std::ios::binary|std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(fvals.data()),fvals.size()*sizeof(float));
+    if(!ofs) throw std::runtime_error("TableD2T: can't write " + filename);
+  }
+
+  void TableD2T::build(std::vector<double> const& tdrift, std::vector<double> const& tdriftvar, std::vector<double> const& dspeed) {
+    unsigned nr = grid_.nr_;
+    unsigned nphi = grid_.nphi_;
+    if(nr < 2 || nphi < 2 || !(grid_.rmax_ > 0.0) || !(grid_.phimax_ > grid_.phimin_))
+      throw std::invalid_argument("TableD2T: invalid grid");
+    if(tdrift.size() != grid_.size() || tdriftvar.size() != grid_.size() || dspeed.size() != grid_.size())
+      throw std::invalid_argument("TableD2T: table size doesn't match grid");
+    for(size_t ival=0;ival<grid_.size();ival++){
+      if(!std::isfinite(tdrift[ival]) || !(tdriftvar[ival] >= 0.0) || !(dspeed[ival] > 0.0) || !std::isfinite(tdriftvar[ival]) || !std::isfinite(dspeed[ival]))
+	throw std::invalid_argument("TableD2T: invalid table value");
+    }
+    double rstep = grid_.rmax_/(nr-1);
+    rscale_ = 1.0/rstep;
+    phiscale_ = (nphi-1)/(grid_.phimax_-grid_.phimin_);
+    // summary values
+    maxtime_ = *std::max_element(tdrift.begin(),tdrift.end());
+    minspeed_ = *std::min_element(dspeed.begin(),dspeed.end());
+    double tedge(0.0);
+    for(unsigned iphi=0;iphi<nphi;iphi++)
+      tedge += tdrift[grid_.index(nr-1,iphi)];
+    avgspeed_ = tedge > 0.0 ? grid_.rmax_*nphi/tedge : dspeed[grid_.index(nr-1,0)];
+    // derivatives at the grid points WRT the normalized (grid index) coordinates, using central differences inside the table and
+    // one-sided differences at the edges.  The time distance derivative comes from the drift speed
+    auto diffr = [&](std::vector<double> const& vals, unsigned ir, unsigned iphi) {
+      unsigned ilow = ir > 0 ? ir-1 : ir;
+      unsigned ihigh = ir < nr-1 ? ir+1 : ir;
+      return (vals[grid_.index(ihigh,iphi)]-vals[grid_.index(ilow,iphi)])/(ihigh-ilow); };
+    auto diffphi = [&](std::vector<double> const& vals, unsigned ir, unsigned iphi) {
+      unsigned ilow = iphi > 0 ? iphi-1 : iphi;
+      unsigned ihigh = iphi < nphi-1 ? iphi+1 : iphi;
+      return (vals[grid_.index(ir,ihigh)]-vals[grid_.index(ir,ilow)])/(ihigh-ilow); };
+    std::vector<double> const* vals[nchannels_] = {&tdrift,&tdriftvar,&dspeed};
+    std::vector<double> du[nchannels_], dv[nchannels_], duv[nchannels_];
+    for(size_t ichan=0;ichan<nchannels_;ichan++){
+      du[ichan].resize(grid_.size());
+      dv[ichan].resize(grid_.size());
+      duv[ichan].resize(grid_.size());
+      for(unsigned iphi=0;iphi<nphi;iphi++){
+	for(unsigned ir=0;ir<nr;ir++){
+	  size_t ival = grid_.index(ir,iphi);
+	  du[ichan][ival] = ichan == time_ ? rstep/dspeed[ival] : diffr(*vals[ichan],ir,iphi);
+	  dv[ichan][ival] = diffphi(*vals[ichan],ir,iphi);
+	}
+      }
+      for(unsigned iphi=0;iphi<nphi;iphi++)
+	for(unsigned ir=0;ir<nr;ir++)
+	  duv[ichan][grid_.index(ir,iphi)] = diffphi(du[ichan],ir,iphi);
+    }
+    // bicubic Hermite coefficients for each cell: A = M F M^T, where F holds the corner values and derivatives
+    static const double M[4][4] = {{1.0,0.0,0.0,0.0},{0.0,0.0,1.0,0.0},{-3.0,3.0,-2.0,-1.0},{2.0,-2.0,1.0,1.0}};
+    cells_.resize(size_t(nr-1)*(nphi-1));
+    for(unsigned iphi=0;iphi<nphi-1;iphi++){
+      for(unsigned ir=0;ir<nr-1;ir++){
+	Cell& cell = cells_[size_t(iphi)*(nr-1)+ir];
+	for(size_t ichan=0;ichan<nchannels_;ichan++){
+	  double F[4][4];
+	  for(unsigned iu=0;iu<2;iu++){
+	    for(unsigned iv=0;iv<2;iv++){
+	      size_t ival = grid_.index(ir+iu,iphi+iv);
+	      F[iu][iv] = (*vals[ichan])[ival];
+	      F[iu][iv+2] = dv[ichan][ival];
+	      F[iu+2][iv] = du[ichan][ival];
+	      F[iu+2][iv+2] = duv[ichan][ival];
+	    }
+	  }
+	  double MF[4][4];
+	  for(unsigned i=0;i<4;i++)
+	    for(unsigned j=0;j<4;j++){
+	      MF[i][j] = 0.0;
+	      for(unsigned k=0;k<4;k++) MF[i][j] += M[i][k]*F[k][j];
+	    }
+	  for(unsigned i=0;i<4;i++)
+	    for(unsigned j=0;j<4;j++){
+	      double coef(0.0);
+	      for(unsigned k=0;k<4;k++) coef += MF[i][k]*M[j][k];
+	      cell.coef_[ichan][4*i+j] = coef;
+	    }
+	}
+      }
+    }
+  }
+
+  void TableD2T::distanceToTime(Pol2 const& drift, double& tdrift, double& tdriftvar, double& dspeed) const {
+    double rho = drift.R();
+    double rdrift = fabs(rho);
+    // normalized coordinates, clamped to the table
+    double x = std::min(rdrift*rscale_,double(grid_.nr_-1));
+    double y = std::min(std::max((drift.Phi()-grid_.phimin_)*phiscale_,0.0),double(grid_.nphi_-1));
+    unsigned ir = std::min(unsigned(x),grid_.nr_-2);
+    unsigned iphi = std::min(unsigned(y),grid_.nphi_-2);
+    double u = x - ir;
+    double v = y - iphi;
+    Cell const& cell = cells_[size_t(iphi)*(grid_.nr_-1)+ir];
+    double vals[nchannels_];
+    for(size_t ichan=0;ichan<nchannels_;ichan++){
+      double const* coef = cell.coef_[ichan].data();
+      double b0 = ((coef[3]*v + coef[2])*v + coef[1])*v + coef[0];
+      double b1 = ((coef[7]*v + coef[6])*v + coef[5])*v + coef[4];
+      double b2 = ((coef[11]*v + coef[10])*v + coef[9])*v + coef[8];
+      double b3 = ((coef[15]*v + coef[14])*v + coef[13])*v + coef[12];
+      vals[ichan] = ((b3*u + b2)*u + b1)*u + b0;
+    }
+    dspeed = std::max(vals[speed_],minspeed_);
+    tdriftvar = std::max(vals[timevar_],0.0);
+    tdrift = vals[time_];
+    if(rdrift > grid_.rmax_) tdrift += (rdrift-grid_.rmax_)/dspeed;
+    if(rho < 0.0) tdrift = -tdrift;
+  }
+
+}
@@ -0,0 +1,72 @@
+#ifndef KinKal_TableD2T_hh
+#define KinKal_TableD2T_hh
+//
+//  Distance-to-time relationship from a calibration table on a regular grid of drift distance and ExB azimuth.
+//  The table provides the mean drift time, the drift time variance, and the local drift speed at each grid point.
+//  These are interpolated with bicubic polynomials whose coefficients are computed once on construction, so an
+//  evaluation is a cell lookup plus 3 polynomial evaluations.  The time polynomial uses the inverse of the tabulated
+//  drift speed as its distance derivative at the grid points, so that time and speed are consistent.
+//  Negative drift distances (wrong ambiguity) give negative drift times, as for CVD2T.  Beyond the table the
+//  time is extrapolated linearly with the speed at the table edge, and the azimuth is clamped.  The interpolated speed is
+//  bounded below by the smallest tabulated speed, so that it (and the extrapolation) stays positive.
+//  The object is immutable after construction, so a single instance can be shared by all hits and threads.
+//  Used as part of the kinematic Kalman fit
+//
+#include "KinKal/D2T.hh"
+#include <cstdint>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <array>
+
+namespace KinKal {
+  class TableD2T : public D2T {
+    public:
+      enum {version=2};
+      enum Channel {time_=0, timevar_, speed_, nchannels_};
+      // regular grid; the distance runs from 0 to rmax, the azimuth from phimin to phimax.  Each needs at least 2 points
+      struct Grid {
+	unsigned nr_, nphi_;
+	double rmax_, phimin_, phimax_;
+	Grid(unsigned nr=0, unsigned nphi=0, double rmax=0.0, double phimin=-0.5*M_PI, double phimax=0.5*M_PI) :
+	  nr_(nr), nphi_(nphi), rmax_(rmax), phimin_(phimin), phimax_(phimax) {}
+	size_t size() const { return size_t(nr_)*nphi_; }
+	size_t index(unsigned ir, unsigned iphi) const { return size_t(iphi)*nr_ + ir; }  // distance index runs fastest
+      };
+      // binary calibration file header; it's followed by the float table values for each channel in turn, ordered as Grid::index.
+      // The file is written in the native byte order, which is recorded so that it can be checked on reading
+      struct Header {
+	char magic_[8];
+	std::uint32_t byteorder_;
+	std::uint32_t version_;
+	std::uint32_t nchannels_;
+	std::uint32_t nr_, nphi_;
+	double rmax_, phimin_, phimax_;
+      };
+      // construct from tables of drift time (ns), drift time variance (ns^2), and local drift speed (mm/ns) on the given grid
+      TableD2T(Grid const& grid, std::vector<double> const& tdrift, std::vector<double> const& tdriftvar, std::vector<double> const& dspeed);
+      // load a binary calibration file; this throws if the file is missing or malformed
+      explicit TableD2T(std::string const& filename);
+      // write a binary calibration file for the given tables
+      static void write(std::string const& filename, Grid const& grid, std::vector<double> const& tdrift,
+	  std::vector<double> const& tdriftvar, std::vector<double> const& dspeed);
+      virtual void distanceToTime(Pol2 const& drift, double& tdrift, double& tdriftvar, double& dspeed) const override;
+      virtual double averageDriftSpeed() const override { return avgspeed_; }
+      virtual double maximumDriftTime() const override { return maxtime_; }
+      virtual ~TableD2T(){}
+      Grid const& grid() const { return grid_; }
+    private:
+      // power-series coefficients of each channel in the normalized cell coordinates (u,v), indexed as u^i v^j -> 4*i+j
+      struct Cell {
+	std::array<double,16> coef_[nchannels_];
+      };
+      void build(std::vector<double> const& tdrift, std::vector<double> const& tdriftvar, std::vector<double> const& dspeed);
+      Grid grid_;
+      double rscale_, phiscale_; // inverse grid spacings
+      std::vector<Cell> cells_; // (nr-1)*(nphi-1) cells, distance index fastest
+      double avgspeed_, maxtime_;
+      double minspeed_; // smallest tabulated drift speed
+  };
+}
+#endif
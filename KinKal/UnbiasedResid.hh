@@ -0,0 +1,34 @@
+#ifndef KinKal_UnbiasedResid_hh
+#define KinKal_UnbiasedResid_hh
+//
+//  Unbiased ('leave-one-out') residual of a hit, computed from the fit information excluding that hit, together with
+//  the effect of toggling the hit's activity on the fit.  For an active hit, removing it reduces the fit chisquared by
+//  dchisq_ and changes the parameters at the hit by dpars_; for an inactive hit, adding it increases the chisquared
+//  by dchisq_ and changes the parameters by dpars_.  These are exact to 1st order in the parameter change.
+//  used as part of the kinematic kalman fit
+//
+#include "KinKal/THit.hh"
+#include <cmath>
+#include <ostream>
+
+namespace KinKal {
+  template <class KTRAJ> struct UnbiasedResid {
+    typedef typename KTRAJ::DVEC DVEC;
+    THit<KTRAJ> const* thit_; // hit this residual describes
+    double time_; // time of the hit on the particle trajectory
+    bool active_; // whether the hit is active in the fit
+    double value_; // residual WRT the fit parameters excluding this hit
+    double variance_; // variance of the residual: measurement variance (including annealing) plus the projected parameter variance
+    double dchisq_; // chisquared change from toggling this hit's activity
+    DVEC dpars_; // parameter change at the hit from toggling this hit's activity
+    double chi() const { return value_/sqrt(variance_); }
+    UnbiasedResid() : thit_(0), time_(0.0), active_(false), value_(0.0), variance_(-1.0), dchisq_(0.0) {}
+  };
+
+  template <class KTRAJ> std::ostream& operator <<(std::ostream& ost, UnbiasedResid<KTRAJ> const& uresid) {
+    ost << (uresid.active_ ? "Active " : "Inactive ") << "unbiased residual value " << uresid.value_ << " variance " << uresid.variance_
+      << " time " << uresid.time_ << " dchisq " << uresid.dchisq_ << " dpars " << uresid.dpars_;
+    return ost;
+  }
+}
+#endif
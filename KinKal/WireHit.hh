@@ -4,23 +4,73 @@
 //  class representing a drift wire measurement.  Implemented using TPOCA between the particle traj and the wire
 //  Used as part of the kinematic Kalman fit
 //
-#include "KinKal/THit.hh"
+#include "KinKal/LineHit.hh"
 #include "KinKal/D2T.hh"
 #include "KinKal/TLine.hh"
 #include "KinKal/TPoca.hh"
 #include "KinKal/LRAmbig.hh"
 #include "KinKal/BField.hh"
 #include <stdexcept>
+#include <istream>
+#include <algorithm>
 namespace KinKal {
+  struct AmbigResolver; // only used to find if a meta-iteration resolves the ambiguities jointly
 // struct for updating wire hits; this is just parameters, but could be methods as well
   struct WireHitUpdater {
     double mindoca_; // minimum DOCA value to set an ambiguity
     double maxdoca_; // maximum DOCA to still use a hit
     WireHitUpdater(double mindoca,double maxdoca) : mindoca_(mindoca), maxdoca_(maxdoca) {}
+    // construct from a schedule file line; see KKConfig::readSchedule
+    WireHitUpdater(std::istream& is) { is >> mindoca_ >> maxdoca_; }
+    static const char* name() { return "WireHitUpdater"; }
+    // use DOCA to set the ambiguity, and the null variance if the ambiguity can't be resolved.  Returns if the hit is consistent
+    // with the track and should be active.  For now, just look at DOCA, but could use tension too TODO!
+    bool update(double doca, double csize, LRAmbig& ambig, double& nullvar) const {
+      if(fabs(doca) > mindoca_){
+	ambig = doca > 0.0 ? LRAmbig::right : LRAmbig::left;
+      } else {
+	ambig = LRAmbig::null;
+	double nulldoca = std::min(csize,mindoca_);
+	nullvar = nulldoca*nulldoca/3.0;
+      }
+      return isActive(doca);
+    }
+    // activity only, for when the ambiguity is set otherwise (see AmbigResolver)
+    bool isActive(double doca) const { return fabs(doca) < maxdoca_; }
   };
 
-  template <class KTRAJ> class WireHit : public THit<KTRAJ> {
+  // direction perpendicular to a wire and the BField, defining the drift azimuth for ExB effects.  The wire is fixed and the field
+  // changes slowly along it, so this is cached at a point along the wire, and only refreshed when an update finds the POCA has moved
+  // away from that by more than the tolerance.  The field is taken on the wire (at the sensor POCA) rather than at the particle POCA:
+  // these are at most a cell size apart, much less than the distance over which the field changes, and the drift happens inside the cell.
+  // The cache starts at the wire reference point, so it's always valid.  The drift azimuth WRT this direction is cached with it, and
+  // set from the POCA separation on every update, so that residual computation doesn't need trigonometry.  It starts at 0
+  struct WireFieldCache {
+    double wpos_; // distance along the wire from its reference point where the cache was computed
+    Vec3 pdir_;
+    double phi_; // drift azimuth at the last update
+    WireFieldCache(BField const& bfield, TLine const& wire) : phi_(0.0) { refresh(bfield,wire,wire.pos0()); }
+    void update(BField const& bfield, TLine const& wire, Vec3 const& wpoca, Vec3 const& dvec, double ftol) {
+      if(fabs((wpoca - wire.pos0()).Dot(wire.dir()) - wpos_) > ftol) refresh(bfield,wire,wpoca);
+      // normalize with the separation vector itself, so that the ratio is bounded; the azimuth is undefined (and irrelevant) at 0 separation
+      double dmag = dvec.R();
+      phi_ = dmag > 0.0 ? asin(std::max(-1.0,std::min(1.0,dvec.Dot(pdir_)/dmag))) : 0.0;
+    }
+    Vec3 const& driftDir() const { return pdir_; }
+    double driftPhi() const { return phi_; }
+    private:
+    void refresh(BField const& bfield, TLine const& wire, Vec3 const& wpoca) {
+      Vec3 bvec = bfield.fieldVect(wpoca);
+      pdir_ = bvec.Cross(wire.dir()).Unit();
+      wpos_ = (wpoca - wire.pos0()).Dot(wire.dir());
+    }
+  };
+
+  template <class TPOCA, class RESIDUAL> void wireResid(TPOCA const& tpoca, LRAmbig ambig, WireFieldCache const& fcache, D2T const& d2t, double nullvar, RESIDUAL& resid);
+
+  template <class KTRAJ> class WireHit : public LineHit<KTRAJ> {
     public:
+      typedef LineHit<KTRAJ> LHIT;
       typedef THit<KTRAJ> THIT;
       typedef PKTraj<KTRAJ> PKTRAJ;
       typedef TPoca<PKTRAJ,TLine> TPOCA;
@@ -28,21 +78,29 @@ namespace KinKal {
       typedef DXing<KTRAJ> DXING;
       typedef std::shared_ptr<DXING> DXINGPTR;
       typedef typename KTRAJ::DVEC DVEC;
-      // THit interface overrrides
-      virtual void resid(PKTRAJ const& pktraj, RESIDUAL& resid) const override;
-      void resid(TPOCA const& tpoca, RESIDUAL& resid) const; // actual implementation of resid uses TPOCA
+      // THit and LineHit interface overrrides
+      virtual void resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& resid) const override;
+      virtual void resid(TPOCA const& tpoca, RESIDUAL& resid) const override; // actual implementation of resid uses TPOCA
       virtual void update(PKTRAJ const& pktraj, MConfig const& config, RESIDUAL& resid) override;
+      virtual void update(TPOCA const& tpoca, MConfig const& config, RESIDUAL& resid) override;
+      virtual TLine const& sensor() const override { return wire_; }
       virtual unsigned nDOF() const override { return 1; }
       double cellSize() const { return csize_; } // approximate transverse cell size, used to set null variance
 // construct from a D2T relationship; BField is needed to compute ExB effects
       TLine const& wire() const { return wire_; }
       // set the null variance given the min DOCA used to assign LR ambiguity.  This assumes a flat DOCA distribution
       void setNullVar(double mindoca) { nullvar_ = mindoca*mindoca/3.0; }
+      // the left-right ambiguity can also be set externally, by an AmbigResolver.  That computes the residual for any ambiguity
+      // from a TPOCA with the wire, without changing the hit state
+      LRAmbig ambig() const { return ambig_; }
       void setAmbig(LRAmbig newambig) { ambig_ = newambig; }
+      void ambigResid(TPOCA const& tpoca, LRAmbig ambig, RESIDUAL& resid) const;
+      // set the distance the POCA can move along the wire before an update refreshes the cached field direction
+      void setFieldTolerance(double ftol) { ftol_ = ftol; }
+      double fieldTolerance() const { return ftol_; }
       WireHit(DXINGPTR const& dxing, BField const& bfield, TLine const& wire, D2T const& d2t, double csize,LRAmbig ambig=LRAmbig::null) : 
-	THIT(dxing,true), wire_(wire), d2t_(d2t), csize_(csize), ambig_(ambig), bfield_(bfield) { setNullVar(csize_); }
+	LHIT(dxing,true), wire_(wire), d2t_(d2t), csize_(csize), ambig_(ambig), bfield_(bfield), ftol_(10.0), fcache_(bfield,wire) { setNullVar(csize_); }
       virtual ~WireHit(){}
-      LRAmbig ambig() const { return ambig_; }
       D2T const& d2T() const { return d2t_; }
     private:
       TLine wire_; // local linear approximation to the wire of this hit.  The range describes the active wire length
@@ -51,64 +109,62 @@ namespace KinKal {
       double nullvar_; // variance of the error in space for null ambiguity
       LRAmbig ambig_; // current ambiguity assignment: can change during a fit
       BField const& bfield_;
+      double ftol_; // field cache tolerance (mm)
+      WireFieldCache fcache_; // drift direction and azimuth, refreshed by update so that residual computation has no side effects
   };
 
-  template <class KTRAJ> void WireHit<KTRAJ>::resid(PKTRAJ const& pktraj, RESIDUAL& residual) const {
-    // compute TPOCA.  wire hit measurement time is too crude to provide a good hint
-    TPOCA tpoca(pktraj,wire_);
+  template <class KTRAJ> void WireHit<KTRAJ>::resid(PKTRAJ const& pktraj, TPocaConfig const& tpconfig, RESIDUAL& residual) const {
+    // compute TPOCA, starting from the previous solution if there is one.  wire hit measurement time is too crude to provide a good hint
+    TPOCA tpoca(pktraj,wire_,residual.tPoca().hint(),tpconfig);
     resid(tpoca,residual);
   }
 
   template <class KTRAJ> void WireHit<KTRAJ>::update(PKTRAJ const& pktraj, MConfig const& mconfig, RESIDUAL& residual ) {
-    // find TPOCA
-    TPOCA tpoca(pktraj,wire());
-    // find the wire hit updater in the update params.  If there are more than 1 throw 
-    const WireHitUpdater* whupdater(0);
-    for(auto const& uparams : mconfig.hitupdaters_){
-      auto const* whu = std::any_cast<WireHitUpdater>(&uparams);
-      if(whu != 0){
-	if(whupdater !=0) throw std::invalid_argument("Multiple WireHitUpdaters found");
-	whupdater = whu;
-      }
-    }
+    // find TPOCA, starting from the previous solution if there is one
+    TPOCA tpoca(pktraj,wire(),residual.tPoca().hint(),mconfig.tpconfig_);
+    update(tpoca,mconfig,residual);
+  }
+
+  template <class KTRAJ> void WireHit<KTRAJ>::update(TPOCA const& tpoca, MConfig const& mconfig, RESIDUAL& residual ) {
+    // find the wire hit updater for this meta-iteration
+    const WireHitUpdater* whupdater = mconfig.hitUpdater<WireHitUpdater>();
+    // allow no updater: hits may be frozen this meta-iteration.  If there's an ambiguity resolver, it has already set the ambiguity
     if(whupdater != 0){
-        // use DOCA to set the ambiguity
-      if(fabs(tpoca.doca()) > whupdater->mindoca_){
-	LRAmbig newambig = tpoca.doca() > 0.0 ? LRAmbig::right : LRAmbig::left;
-	setAmbig(newambig);
-      } else {
-	setAmbig(LRAmbig::null);
-	setNullVar(std::min(cellSize(),whupdater->mindoca_));
-      }
-      // decide if the hit is consistent with this track, and if not disable/enable it.
-      // for now, just look at DOCA, but could use tension too TODO!
-      THIT::setActivity(fabs(tpoca.doca()) < whupdater->maxdoca_);
-    } // allow no updater: hits may be frozen this meta-iteration
+      if(mconfig.hitUpdater<AmbigResolver>() != 0)
+	THIT::setActivity(whupdater->isActive(tpoca.doca()));
+      else
+	THIT::setActivity(whupdater->update(tpoca.doca(),cellSize(),ambig_,nullvar_));
+    }
+    if(tpoca.usable()) fcache_.update(bfield_,wire_,tpoca.sensorPoca().Vect(),tpoca.delta().Vect(),ftol_);
     // compute the residual
     resid(tpoca,residual);
   }
 
   template <class KTRAJ> void WireHit<KTRAJ>::resid(TPOCA const& tpoca, RESIDUAL& resid) const {
+    ambigResid(tpoca,ambig_,resid);
+  }
+
+  template <class KTRAJ> void WireHit<KTRAJ>::ambigResid(TPOCA const& tpoca, LRAmbig ambig, RESIDUAL& resid) const {
+    wireResid(tpoca,ambig,fcache_,d2t_,nullvar_,resid);
+  }
+
+  // residual of a wire measurement for the given ambiguity, from a TPOCA with the wire.  This is shared by the wire hit representations
+  template <class TPOCA, class RESIDUAL> void wireResid(TPOCA const& tpoca, LRAmbig ambig, WireFieldCache const& fcache, D2T const& d2t, double nullvar, RESIDUAL& resid) {
     if(tpoca.usable()){
-      // translate TPOCA to residual
-      if(ambig_ != LRAmbig::null){ 
-	auto iambig = static_cast<std::underlying_type<LRAmbig>::type>(ambig_);
-	// convert DOCA to wire-local polar coordinates.  This defines azimuth WRT the B field for ExB effects
+      if(ambig != LRAmbig::null){ 
+	auto iambig = static_cast<std::underlying_type<LRAmbig>::type>(ambig);
+	// convert DOCA to wire-local polar coordinates.  The azimuth WRT the B field for ExB effects is taken from the last update
 	double rho = tpoca.doca()*iambig; // this is allowed to go negative
-	Vec3 bvec = bfield_.fieldVect(tpoca.particlePoca().Vect());
-	auto pdir = bvec.Cross(wire_.dir()).Unit(); // direction perp to wire and BField
-	Vec3 dvec = tpoca.delta().Vect();
-	double phi = asin(double(dvec.Unit().Dot(pdir)));
-	Pol2 drift(rho, phi);
+	Pol2 drift(rho, fcache.driftPhi());
 	double tdrift, tdvar, vdrift;
-	d2T().distanceToTime(drift, tdrift, tdvar, vdrift);
+	d2t.distanceToTime(drift, tdrift, tdvar, vdrift);
 	// residual is in time, so unit dependendence on time, distance dependence is the local drift velocity
-	DVEC dRdP = tpoca.dDdP()*iambig/vdrift - tpoca.dTdP(); 
+	typename RESIDUAL::DVEC dRdP = tpoca.dDdP()*iambig/vdrift - tpoca.dTdP(); 
 	resid = RESIDUAL(RESIDUAL::dtime,tpoca,tpoca.deltaT()-tdrift,tdvar,dRdP);
       } else {
 	// interpret DOCA against the wire directly as the residual.  There is no direct time dependence in this case
 	// residual is in space, so unit dependendence on distance, none on time
-	resid = RESIDUAL(RESIDUAL::distance,tpoca,-tpoca.doca(),nullvar_,tpoca.dDdP());
+	resid = RESIDUAL(RESIDUAL::distance,tpoca,-tpoca.doca(),nullvar,tpoca.dDdP());
       }
     } else
       throw std::runtime_error("POCA failure");
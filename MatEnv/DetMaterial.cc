@@ -18,6 +18,7 @@
 #include <cfloat>
 #include <string>
 #include <vector>
+#include <stdexcept>
 using std::endl;
 using std::ostream;
 //
@@ -48,107 +49,135 @@ namespace MatEnv {
 
   double cm(10.0); // temporary hack
   DetMaterial::DetMaterial(const char* detMatName, const MtrPropObj* detMtrProp):
-    _msmom(15.0),
-    _scatterfrac(0.9999),
-    _cutOffEnergy(1000.),
-    _elossType(loss),
-    _name(detMatName),
-    _za(detMtrProp->getZ()/detMtrProp->getA()),
-    _zeff(detMtrProp->getZ()),
-    _aeff(detMtrProp->getA()),
-    _radthick(detMtrProp->getRadLength()/cm/cm),
-    _intLength(detMtrProp->getIntLength()/detMtrProp->getDensity()),
-    _meanion(2.*log(detMtrProp->getMeanExciEnergy()*1.0e6)),
-    _eexc(detMtrProp->getMeanExciEnergy()),
-    _x0(detMtrProp->getX0density()),
-    _x1(detMtrProp->getX1density()),
-    _delta0(detMtrProp->getDEdxFactor()),
-    _afactor(detMtrProp->getAdensity()),
-    _mpower(detMtrProp->getMdensity()),
-    _bigc(detMtrProp->getCdensity()),
-    _density(detMtrProp->getDensity()/cm/cm/cm),
-    _noem(detMtrProp->getNumberOfElements()),
-    _taul(detMtrProp->getTaul())
+    _data(),
+    _name(detMatName)
   {
-    _shellCorrectionVector = 
-      new std::vector< double >(detMtrProp->getShellCorrectionVector());
-    _vecNbOfAtomsPerVolume = 
-      new std::vector< double >(detMtrProp->getVecNbOfAtomsPerVolume());
-    _vecTau0 = 
-      new std::vector< double >(detMtrProp->getVecTau0());
-    _vecAlow = new std::vector< double >(detMtrProp->getVecAlow());
-    _vecBlow = new std::vector< double >(detMtrProp->getVecBlow());
-    _vecClow = new std::vector< double >(detMtrProp->getVecClow());
-    _vecZ = new std::vector< double >(detMtrProp->getVecZ());
+    _data._msmom = 15.0;
+    _data._scatterfrac = 0.9999;
+    _data._cutOffEnergy = 1000.;
+    _data._elossType = loss;
+    _data._za = detMtrProp->getZ()/detMtrProp->getA();
+    _data._zeff = detMtrProp->getZ();
+    _data._aeff = detMtrProp->getA();
+    _data._radthick = detMtrProp->getRadLength()/cm/cm;
+    _data._intLength = detMtrProp->getIntLength()/detMtrProp->getDensity();
+    _data._meanion = 2.*log(detMtrProp->getMeanExciEnergy()*1.0e6);
+    _data._eexc = detMtrProp->getMeanExciEnergy();
+    _data._x0 = detMtrProp->getX0density();
+    _data._x1 = detMtrProp->getX1density();
+    _data._delta0 = detMtrProp->getDEdxFactor();
+    _data._afactor = detMtrProp->getAdensity();
+    _data._mpower = detMtrProp->getMdensity();
+    _data._bigc = detMtrProp->getCdensity();
+    _data._density = detMtrProp->getDensity()/cm/cm/cm;
+    _data._noem = detMtrProp->getNumberOfElements();
+    _data._taul = detMtrProp->getTaul();
+    std::vector<double> const& shellcorr = detMtrProp->getShellCorrectionVector();
+    std::copy_n(shellcorr.begin(),std::min(shellcorr.size(),size_t(MtrPropObj::numShellV)),_data._shellCorrection);
+    if(_data._noem > maxElements)
+      throw std::invalid_argument("DetMaterial: material " + _name + " has too many elements");
+    std::copy_n(detMtrProp->getVecNbOfAtomsPerVolume().begin(),_data._noem,_data._vecNbOfAtomsPerVolume);
+    std::copy_n(detMtrProp->getVecTau0().begin(),_data._noem,_data._vecTau0);
+    std::copy_n(detMtrProp->getVecAlow().begin(),_data._noem,_data._vecAlow);
+    std::copy_n(detMtrProp->getVecBlow().begin(),_data._noem,_data._vecBlow);
+    std::copy_n(detMtrProp->getVecClow().begin(),_data._noem,_data._vecClow);
+    std::copy_n(detMtrProp->getVecZ().begin(),_data._noem,_data._vecZ);
     // compute cached values; these are used in detailed scattering models
-    _invx0 = _density/_radthick;
-    _nbar = _invx0*1.587e7*pow(_zeff,1.0/3.0)/((_zeff+1)*log(287/sqrt(_zeff)));
-    _chic2 = 1.57e1*_zeff*(_zeff+1)/_aeff;  
-    _chia2_1 = 2.007e-5*pow(_zeff,2.0/3.0);
-    _chia2_2 = 3.34*pow(_zeff*_alpha,2);
+    _data._invx0 = _data._density/_data._radthick;
+    _data._nbar = _data._invx0*1.587e7*pow(_data._zeff,1.0/3.0)/((_data._zeff+1)*log(287/sqrt(_data._zeff)));
+    _data._chic2 = 1.57e1*_data._zeff*(_data._zeff+1)/_data._aeff;  
+    _data._chia2_1 = 2.007e-5*pow(_data._zeff,2.0/3.0);
+    _data._chia2_2 = 3.34*pow(_data._zeff*_alpha,2);
 
     if (detMtrProp->getEnergyTcut()>0.0) {
-      _cutOffEnergy = detMtrProp->getEnergyTcut();
-      _elossType = deposit;
+      _data._cutOffEnergy = detMtrProp->getEnergyTcut();
+      _data._elossType = deposit;
     }
     if (detMtrProp->getState() == "gas" && detMtrProp->getDensity()<0.01) {
-      _scatterfrac = 0.999999;
+      _data._scatterfrac = 0.999999;
     }
   }
 
-  DetMaterial::~DetMaterial()
-  {
-    delete _shellCorrectionVector;
-    delete _vecNbOfAtomsPerVolume;
-    delete _vecTau0;
-    delete _vecAlow;
-    delete _vecBlow;
-    delete _vecClow;
-    delete _vecZ;
-  }
+  DetMaterial::DetMaterial(const char* detMatName, const Data& data):
+    _data(data),
+    _name(detMatName)
+  {}
 
   //
   //  Multiple scattering function
   //
   double
     DetMaterial::scatterAngleRMS(double mom, double pathlen,double mass) const {
-      if(mom>0.0){
-	double beta = particleBeta(mom,mass);
-	// pdg formulat
-	//    double radfrac = fabs(pathlen*_invx0);
-	//    double sigpdg = 0.0136*sqrt(radfrac)*(1.0+0.088*log10(radfrac))/(beta*mom);
-	// old Kalman formula
-	//    double oldsig = 0.011463*sqrt(radfrac)/(mom*particleBeta(mom,mass));
-	// DNB 20/1/2011  Updated to use Dahl-Lynch formula from  NIMB58 (1991)
-	double invmom2 = 1.0/pow(mom,2);
-	double invb2 = 1.0/pow(beta,2);
-	// convert to path in gm/cm^2!!!
-	double path = fabs(pathlen)*_density;
-	double chic2 = _chic2*path*invb2*invmom2;
-	double chia2 = _chia2_1*(1.0 + _chia2_2*invb2)*invmom2;
-	double omega = chic2/chia2;
-	static double vfactor = 0.5/(1-_scatterfrac);
-	double v = vfactor*omega;
-	static double sig2factor = 1.0/(1+_scatterfrac*_scatterfrac);
-	double sig2 = sig2factor*chic2*( (1+v)*log(1+v)/v - 1);
-	// protect against underflow
-	double sigdl = sqrt(std::max(0.0,sig2));
-	// check
-	return sigdl;
-      } else
+      return sqrt(scatterAngleVar(mom,pathlen,mass));
+    }
+
+  double
+    DetMaterial::scatterAngleVar(double mom, double pathlen,double mass) const {
+      if(mom>0.0)
+	return betaScatterAngleVar(mom,particleBeta(mom,mass),pathlen);
+      else
 	return 1.0; // 'infinite' scattering
     }
 
+  double
+    DetMaterial::betaScatterAngleVar(double mom, double beta, double pathlen) const {
+      // pdg formulat
+      //    double radfrac = fabs(pathlen*_invx0);
+      //    double sigpdg = 0.0136*sqrt(radfrac)*(1.0+0.088*log10(radfrac))/(beta*mom);
+      // old Kalman formula
+      //    double oldsig = 0.011463*sqrt(radfrac)/(mom*particleBeta(mom,mass));
+      // DNB 20/1/2011  Updated to use Dahl-Lynch formula from  NIMB58 (1991)
+      double invmom2 = 1.0/pow(mom,2);
+      double invb2 = 1.0/pow(beta,2);
+      // convert to path in gm/cm^2!!!
+      double path = fabs(pathlen)*_data._density;
+      double chic2 = _data._chic2*path*invb2*invmom2;
+      double chia2 = _data._chia2_1*(1.0 + _data._chia2_2*invb2)*invmom2;
+      double omega = chic2/chia2;
+      // these depend on the material, so can't be function statics
+      double vfactor = 0.5/(1-_data._scatterfrac);
+      double v = vfactor*omega;
+      double sig2factor = 1.0/(1+_data._scatterfrac*_data._scatterfrac);
+      double sig2 = sig2factor*chic2*( (1+v)*log(1+v)/v - 1);
+      // protect against underflow
+      return std::max(0.0,sig2);
+    }
+
+  DetMaterial::Interaction
+    DetMaterial::interaction(double mom, double pathlen,double mass) const {
+      Interaction retval;
+      if(mom>0.0){
+	double energy = particleEnergy(mom,mass);
+	double beta = mom/energy;
+	double gamma = energy/mass;
+	double dedx = dEdx(beta,gamma,_data._elossType,mass);
+	retval.eloss_ = dEdxEnergyLoss(mom,pathlen,mass,dedx);
+	// see energyLossRMS
+	retval.elossvar_ = 0.25*retval.eloss_*retval.eloss_;
+	retval.scatvar_ = betaScatterAngleVar(mom,beta,pathlen);
+      } else {
+	retval.eloss_ = retval.elossvar_ = 0.0;
+	retval.scatvar_ = 1.0;
+      }
+      return retval;
+    }
+
   double
     DetMaterial::dEdx(double mom,dedxtype type,double mass) const {
       if(mom>0.0){
-	double Eexc2 = _eexc*_eexc ;
+	double energy = particleEnergy(mom,mass);
+	return dEdx(mom/energy,energy/mass,type,mass);
+      } else
+	return 0.0;
+    }
+
+  double
+    DetMaterial::dEdx(double beta,double gamma,dedxtype type,double mass) const {
+	double Eexc2 = _data._eexc*_data._eexc ;
 
 	// New energy loss implementation
 
 	double Tmax,gamma2,beta2,bg2,rcut,delta,x,sh,dedx ;
-	double beta  = particleBeta(mom,mass) ;
-	double gamma = particleGamma(mom,mass) ;
 	double tau = gamma-1. ;
 
 	// high energy part , Bethe-Bloch formula 
@@ -167,23 +196,23 @@ namespace MatEnv {
 	if(type == loss)
 	  dedx -= 2.*beta2;
 	else {
-	  rcut =  ( _cutOffEnergy< Tmax) ? _cutOffEnergy/Tmax : 1;
+	  rcut =  ( _data._cutOffEnergy< Tmax) ? _data._cutOffEnergy/Tmax : 1;
 	  dedx += log(rcut)-(1.+rcut)*beta2;
 	}
 
 	// density correction 
 	x = log(bg2)/twoln10 ;
-	if ( x < _x0 ) {
-	  if(_delta0 > 0) {
-	    delta = _delta0*pow(10.0,2*(x-_x0));
+	if ( x < _data._x0 ) {
+	  if(_data._delta0 > 0) {
+	    delta = _data._delta0*pow(10.0,2*(x-_data._x0));
 	  }
 	  else {
 	    delta = 0.;
 	  }
 	} else {
-	  delta = twoln10*x - _bigc;
-	  if ( x < _x1 )
-	    delta += _afactor * pow((_x1 - x), _mpower);
+	  delta = twoln10*x - _data._bigc;
+	  if ( x < _data._x1 )
+	    delta += _data._afactor * pow((_data._x1 - x), _data._mpower);
 	} 
 
 	// shell correction          
@@ -192,7 +221,7 @@ namespace MatEnv {
 	  x = 1. ;
 	  for (int k=0; k<=2; k++) {
 	    x *= bg2 ;
-	    sh += (*_shellCorrectionVector)[k]/x;
+	    sh += _data._shellCorrection[k]/x;
 	  }
 	}
 	else {
@@ -200,52 +229,42 @@ namespace MatEnv {
 	  x = 1. ;
 	  for (int k=0; k<2; k++) {
 	    x *= bg2lim ;
-	    sh += (*_shellCorrectionVector)[k]/x;
+	    sh += _data._shellCorrection[k]/x;
 	  }
-	  sh *= log(tau/_taul)/log(taulim/_taul);
+	  sh *= log(tau/_data._taul)/log(taulim/_data._taul);
 	}
 	dedx -= delta + sh ;
-	dedx *= -_dgev*_density*_za / beta2 ;
+	dedx *= -_dgev*_data._density*_data._za / beta2 ;
 	return dedx;
-      } else
-	return 0.0;
     }
 
 
 
   double 
     DetMaterial::energyLoss(double mom, double pathlen,double mass) const {
+      return dEdxEnergyLoss(mom,pathlen,mass,dEdx(mom,_data._elossType,mass));
+    }
+
+  double 
+    DetMaterial::dEdxEnergyLoss(double mom, double pathlen,double mass,double dedx) const {
       // make sure we take positive lengths!
       pathlen = fabs(pathlen);
-      double dedx = dEdx(mom,_elossType,mass);
       // see how far I can step, within tolerance, given this energy loss
       double maxstep = maxStepdEdx(mom,mass,dedx);
       // if this is larger than my path, I'm done
       if(maxstep>pathlen){
 	return dedx*pathlen;
       } else {
-	// subdivide the material
-	unsigned nstep = std::min(int(pathlen/maxstep) + 1,maxnstep);
-	double step = pathlen/nstep;
-	double energy = particleEnergy(mom,mass);
-	double deltae = step*dedx;
-	double newenergy(energy+deltae);
-	double eloss(deltae);
-	for(unsigned istep=0;istep<nstep-1;istep++){
-	  if(newenergy>mass){
-	    // compute the new dedx given the new momentum
-	    double newmom = particleMomentum(newenergy,mass);
-	    deltae = step*dEdx(newmom,_elossType,mass);
-	    // compute the loss in this step
-	    eloss += deltae;
-	    newenergy += deltae;
-	  } else {
-	    // lost all kinetic energy; stop
-	    eloss = mass-energy;
-	    break;
-	  }
+	// thick material: take the difference of ranges
+	MatRangeTable const* rtable = rangeTable(mass);
+	double tkin = particleKinEnergy(particleEnergy(mom,mass),mass);
+	if(rtable != 0 && tkin > rtable->tMin() && tkin < rtable->tMax()){
+	  double range = rtable->range(tkin) - pathlen;
+	  if(range > rtable->minRange())
+	    return rtable->kineticEnergy(range) - tkin;
 	}
-	return eloss;
+	// no table, or the particle leaves the bottom of it: integrate dE/dx explicitly
+	return stepEnergyChange(mom,pathlen,mass,dedx,maxstep,false);
       }
     }  
 
@@ -254,31 +273,67 @@ namespace MatEnv {
     DetMaterial::energyGain(double mom, double pathlen, double mass) const {
       // make sure we take positive lengths!
       pathlen = fabs(pathlen);
-      double dedx = dEdx(mom,_elossType,mass);
+      double dedx = dEdx(mom,_data._elossType,mass);
       // see how far I can step, within tolerance, given this energy loss
       double maxstep = maxStepdEdx(mom,mass,dedx);
       // if this is larger than my path, I'm done
       if(maxstep>pathlen){
 	return -dedx*pathlen;
       } else {
-	// subdivide the material
-	unsigned nstep = std::min(int(pathlen/maxstep) + 1,maxnstep);
-	double step = pathlen/nstep;
-	double energy = particleEnergy(mom,mass);
-	double deltae = -step*dedx;
-	// move to the middle of the slice of material
-	double newenergy(energy+deltae);
-	double egain(deltae);
-	for(unsigned istep=0;istep<nstep-1;istep++){
-	  // compute the new dedx given the new momentum
-	  double newmom = particleMomentum(newenergy,mass);
-	  double deltae = -step*dEdx(newmom,_elossType,mass);
-	  egain += deltae;
-	  newenergy += deltae;
+	MatRangeTable const* rtable = rangeTable(mass);
+	double tkin = particleKinEnergy(particleEnergy(mom,mass),mass);
+	if(rtable != 0 && tkin > rtable->tMin() && tkin < rtable->tMax()){
+	  double range = rtable->range(tkin) + pathlen;
+	  if(range < rtable->maxRange())
+	    return rtable->kineticEnergy(range) - tkin;
 	}
-	return egain;
+	return stepEnergyChange(mom,pathlen,mass,dedx,maxstep,true);
       }
     }  
+
+  MatRangeTable const*
+    DetMaterial::rangeTable(double mass) const {
+      for(auto const& rtable : _rangeTables)
+	if(fabs(rtable.mass()-mass) < 1.0e-6*mass) return &rtable;
+      return 0;
+    }
+
+  void
+    DetMaterial::addRangeTable(double mass) {
+      if(rangeTable(mass) == 0)_rangeTables.emplace_back(*this,mass);
+    }
+
+  void
+    DetMaterial::rebuildRangeTables() {
+      for(auto& rtable : _rangeTables)
+	rtable = MatRangeTable(*this,rtable.mass());
+    }
+
+  // subdivide the material and step through it, recomputing dE/dx at the middle of each step.
+  // This is only used for particles outside the range table, or materials without one
+  double
+    DetMaterial::stepEnergyChange(double mom,double pathlen,double mass,double dedx,double maxstep,bool gain) const {
+      double sign = gain ? -1.0 : 1.0;
+      unsigned nstep = std::min(int(pathlen/maxstep) + 1,maxnstep);
+      double step = pathlen/nstep;
+      double energy = particleEnergy(mom,mass);
+      double newenergy(energy);
+      for(unsigned istep=0;istep<nstep;istep++){
+	// Far below the dE/dx maximum the parameterization changes sign: the particle has effectively stopped
+	if(istep > 0) dedx = newenergy>mass ? dEdx(particleMomentum(newenergy,mass),_data._elossType,mass) : 0.0;
+	double midenergy = newenergy + 0.5*sign*step*dedx;
+	double middedx = midenergy>mass ? dEdx(particleMomentum(midenergy,mass),_data._elossType,mass) : 0.0;
+	if(dedx < 0.0 && middedx < 0.0)
+	  newenergy += sign*step*middedx;
+	else {
+	  // lost all kinetic energy; stop
+	  newenergy = mass;
+	  break;
+	}
+      }
+      return newenergy-energy;
+    }
+
   //
   // calculate the energy deposited in an absorber. That's similiar to 
   // energyLoss, but the delta electron correction in the Bethe Bloch is
@@ -338,7 +393,7 @@ namespace MatEnv {
 
   double
     DetMaterial::eloss_xi(double beta,double pathlen) const{
-      return _dgev*_za*_density*fabs(pathlen)/pow(beta,2);
+      return _dgev*_data._za*_data._density*fabs(pathlen)/pow(beta,2);
     }
 
   void
@@ -349,13 +404,13 @@ namespace MatEnv {
   void
     DetMaterial::printAll(ostream& os) const {
       os << "Material " << _name << " has properties : " << endl
-	<< "  Effective Z = " << _zeff << endl
-	<< "  Effective A = " << _aeff << endl
-	<< "  Density (g/cm^3) = " << _density*cm*cm*cm  << endl
-	<< "  Radiation Length (g/cm^2) = " << _radthick*cm*cm << endl
-	<< "  Interaction Length (g/cm^2) = " << _intLength << endl
-	//   << "  Mean Ionization energy (MeV) = " << _meanion << endl
-	<< "  Mean Ionization energy (MeV) = " << _eexc << endl;
+	<< "  Effective Z = " << _data._zeff << endl
+	<< "  Effective A = " << _data._aeff << endl
+	<< "  Density (g/cm^3) = " << _data._density*cm*cm*cm  << endl
+	<< "  Radiation Length (g/cm^2) = " << _data._radthick*cm*cm << endl
+	<< "  Interaction Length (g/cm^2) = " << _data._intLength << endl
+	//   << "  Mean Ionization energy (MeV) = " << _data._meanion << endl
+	<< "  Mean Ionization energy (MeV) = " << _data._eexc << endl;
     }
 
   double
@@ -379,7 +434,7 @@ namespace MatEnv {
   double
     DetMaterial::nSingleScatter(double mom,double pathlen, double mass) const {
       double beta = particleBeta(mom,mass);
-      return pathlen*_nbar/pow(beta,2);
+      return pathlen*_data._nbar/pow(beta,2);
     }
 
 
@@ -388,8 +443,8 @@ namespace MatEnv {
   double
     DetMaterial::highlandSigma(double mom,double pathlen, double mass) const {
       if(mom>0.0){
-	double radfrac = _invx0*fabs(pathlen);
-	return _msmom*sqrt(radfrac)/(mom*particleBeta(mom,mass));
+	double radfrac = _data._invx0*fabs(pathlen);
+	return _data._msmom*sqrt(radfrac)/(mom*particleBeta(mom,mass));
       } else
 	return 1.0;
     }
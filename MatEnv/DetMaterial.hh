@@ -17,22 +17,25 @@
 //  Babar includes
 //
 #include "MatEnv/MtrPropObj.hh"
+#include "MatEnv/MatRangeTable.hh"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <math.h>
 #include <algorithm>
+#include <type_traits>
 
 namespace MatEnv {
   class DetMaterial{
     public:
       enum dedxtype {loss=0,deposit};
+      struct Data; // material constants, see below
       //
       //  Constructor
       // new style
       DetMaterial(const char* detName, const MtrPropObj* detMtrProp);
-
-      ~DetMaterial();
+      // from precomputed constants (see MatDBSnapshot)
+      DetMaterial(const char* detName, const Data& data);
       //
       //  Access
       //
@@ -53,18 +56,30 @@ namespace MatEnv {
       }
       double energyDeposit(double mom, double pathlen,double mass) const;
       double energyGain(double mom,double pathlen, double mass) const;
+      // continuous-slowing-down range table for the given particle mass, or null if none was built.
+      // Without a table, thick-path energy changes are integrated stepwise
+      MatRangeTable const* rangeTable(double mass) const;
+      // build the range table for a particle mass.  Tables are built up front so that the
+      // const interface never modifies the material
+      void addRangeTable(double mass);
       double nSingleScatter(double mom,double pathlen, double mass) const;
       // terms used in first-principles single scattering model
-      double aParam(double mom) const { return 2.66e-6*pow(_zeff,0.33333333333333)/mom; }
-      double bParam(double mom) const { return    0.14/(mom*pow(_aeff,0.33333333333333)); }
+      double aParam(double mom) const { return 2.66e-6*pow(_data._zeff,0.33333333333333)/mom; }
+      double bParam(double mom) const { return    0.14/(mom*pow(_data._aeff,0.33333333333333)); }
       //
       // Single Gaussian approximation, used in Kalman filtering
       double scatterAngleRMS(double mom,double pathlen,double mass) const;
-      double scatterAngleVar(double mom,double pathlen,double mass) const {
-	double sarms = scatterAngleRMS(mom,pathlen,mass);
-	return sarms*sarms;
-      }
+      double scatterAngleVar(double mom,double pathlen,double mass) const;
       double highlandSigma(double mom,double pathlen, double mass) const;
+      //
+      // fused evaluation of all the effects used in Kalman filtering, sharing the kinematic
+      // terms.  This is equivalent to calling energyLoss, energyLossVar and scatterAngleVar
+      struct Interaction {
+	double eloss_; // energy loss (negative)
+	double elossvar_; // variance on the energy loss
+	double scatvar_; // single-plane scattering angle variance
+      };
+      Interaction interaction(double mom,double pathlen,double mass) const;
 
       static double particleEnergy(double mom,double mass) {
 	return sqrt(pow(mom,2)+pow(mass,2)); }
@@ -100,77 +115,88 @@ namespace MatEnv {
       // by more than the given tolerance (fraction).  This is an _approximate_ 
       // function, based on a crude model of dE/dx.
       static double maxStepdEdx(double mom,double mass, double dEdx,double tol=0.05);
-    protected:
       //
-      //  Constants used in material calculations
+      //  Compact, trivially-copyable block of the constants describing this material.
+      //  It is cache-line aligned and ordered so that dE/dx evaluations use only the first
+      //  2 cache lines, and scattering evaluations only the first and third.
       //
-      double _msmom; // constant in Highland scattering formula
+      enum {maxElements=8}; // capacity of the per-element arrays
+      struct alignas(64) Data {
+	double _density;
+	double _za; // ratio atomic number to atomic weight
+	double _eexc; // mean ionization energy loss for new e_loss routine
+	dedxtype _elossType;
+	int _noem; // number of elements
+	double _x0; /*  The following specify parameters for energy loss. see
+			Sternheimer etal,'Atomic Data and
+			Nuclear Data Tables', 1984 (40) 267 */
+	double _x1;
+	double _delta0; 
+	double _afactor;
+	double _mpower;
+	double _bigc;
+	double _shellCorrection[MtrPropObj::numShellV];
+	double _cutOffEnergy; // cut on max energy loss
+	double _taul;
+	double _invx0;
+	// values used in scattering
+	double _scatterfrac; // fraction of scattering distribution to include in RMS
+	double _chic2;
+	double _chia2_1;
+	double _chia2_2;
+	// values not used in Kalman filtering
+	double _nbar;
+	double _msmom; // constant in Highland scattering formula
+	double _zeff; // effective Z of our material
+	double _aeff; // effective Z of our material
+	double _radthick; // radiation thickness in g/cm**2
+	double _intLength; // ineraction length from MatMtrObj in g/cm**2
+	double _meanion; // mean ionization energy loss
+	double _vecNbOfAtomsPerVolume[maxElements];
+	double _vecTau0[maxElements];
+	double _vecAlow[maxElements];
+	double _vecBlow[maxElements];
+	double _vecClow[maxElements];
+	double _vecZ[maxElements];
+      };
+      Data const& data() const { return _data; }
+    protected:
       static double _minkappa; // ionization randomization parameter
       static double _dgev; // energy characterizing energy loss
       static const double _alpha; // fine structure constant
-      double _scatterfrac; // fraction of scattering distribution to include in RMS
-      double _cutOffEnergy; // cut on max energy loss
-      dedxtype _elossType;
-
-      //
-      //  Specific data for this material
-      //
+      Data _data;
       std::string _name;
-      double _za; // ratio atomic number to atomic weight
-      double _zeff; // effective Z of our material
-      double _aeff; // effective Z of our material
-      double _radthick; // radiation thickness in g/cm**2
-      double _intLength; // ineraction length from MatMtrObj in g/cm**2
-      double _meanion; // mean ionization energy loss
-      double _eexc; // mean ionization energy loss for new e_loss routine
-      double _x0; /*  The following specify parameters for energy loss. see
-		      Sternheimer etal,'Atomic Data and
-		      Nuclear Data Tables', 1984 (40) 267 */
-      double _x1;
-      double _delta0; 
-      double _afactor;
-      double _mpower;
-      double _bigc;
-      double _density;
-
-      int _noem;
-      std::vector< double >* _shellCorrectionVector;
-      std::vector< double >* _vecNbOfAtomsPerVolume;
-      std::vector< double >* _vecTau0;
-      std::vector< double >* _vecAlow;
-      std::vector< double >* _vecBlow;
-      std::vector< double >* _vecClow;
-      std::vector< double >* _vecZ;
-      double _taul;
-
-      // cached values to speed calculations
-      double _invx0;
-      double _nbar;
-      double _chic2;
-      double _chia2_1;
-      double _chia2_2;
+      // range tables, per particle mass.  These depend on the dE/dx type, and are rebuilt in place when it changes
+      std::vector<MatRangeTable> _rangeTables;
+      void rebuildRangeTables();
+      // kernels shared between the individual and fused functions
+      double dEdx(double beta, double gamma, dedxtype type, double mass) const;
+      double dEdxEnergyLoss(double mom, double pathlen, double mass, double dedx) const;
+      double betaScatterAngleVar(double mom, double beta, double pathlen) const;
+      // energy change from stepping through the material, used outside the range table
+      double stepEnergyChange(double mom,double pathlen,double mass,double dedx,double maxstep,bool gain) const;
 
     public:
       // baseic accessors
-      double ZA()const {return _za;}
-      double zeff() const { return _zeff;}
-      double aeff() const { return _aeff;}
-      double radiationLength()const {return _radthick;}
-      double intLength()const {return _intLength;}
-      double meanIon()const {return _meanion;}
-      double eexc() const { return _eexc; }
-      double X0()const {return _x0;}
-      double X1()const {return _x1;}
-      double delta0()const {return _delta0;}
-      double aFactor()const {return _afactor;}
-      double mPower()const {return _mpower;}
-      double bigC()const {return _bigc;}
-      double density()const {return _density;}
-      double inverseX0() const { return _invx0; }
+      double ZA()const {return _data._za;}
+      double zeff() const { return _data._zeff;}
+      double aeff() const { return _data._aeff;}
+      double radiationLength()const {return _data._radthick;}
+      double intLength()const {return _data._intLength;}
+      double meanIon()const {return _data._meanion;}
+      double eexc() const { return _data._eexc; }
+      double X0()const {return _data._x0;}
+      double X1()const {return _data._x1;}
+      double delta0()const {return _data._delta0;}
+      double aFactor()const {return _data._afactor;}
+      double mPower()const {return _data._mpower;}
+      double bigC()const {return _data._bigc;}
+      double density()const {return _data._density;}
+      double inverseX0() const { return _data._invx0; }
       // returns fraction of radiation lengths traversed for a given
       // physical distance through this material
       double radiationFraction(double pathlen) const {
-	return _density*pathlen/_radthick; }
+	return _data._density*pathlen/_data._radthick; }
       void print(std::ostream& os) const;
       void printAll(std::ostream& os ) const;
 
@@ -181,13 +207,15 @@ namespace MatEnv {
       static double minKappa() { return _minkappa; }
       static void setMinimumKappa(double minkappa) { _minkappa = minkappa; }
       // scattering parameter
-      double scatterFraction() const { return _scatterfrac;}
-      void setScatterFraction(double scatterfrac) {_scatterfrac = scatterfrac;}
-      double cutOffEnergy() const { return _cutOffEnergy;}
-      void setCutOffEnergy(double cutOffEnergy) {_cutOffEnergy = cutOffEnergy; _elossType = deposit; }
-      void setDEDXtype(dedxtype elossType) { _elossType = elossType;}
+      double scatterFraction() const { return _data._scatterfrac;}
+      void setScatterFraction(double scatterfrac) {_data._scatterfrac = scatterfrac;}
+      double cutOffEnergy() const { return _data._cutOffEnergy;}
+      void setCutOffEnergy(double cutOffEnergy) {_data._cutOffEnergy = cutOffEnergy; _data._elossType = deposit; rebuildRangeTables(); }
+      void setDEDXtype(dedxtype elossType) { _data._elossType = elossType; rebuildRangeTables(); }
+      dedxtype dEdxType() const { return _data._elossType; }
       static constexpr double e_mass_ = 5.10998910E-01; // electron mass in MeVC^2
   };
+  static_assert(std::is_trivially_copyable<DetMaterial::Data>::value,"DetMaterial data must be trivially copyable");
 }
 #endif
 
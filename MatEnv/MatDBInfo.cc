@@ -15,64 +15,146 @@
 //
 //------------------------------------------------------------------------
 #include "MatEnv/MatDBInfo.hh"
+#include "MatEnv/MatDBSnapshot.hh"
 #include "MatEnv/DetMaterial.hh"
 
 #include <string>
 #include <map>
+#include <stdexcept>
 namespace MatEnv {
 
   MatDBInfo::MatDBInfo() :
-    _genMatFactory(0)
-  {;}
+    _genMatFactory(0), _matStore(new MatSlot[_maxMaterials]), _nMat(0), _frozen(false)
+  {}
+
+  MatDBInfo::MatDBInfo( const std::vector<double>& masses ) : MatDBInfo()
+  {
+    _masses = masses;
+  }
 
   MatDBInfo::~MatDBInfo() {
-    // delete the materials
-    std::map< std::string*, DetMaterial*, PtrLess >::iterator 
-      iter = _matList.begin();
-    for (; iter != _matList.end(); ++iter) {
-      delete iter->first;
-      delete iter->second;
-    }
-    _matList.clear();
+    for(unsigned imat=0; imat < nMaterials(); ++imat)
+      detMaterial(MatHandle(imat)).~DetMaterial();
   }
 
-  void 
-    MatDBInfo::declareMaterial( const std::string& db_name,
+  void
+    MatDBInfo::addMaterialName( const std::string& db_name,
 	const std::string& detMatName )
     {
       _matNameMap[detMatName] = db_name;
       materialNames().push_back( detMatName );
-      return;
     }
 
-  const DetMaterial*
-    MatDBInfo::findDetMaterial( const std::string& matName ) const
+  void 
+    MatDBInfo::declareMaterial( const std::string& db_name,
+	const std::string& detMatName )
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(isFrozen())
+	throw std::logic_error("MatDBInfo: can't declare material " + detMatName + " after freezing");
+      addMaterialName(db_name,detMatName);
+    }
+
+  MatHandle
+    MatDBInfo::createMaterial( const std::string& db_name,
+	const std::string& detMatName ) const
     {
       if (_genMatFactory == 0)
 	that()->_genMatFactory = RecoMatFactory::getInstance();
+      MtrPropObj* genMtrProp = _genMatFactory->GetMtrProperties(db_name);
+      if(genMtrProp != 0)
+	return storeMaterial(DetMaterial( detMatName.c_str(), genMtrProp ));
+      else
+	return MatHandle();
+    }
+
+  MatHandle
+    MatDBInfo::storeMaterial( const DetMaterial& dmat ) const
+    {
+      unsigned nmat = _nMat.load(std::memory_order_relaxed);
+      if(nmat == _maxMaterials)
+	throw std::length_error("MatDBInfo: material store is full");
+      DetMaterial* newmat = new(&_matStore[nmat]) DetMaterial( dmat );
+      // range tables are built before the material is published
+      for(double mass : _masses)
+	newmat->addRangeTable(mass);
+      that()->_nMat.store(nmat+1,std::memory_order_release);
+      return MatHandle(nmat);
+    }
 
-      DetMaterial* theMat;
-      std::map< std::string*, DetMaterial*, PtrLess >::const_iterator pos;
-      if ((pos = _matList.find((std::string*)&matName)) != _matList.end()) {
-	theMat = pos->second;
+  void
+    MatDBInfo::loadSnapshot( const MatDBSnapshot& snapshot )
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(isFrozen())
+	throw std::logic_error("MatDBInfo: can't load a snapshot after freezing");
+      for(unsigned imat=0; imat < snapshot.nMaterials(); ++imat) {
+	const MatDBSnapshot::Record& rec = snapshot.record(imat);
+	std::string name(rec._name);
+	if(_matList.find(name) == _matList.end()) {
+	  _matList[name] = storeMaterial(DetMaterial(rec._name,rec._data));
+	  addMaterialName(name,name);
+	}
+      }
+    }
+
+  void
+    MatDBInfo::freeze()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(isFrozen()) return;
+      for(auto const& matname : _matNameMap) {
+	if(_matList.find(matname.first) == _matList.end()) {
+	  MatHandle handle = createMaterial( matname.second, matname.first );
+	  if(handle.isValid())
+	    _matList[matname.first] = handle;
+	  else
+	    ErrMsg( error ) << "MatDBInfo: Cannot find declared material " << matname.first
+	      << "." << endmsg;
+	}
+      }
+      _frozen.store(true,std::memory_order_release);
+    }
+
+  MatHandle
+    MatDBInfo::findMaterialHandle( const std::string& matName ) const
+    {
+      // once frozen, the declared material table can be read without locking
+      if(isFrozen()){
+	std::map< std::string, MatHandle >::const_iterator pos = _matList.find(matName);
+	if(pos != _matList.end()) return pos->second;
+      }
+      std::lock_guard<std::mutex> lock(_mutex);
+      bool frozen = isFrozen();
+      std::map< std::string, MatHandle >& matList = frozen ? that()->_lateMatList : that()->_matList;
+      MatHandle handle;
+      std::map< std::string, MatHandle >::const_iterator pos;
+      if ((pos = matList.find(matName)) != matList.end()) {
+	handle = pos->second;
       } else {
 	// first, look for aliases
-	std::string theName;
 	std::map< std::string, std::string >::const_iterator matNamePos;
 	if ((matNamePos = _matNameMap.find(matName)) != _matNameMap.end()) {
-	  theName = matNamePos->second;
-	  theMat = createMaterial<DetMaterial>( theName, matName);
+	  handle = createMaterial( matNamePos->second, matName);
 	} else {
 	  //then , try to find the material name directly
-	  theMat = createMaterial<DetMaterial>( matName, matName);
+	  handle = createMaterial( matName, matName);
 	  // if we created a new material directly, add it to the list
-	  if(theMat != 0)that()->declareMaterial(matName,matName);
+	  if(handle.isValid() && !frozen)that()->addMaterialName(matName,matName);
 	}
+	if(handle.isValid()) matList[matName] = handle;
       }
-      if(theMat == 0){
+      if(!handle.isValid()){
 	ErrMsg( error ) << "MatDBInfo: Cannot find requested material " << matName
 	  << "." << endmsg;
       }
-      return theMat;
+      return handle;
+    }
+
+  const DetMaterial*
+    MatDBInfo::findDetMaterial( const std::string& matName ) const
+    {
+      MatHandle handle = findMaterialHandle(matName);
+      return handle.isValid() ? &detMaterial(handle) : 0;
     }
 }
@@ -23,35 +23,83 @@
 #include "MatEnv/MaterialInfo.hh"
 #include "MatEnv/RecoMatFactory.hh"
 #include "MatEnv/MtrPropObj.hh"
+#include "MatEnv/DetMaterial.hh"
+#include "MatEnv/MatHandle.hh"
 #include "MatEnv/ErrLog.hh"
 #include <string>
 #include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <type_traits>
 
 namespace MatEnv {
 
-  class DetMaterial;
   class RecoMatFactory;
   class MatBuildEnv;
+  class MatDBSnapshot;
 
+  //  Lookups are thread-safe.  Materials are created on demand, once per name, under a lock.
+  //  Before freeze() every lookup by name takes the lock.  A material is fully built before its
+  //  handle is published, and the store never moves, so a handle from any lookup can be used
+  //  without locking, even while other threads add materials.  After freeze() the name table of
+  //  the declared materials is immutable, and lookups of those materials by name are wait-free reads.
+  //  The name list (materialNames()) grows with lookups, and should only be read once frozen.
   class MatDBInfo : public MaterialInfo {
     public:
       MatDBInfo();
+      //  Build range tables for the given particle masses in every material of this store,
+      //  see DetMaterial::rangeTable
+      explicit MatDBInfo( const std::vector<double>& masses );
       virtual ~MatDBInfo();
       //  Find the material, given the name
       virtual const DetMaterial* findDetMaterial( const std::string& matName ) const;
-      template <class T> const T* findDetMaterial( const std::string& matName ) const;
-      // utility functions
+      //  Find the handle of a material in the store, given the name.  The handle
+      //  is invalid if the material can't be found
+      MatHandle findMaterialHandle( const std::string& matName ) const;
+      //  Access a material by handle
+      const DetMaterial& detMaterial( MatHandle handle ) const {
+	return *std::launder(reinterpret_cast<const DetMaterial*>(&_matStore[handle.index()])); }
+      unsigned nMaterials() const { return _nMat.load(std::memory_order_acquire); }
+      //  Declare a detector material name, built from the given DB material.
+      //  This must be done before freezing
+      void declareMaterial( const std::string& dbName, 
+	  const std::string& detMatName );
+      //  Add all the materials of a precompiled snapshot to the store.  Lookups of these
+      //  materials then don't need the text sources.  This must be done before freezing
+      void loadSnapshot( const MatDBSnapshot& snapshot );
+      //  Create all declared materials and freeze the name table
+      void freeze();
+      bool isFrozen() const { return _frozen.load(std::memory_order_acquire); }
     private:
-      template <class T> T* createMaterial( const std::string& dbName,
+      // the following require the lock to be held
+      MatHandle createMaterial( const std::string& dbName,
 	  const std::string& detMatName ) const;
-      void declareMaterial( const std::string& dbName, 
+      MatHandle storeMaterial( const DetMaterial& dmat ) const;
+      void addMaterialName( const std::string& dbName, 
 	  const std::string& detMatName );
       // Cache of RecoMatFactory pointer
       RecoMatFactory* _genMatFactory;
-      // Cache of list of materials for DetectorModel
-      std::map< std::string*, DetMaterial*, PtrLess > _matList;
+      // Materials are stored contiguously, indexed by handle, in storage allocated up front.
+      // The store never reallocates, so handles and material addresses are stable as it grows,
+      // and adding a material doesn't modify anything a reader of the existing materials uses
+      static constexpr unsigned _maxMaterials = 512;
+      typedef std::aligned_storage<sizeof(DetMaterial),alignof(DetMaterial)>::type MatSlot;
+      std::unique_ptr< MatSlot[] > _matStore;
+      std::atomic<unsigned> _nMat;
+      // Handles of materials for DetectorModel, by name.  This is immutable once frozen
+      std::map< std::string, MatHandle > _matList;
+      // Handles of materials created after freezing
+      std::map< std::string, MatHandle > _lateMatList;
       // Map for reco- and DB material names
       std::map< std::string, std::string > _matNameMap; 
+      std::atomic<bool> _frozen;
+      // particle masses for range tables
+      std::vector<double> _masses;
+      // lock for creating materials and modifying the name tables
+      mutable std::mutex _mutex;
       // function to cast-off const
       MatDBInfo* that() const {
 	return const_cast<MatDBInfo*>(this);
@@ -60,56 +108,5 @@ namespace MatEnv {
       friend class MatBuildEnv;
       friend class MatBuildCoreEnv;
   };
-
-  template <class T> T*
-    MatDBInfo::createMaterial( const std::string& db_name,
-	const std::string& detMatName ) const
-    {
-      MtrPropObj* genMtrProp;
-      T* theMat;
-
-      if (_genMatFactory == 0)
-	that()->_genMatFactory = RecoMatFactory::getInstance();
-
-      genMtrProp = _genMatFactory->GetMtrProperties(db_name);
-      if(genMtrProp != 0){
-	theMat = new T( detMatName.c_str(), genMtrProp ) ;
-	that()->_matList[new std::string( detMatName )] = theMat;
-	return theMat;
-      } else {
-	return 0;
-      }
-    }
-
-  template <class T> const T*
-    MatDBInfo::findDetMaterial( const std::string& matName ) const
-    {
-      if (_genMatFactory == 0)
-	that()->_genMatFactory = RecoMatFactory::getInstance();
-
-      T* theMat;
-      std::map< std::string*, DetMaterial*, PtrLess >::const_iterator pos;
-      if ((pos = _matList.find((std::string*)&matName)) != _matList.end()) {
-	theMat = (T*) pos->second;
-      } else {
-	// first, look for aliases
-	std::string theName;
-	std::map< std::string, std::string >::const_iterator matNamePos;
-	if ((matNamePos = _matNameMap.find(matName)) != _matNameMap.end()) {
-	  theName = matNamePos->second;
-	  theMat = createMaterial<T>( theName, matName);
-	} else {
-	  //then , try to find the material name directly
-	  theMat = createMaterial<T>( matName, matName);
-	  // if we created a new material directly, add it to the list
-	  if(theMat != 0)that()->declareMaterial(matName,matName);
-	}
-      }
-      if(theMat == 0){
-	ErrMsg( error ) << "MatDBInfo: Cannot find requested material " << matName
-	  << "." << endmsg;
-      }
-      return theMat;
-    }
 }
 #endif
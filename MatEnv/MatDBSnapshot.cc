@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------
+// Description:
+//	Class MatDBSnapshot, see MatDBSnapshot.hh
+//
+//------------------------------------------------------------------------
+#include "MatEnv/MatDBSnapshot.hh"
+#include "MatEnv/RecoMatFactory.hh"
+#include "MatEnv/MtrPropObj.hh"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MatEnv {
+
+  static const char snapshotMagic[8] = {'K','K','M','A','T','D','B','\0'};
+
+  std::uint64_t
+    MatDBSnapshot::sourceHash(const FileFinderInterface& fileFinder)
+    {
+      // FNV-1a over the contents of the dictionary files
+      std::uint64_t hash(14695981039346656037ULL);
+      std::string files[3] = { fileFinder.matIsoDictionaryFileName(),
+	fileFinder.matElmDictionaryFileName(), fileFinder.matMtrDictionaryFileName() };
+      for(auto const& file : files) {
+	std::ifstream ifs(file.c_str(),std::ios::binary);
+	if(!ifs) throw std::runtime_error("MatDBSnapshot: can't open " + file);
+	for(std::istreambuf_iterator<char> ich(ifs); ich != std::istreambuf_iterator<char>(); ++ich) {
+	  hash ^= static_cast<unsigned char>(*ich);
+	  hash *= 1099511628211ULL;
+	}
+      }
+      return hash;
+    }
+
+  void
+    MatDBSnapshot::write(const std::string& filename, const FileFinderInterface& fileFinder)
+    {
+      RecoMatFactory* factory = RecoMatFactory::getInstance();
+      std::vector<Record> records;
+      for(auto const& imat : *factory->materialDictionary()) {
+	const std::string& name = *imat.first;
+	if(name.size() > maxNameLength)
+	  throw std::invalid_argument("MatDBSnapshot: material name too long " + name);
+	DetMaterial dmat(name.c_str(),factory->GetMtrProperties(name));
+	Record record;
+	std::memset(&record,0,sizeof(record));
+	std::memcpy(&record._data,&dmat.data(),sizeof(DetMaterial::Data));
+	name.copy(record._name,maxNameLength);
+	records.push_back(record);
+      }
+      Header header;
+      std::memset(&header,0,sizeof(header));
+      std::memcpy(header._magic,snapshotMagic,sizeof(snapshotMagic));
+      header._version = version;
+      header._nmat = records.size();
+      header._recordSize = sizeof(Record);
+      header._maxElements = DetMaterial::maxElements;
+      header._sourceHash = sourceHash(fileFinder);
+      std::ofstream ofs(filename.c_str(),std::ios::binary|std::ios::trunc);
+      ofs.write(reinterpret_cast<const char*>(&header),sizeof(header));
+      ofs.write(reinterpret_cast<const char*>(records.data()),records.size()*sizeof(Record));
+      if(!ofs) throw std::runtime_error("MatDBSnapshot: can't write " + filename);
+    }
+
+  MatDBSnapshot::MatDBSnapshot(const std::string& filename) :
+    _map(0), _size(0), _header(0), _records(0)
+  {
+    int fd = open(filename.c_str(),O_RDONLY);
+    if(fd < 0) throw std::runtime_error("MatDBSnapshot: can't open " + filename);
+    struct stat st;
+    if(fstat(fd,&st) == 0 && st.st_size >= (off_t)sizeof(Header)){
+      _size = st.st_size;
+      _map = mmap(0,_size,PROT_READ,MAP_PRIVATE,fd,0);
+    }
+    close(fd);
+    if(_map == 0 || _map == MAP_FAILED) {
+      _map = 0;
+      throw std::runtime_error("MatDBSnapshot: can't map " + filename);
+    }
+    _header = static_cast<const Header*>(_map);
+    _records = reinterpret_cast<const Record*>(_header+1);
+    if(std::memcmp(_header->_magic,snapshotMagic,sizeof(snapshotMagic)) != 0 ||
+	_header->_version != version ||
+	_header->_recordSize != sizeof(Record) ||
+	_header->_maxElements != DetMaterial::maxElements ||
+	_size != sizeof(Header) + _header->_nmat*sizeof(Record)) {
+      munmap(_map,_size);
+      _map = 0;
+      throw std::runtime_error("MatDBSnapshot: incompatible file " + filename);
+    }
+  }
+
+  MatDBSnapshot::~MatDBSnapshot() {
+    if(_map != 0) munmap(_map,_size);
+  }
+
+  bool
+    MatDBSnapshot::isCurrent(const FileFinderInterface& fileFinder) const
+    {
+      return snapshotHash() == sourceHash(fileFinder);
+    }
+
+  unsigned
+    MatDBSnapshot::validate(std::ostream& os, const FileFinderInterface& fileFinder) const
+    {
+      unsigned nbad(0);
+      if(!isCurrent(fileFinder)) {
+	os << "MatDBSnapshot: text sources have changed since the snapshot was made" << std::endl;
+	++nbad;
+      }
+      RecoMatFactory* factory = RecoMatFactory::getInstance();
+      if(factory->materialDictionary()->size() != nMaterials()) {
+	os << "MatDBSnapshot: snapshot has " << nMaterials() << " materials, text sources have "
+	  << factory->materialDictionary()->size() << std::endl;
+	++nbad;
+      }
+      for(unsigned imat=0; imat < nMaterials(); ++imat) {
+	const Record& rec = record(imat);
+	std::string name(rec._name);
+	MtrPropObj* mtrprop = factory->GetMtrProperties(name);
+	if(mtrprop == 0) {
+	  os << "MatDBSnapshot: material " << name << " not found in text sources" << std::endl;
+	  ++nbad;
+	} else {
+	  DetMaterial dmat(name.c_str(),mtrprop);
+	  // records are built from zero-initialized blocks, so a bytewise comparison is exact
+	  if(std::memcmp(&dmat.data(),&rec._data,sizeof(DetMaterial::Data)) != 0) {
+	    os << "MatDBSnapshot: material " << name << " differs from text sources" << std::endl;
+	    ++nbad;
+	  }
+	}
+      }
+      return nbad;
+    }
+}
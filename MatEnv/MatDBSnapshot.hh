@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------
+// Description:
+//	Class MatDBSnapshot.  Compact binary image of the fully-resolved material
+//      database.  Each record holds a material name and its DetMaterial
+//      constants, so that a MatDBInfo can be populated without parsing the
+//      text dictionaries or computing MtrPropObj properties.  The image is
+//      memory-mapped read-only.  The header records a hash of the text sources
+//      it was built from, so that stale images can be detected.
+//
+//------------------------------------------------------------------------
+#ifndef MATDBSNAPSHOT_HH
+#define MATDBSNAPSHOT_HH
+
+#include "MatEnv/DetMaterial.hh"
+#include "MatEnv/FileFinderInterface.hh"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+namespace MatEnv {
+
+  class MatDBSnapshot {
+    public:
+      enum {version=1, maxNameLength=63};
+      struct alignas(64) Header {
+	char _magic[8];
+	std::uint32_t _version;
+	std::uint32_t _nmat;
+	std::uint32_t _recordSize;
+	std::uint32_t _maxElements;
+	std::uint64_t _sourceHash; // hash of the text sources
+      };
+      struct Record {
+	DetMaterial::Data _data;
+	char _name[maxNameLength+1];
+      };
+      // write the snapshot of all materials in the text sources
+      static void write(const std::string& filename,
+	  const FileFinderInterface& fileFinder=SimpleFileFinder());
+      // hash of the text sources
+      static std::uint64_t sourceHash(const FileFinderInterface& fileFinder=SimpleFileFinder());
+      // map an existing snapshot; this throws if the file is missing or malformed
+      explicit MatDBSnapshot(const std::string& filename);
+      ~MatDBSnapshot();
+      MatDBSnapshot(const MatDBSnapshot&) = delete;
+      MatDBSnapshot& operator = (const MatDBSnapshot&) = delete;
+      // accessors
+      unsigned nMaterials() const { return _header->_nmat; }
+      const Record& record(unsigned imat) const { return _records[imat]; }
+      std::uint64_t snapshotHash() const { return _header->_sourceHash; }
+      // check that the snapshot was built from the current text sources
+      bool isCurrent(const FileFinderInterface& fileFinder=SimpleFileFinder()) const;
+      // full validation: compare every record with the material built from the text sources.
+      // Differences are printed to the stream.  Returns the number of bad records
+      unsigned validate(std::ostream& os, const FileFinderInterface& fileFinder=SimpleFileFinder()) const;
+    private:
+      void* _map;
+      std::size_t _size;
+      const Header* _header;
+      const Record* _records;
+  };
+}
+#endif
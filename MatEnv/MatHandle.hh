@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------------
+// Description:
+//	Class MatHandle.  Stable integer handle of a DetMaterial in the
+//      material store of a MatDBInfo.
+//
+//------------------------------------------------------------------------
+#ifndef MATHANDLE_HH
+#define MATHANDLE_HH
+
+namespace MatEnv {
+
+  class MatHandle {
+    public:
+      MatHandle() : _index(invalid()) {}
+      explicit MatHandle(unsigned index) : _index(index) {}
+      unsigned index() const { return _index; }
+      bool isValid() const { return _index != invalid(); }
+      bool operator == (MatHandle const& other) const { return _index == other._index; }
+      bool operator != (MatHandle const& other) const { return _index != other._index; }
+      static constexpr unsigned invalid() { return ~0u; }
+    private:
+      unsigned _index;
+  };
+}
+#endif
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+//  Description:
+//  Continuous-slowing-down (CSDA) range table, see MatRangeTable.hh
+//
+//  Authors: Dave Brown, LBNL
+//------------------------------------------------------------------------------
+#include "MatEnv/MatRangeTable.hh"
+#include "MatEnv/DetMaterial.hh"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace MatEnv {
+
+  MatRangeTable::MatRangeTable(DetMaterial const& dmat, double mass) : _mass(mass) {
+    // start the table at the dE/dx maximum (or bgmin_).  Below that the parameterization is unphysical
+    double bglow = bgstart_;
+    double dbg = pow(10.0,-1.0/ndecade_);
+    while(bglow*dbg > bgmin_ && dmat.dEdx(bglow*dbg*mass,dmat.dEdxType(),mass) < dmat.dEdx(bglow*mass,dmat.dEdxType(),mass))
+      bglow *= dbg;
+    _tmin = mass*(sqrt(1.0+bglow*bglow)-1.0);
+    _tmax = mass*(sqrt(1.0+bgmax_*bgmax_)-1.0);
+    _lnt0 = log(_tmin);
+    unsigned nnodes = unsigned(ceil(ndecade_*log10(_tmax/_tmin)))+1;
+    _dlnt = (log(_tmax)-_lnt0)/(nnodes-1);
+    _range.reserve(nnodes);
+    _drange.reserve(nnodes);
+    // integrand dR/dln(T) = T/|dE/dx|.  Protect against unphysical (non-negative) dE/dx
+    auto drdu = [&dmat,mass](double lnt) {
+      double tkin = exp(lnt);
+      double mom = DetMaterial::particleMomentum(tkin+mass,mass);
+      return tkin/std::max(-dmat.dEdx(mom,dmat.dEdxType(),mass),double(FLT_MIN));
+    };
+    // below the table dE/dx ~ 1/T, so R(T) = T/(2|dE/dx|)
+    _drange.push_back(drdu(_lnt0));
+    _range.push_back(0.5*_drange.back());
+    for(unsigned inode=1;inode<nnodes;inode++){
+      double lnt = _lnt0 + inode*_dlnt;
+      // Simpson integration across the cell
+      double dmid = drdu(lnt-0.5*_dlnt);
+      _drange.push_back(drdu(lnt));
+      _range.push_back(_range.back() + _dlnt*(_drange[inode-1] + 4.0*dmid + _drange[inode])/6.0);
+    }
+  }
+
+  double MatRangeTable::cellRange(unsigned icell, double frac) const {
+    double f2 = frac*frac;
+    double f3 = f2*frac;
+    return (2.0*f3-3.0*f2+1.0)*_range[icell] + (f3-2.0*f2+frac)*_dlnt*_drange[icell]
+      + (3.0*f2-2.0*f3)*_range[icell+1] + (f3-f2)*_dlnt*_drange[icell+1];
+  }
+
+  double MatRangeTable::cellDRange(unsigned icell, double frac) const {
+    double f2 = frac*frac;
+    return 6.0*(f2-frac)*(_range[icell]-_range[icell+1])
+      + (3.0*f2-4.0*frac+1.0)*_dlnt*_drange[icell] + (3.0*f2-2.0*frac)*_dlnt*_drange[icell+1];
+  }
+
+  double MatRangeTable::range(double tkin) const {
+    if(tkin <= _tmin) return _range.front()*pow(tkin/_tmin,2);
+    double u = (log(tkin)-_lnt0)/_dlnt;
+    unsigned icell = std::min(unsigned(u),unsigned(_range.size()-2));
+    return cellRange(icell,u-icell);
+  }
+
+  double MatRangeTable::kineticEnergy(double range) const {
+    if(range <= _range.front()) return _tmin*sqrt(std::max(range,0.0)/_range.front());
+    unsigned icell = std::min(unsigned(std::upper_bound(_range.begin(),_range.end(),range)-_range.begin()),
+	unsigned(_range.size()-1)) - 1;
+    // invert the cubic with Newton iterations, starting from the linear estimate.  The cubic is monotonic
+    double frac = (range-_range[icell])/(_range[icell+1]-_range[icell]);
+    static const unsigned maxniter = 4;
+    for(unsigned iter=0;iter<maxniter;iter++){
+      double dfrac = (range-cellRange(icell,frac))/cellDRange(icell,frac);
+      frac = std::min(std::max(frac+dfrac,0.0),1.0);
+      if(fabs(dfrac) < 1.0e-12)break;
+    }
+    return exp(_lnt0 + (icell+frac)*_dlnt);
+  }
+}
@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------------
+//  Description:
+//  Continuous-slowing-down (CSDA) range table for a particle of given mass
+//  traversing a DetMaterial.  The range R(T) = int dT/|dE/dx| is tabulated on a
+//  logarithmic kinetic energy grid, and interpolated using cubic Hermite
+//  polynomials built from the exact dR/dT = 1/|dE/dx| at the nodes.  The energy
+//  change over a finite path is then range(T) -/+ pathlen followed by an inverse
+//  lookup, independent of how thick the material is.
+//  Below the bottom of the table the range is extrapolated assuming dE/dx ~ 1/T; this is
+//  only an estimate, and energy changes which leave the table must be integrated explicitly.
+//
+//  Authors: Dave Brown, LBNL
+//------------------------------------------------------------------------------
+#ifndef MatEnv_MatRangeTable_hh
+#define MatEnv_MatRangeTable_hh
+#include <vector>
+
+namespace MatEnv {
+  class DetMaterial;
+  class MatRangeTable {
+    public:
+      // build the table for the material's current dE/dx type
+      MatRangeTable(DetMaterial const& dmat, double mass);
+      double mass() const { return _mass; }
+      // kinetic energy (MeV) limits of the table
+      double tMin() const { return _tmin; }
+      double tMax() const { return _tmax; }
+      // range limits of the table
+      double minRange() const { return _range.front(); }
+      double maxRange() const { return _range.back(); }
+      // CSDA range (mm) for a given kinetic energy (MeV); tkin must be < tMax
+      double range(double tkin) const;
+      // inverse: kinetic energy (MeV) with the given residual range (mm); range must be < maxRange
+      double kineticEnergy(double range) const;
+      // grid parameters, in units of beta*gamma
+      // the table starts at the dE/dx maximum, searched for downwards from bgstart_
+      static constexpr double bgstart_ = 0.1;
+      static constexpr double bgmin_ = 0.01;
+      static constexpr double bgmax_ = 1.0e5;
+      static constexpr unsigned ndecade_ = 200; // nodes/decade
+    private:
+      double _mass;
+      double _tmin, _tmax; // kinetic energy range
+      double _lnt0, _dlnt; // grid in ln(T)
+      std::vector<double> _range; // range at each node
+      std::vector<double> _drange; // dR/dln(T) at each node
+      // Hermite interpolation within a cell, and its derivative WRT the cell fraction
+      double cellRange(unsigned icell, double frac) const;
+      double cellDRange(unsigned icell, double frac) const;
+  };
+}
+#endif
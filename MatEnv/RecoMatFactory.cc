@@ -57,6 +57,7 @@ namespace MatEnv {
   ElmPropObj*
     RecoMatFactory::GetElmProperties( const std::string& name )
     {    
+      std::lock_guard<std::recursive_mutex> lock(_mutex);
       std::map< std::string*, ElmPropObj*, PtrLess >::iterator elmPos;
       if ((elmPos = _theElmPropDict->find((std::string*)&name)) != _theElmPropDict->end()) {
 	//    cout << " the ElmPropObj " << name << " is already built ! " << endl;
@@ -83,6 +84,7 @@ namespace MatEnv {
   MtrPropObj*
     RecoMatFactory::GetMtrProperties(const std::string& name) 
     {    
+      std::lock_guard<std::recursive_mutex> lock(_mutex);
       std::map< std::string*, MtrPropObj*, PtrLess >::iterator mtrPos;
       if ((mtrPos = _theMtrPropDict->find((std::string*)&name)) != _theMtrPropDict->end()) {
 	//    cout << " the MtrPropObj " << name << " is already built ! " << endl;
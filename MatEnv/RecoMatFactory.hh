@@ -40,6 +40,7 @@
 
 #include <string>
 #include <map>
+#include <mutex>
 
 //------------------------------------
 // Collaborating Class Declarations --
@@ -82,6 +83,8 @@ namespace MatEnv {
       MatMtrDictionary* _theMtrDict;
       std::map< std::string*, ElmPropObj*, PtrLess >* _theElmPropDict;
       std::map< std::string*, MtrPropObj*, PtrLess >* _theMtrPropDict; 
+      // serialize building the property objects.  Materials are built recursively from their components
+      std::recursive_mutex _mutex;
   };
 }
 #endif // RECOMATFACTORY_HH
@@ -0,0 +1,111 @@
+//
+// Compare joint left-right ambiguity resolution of adjacent hits (AmbigResolver) with resolving each hit separately (WireHitUpdater
+// alone), on the same events with unresolved initial ambiguities.  The joint resolution must not be worse: it must give a momentum
+// resolution at least as good, and assign as many correct and no more wrong ambiguities, within the statistical error of the counts.
+// The two trade correct against wrong assignments (of hits within about the drift resolution of the wire) differently, so the counts
+// only agree within that error
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/TLine.hh"
+#include "KinKal/TPoca.hh"
+#include "KinKal/KKTrk.hh"
+#include "KinKal/WireHit.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <string>
+
+using namespace KinKal;
+using namespace std;
+// avoid confusion with root
+using KinKal::TLine;
+
+void print_usage() {
+  printf("Usage: AmbigResolverTest --nevents i --seed i --ambigdoca f\n");
+}
+
+// fit the events with the given schedule, count the final ambiguities of the active hits that are correct and wrong compared to
+// the truth, and return the RMS error of the fit momentum at the middle of the track
+template <class KTRAJ> double fitAmbigs(KKTest::ToyFit<KTRAJ>& toyfit, string const& sfile, unsigned nevents, int iseed,
+    unsigned& nfit, unsigned& nambig, unsigned& ngood, unsigned& nwrong) {
+  typedef TPoca<PKTraj<KTRAJ>,TLine> TPOCA;
+  auto configptr = toyfit.config(sfile,false);
+  double dmomsq(0.0);
+  nfit = nambig = ngood = nwrong = 0;
+  for(unsigned iev=0;iev < nevents; iev++){
+    typename KKTest::ToyFit<KTRAJ>::PKTRAJ tptraj;
+    typename KKTest::ToyFit<KTRAJ>::THITCOL thits;
+    typename KKTest::ToyFit<KTRAJ>::DXINGCOL dxings;
+    KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+    KKTrk<KTRAJ> kktrk(configptr,seedtraj,thits,dxings);
+    if(!kktrk.fitStatus().usable()) continue;
+    nfit++;
+    double tmid = tptraj.range().mid();
+    double dmom = kktrk.fitTraj().momentumMag(tmid) - tptraj.momentumMag(tmid);
+    dmomsq += dmom*dmom;
+    for(auto const& thit : thits){
+      auto whit = dynamic_cast<WireHit<KTRAJ> const*>(thit.get());
+      if(!(whit != 0 && whit->isActive())) continue;
+      TPOCA ttpoca(tptraj,whit->wire(),TPocaHint(),TPocaConfig());
+      if(!ttpoca.usable()) continue;
+      nambig++;
+      if(whit->ambig() == (ttpoca.doca() < 0 ? LRAmbig::left : LRAmbig::right))
+	ngood++;
+      else if(whit->ambig() != LRAmbig::null)
+	nwrong++;
+    }
+  }
+  return nfit > 0 ? sqrt(dmomsq/nfit) : 0.0;
+}
+
+template <class KTRAJ>
+int AmbigResolverTest(int argc, char **argv) {
+  int opt;
+  unsigned nevents(1000);
+  int iseed(123421);
+  double ambigdoca(10.0); // larger than the straw radius: the simulation leaves every hit ambiguity unresolved
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {"ambigdoca",     required_argument, 0, 'a'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      case 'a' : ambigdoca = atof(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  // the fits don't include material: see AmbigResolver for how it's handled
+  KKTest::ToyFit<KTRAJ> toyfit(40,false,ambigdoca);
+  unsigned nambig[2], ngood[2], nwrong[2], nfit[2];
+  double momrms[2];
+  momrms[0] = fitAmbigs(toyfit,"HitUpdateSchedule.txt",nevents,iseed,nfit[0],nambig[0],ngood[0],nwrong[0]);
+  momrms[1] = fitAmbigs(toyfit,"AmbigResolverSchedule.txt",nevents,iseed,nfit[1],nambig[1],ngood[1],nwrong[1]);
+  const char* names[2] = {"separate","joint"};
+  for(size_t ires=0;ires<2;ires++)
+    cout << KTRAJ::trajName() << " " << names[ires] << " resolution: " << nfit[ires] << " usable fits of " << nevents << " events, "
+      << nambig[ires] << " active hits, " << ngood[ires] << " correct and " << nwrong[ires] << " wrong ambiguities, momentum RMS error "
+      << momrms[ires] << " MeV/c" << endl;
+  int status(0);
+  // twice the Poisson errors on the numbers of wrong and unassigned ambiguities
+  double wrongerr = 2.0*sqrt(double(nwrong[0]));
+  double gooderr = 2.0*sqrt(double(nambig[0]-ngood[0]));
+  if(nfit[0] == 0 || nfit[1] < nfit[0] || ngood[1] + gooderr < ngood[0] || nwrong[1] > nwrong[0] + wrongerr || momrms[1] > momrms[0]){
+    cout << "AmbigResolver test failed" << endl;
+    status = 1;
+  }
+  return status;
+}
@@ -150,7 +150,7 @@ int BFieldTest(int argc, char **argv) {
     auto dpfrac = dp/mom.R();
     DVEC dpars = dpfrac.Dot(t1hat)*dpdt1 + dpfrac.Dot(t2hat)*dpdt2;
     KTRAJ lnew = lptraj.back();
-    lnew.params() += dpars;
+    lnew.setParams(typename KTRAJ::PDATA(lnew.params().parameters() + dpars,lnew.params().covariance()));
     lnew.setRange(prange);
     lptraj.append(lnew);
     gap = xptraj.gap(xptraj.pieces().size()-1);
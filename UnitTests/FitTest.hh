@@ -31,6 +31,7 @@
 #include <chrono>
 #include <cfenv>
 #include <memory>
+#include <type_traits>
 #include <cstdlib>
 #include <cstring>
 
@@ -262,6 +263,8 @@ int FitTest(int argc, char **argv) {
   // buffer the seed range
   TRange seedrange(tptraj.range().low()-0.5,tptraj.range().high()+0.5);
   KTRAJ seedtraj(midhel.pos4(0.0),seedmom,midhel.charge(),bnom,seedrange);
+  // trajectories that integrate the field map need it explicitly
+  if constexpr (std::is_constructible<KTRAJ,KTRAJ const&,BField const&>::value) seedtraj = KTRAJ(seedtraj,*BF);
   if(invert) seedtraj.invertCT(); // for testing wrong propagation direction
   toy.createSeed(seedtraj);
   cout << "Seed params " << seedtraj.params().parameters() <<" covariance " << endl << seedtraj.params().covariance() << endl;
@@ -287,16 +290,7 @@ int FitTest(int argc, char **argv) {
     }
   }
   std::ifstream ifs (fullfile, std::ifstream::in);
-  string line;
-  unsigned nmiter(0);
-  while (getline(ifs,line)){ 
-    if(strncmp(line.c_str(),"#",1)!=0){
-      istringstream ss(line);
-      MConfig mconfig(ss);
-      mconfig.miter_ = nmiter++;
-      configptr->schedule_.push_back(mconfig);
-    }
-  }
+  configptr->readSchedule<WireHitUpdater,AmbigResolver>(ifs);
   cout << *configptr << endl;
 // create and fit the track
   KKTRK kktrk(configptr,seedtraj,thits,dxings);
@@ -318,22 +312,24 @@ int FitTest(int argc, char **argv) {
     fitpl->SetLineColor(kBlue);
     fitpl->SetLineStyle(kSolid);
     double ts = fithel.range().range()/(np-1);
-    for(unsigned ip=0;ip<np;ip++){
-      double tp = fithel.range().low() + ip*ts;
-      Vec3 ppos = fithel.position(tp);
-      fitpl->SetPoint(ip,ppos.X(),ppos.Y(),ppos.Z());
-    }
+    std::vector<double> ptimes(np);
+    std::vector<Vec3> ppos;
+    for(unsigned ip=0;ip<np;ip++)
+      ptimes[ip] = fithel.range().low() + ip*ts;
+    fithel.positions(ptimes,ppos);
+    for(unsigned ip=0;ip<np;ip++)
+      fitpl->SetPoint(ip,ppos[ip].X(),ppos[ip].Y(),ppos[ip].Z());
     fitpl->Draw();
 // now draw the truth
     TPolyLine3D* ttpl = new TPolyLine3D(np);
     ttpl->SetLineColor(kGreen);
     ttpl->SetLineStyle(kDashDotted);
     ts = tptraj.range().range()/(np-1);
-    for(unsigned ip=0;ip<np;ip++){
-      double tp = tptraj.range().low() + ip*ts;
-      Vec3 ppos = tptraj.position(tp);
-      ttpl->SetPoint(ip,ppos.X(),ppos.Y(),ppos.Z());
-    }
+    for(unsigned ip=0;ip<np;ip++)
+      ptimes[ip] = tptraj.range().low() + ip*ts;
+    tptraj.positions(ptimes,ppos);
+    for(unsigned ip=0;ip<np;ip++)
+      ttpl->SetPoint(ip,ppos[ip].X(),ppos[ip].Y(),ppos[ip].Z());
     ttpl->Draw();
     // draw the hits
     std::vector<TPolyLine3D*> htpls;
@@ -466,6 +462,7 @@ int FitTest(int argc, char **argv) {
       seedmom.SetM(fitmass);
       TRange seedrange(tptraj.range().low()-0.5,tptraj.range().high()+0.5);
       KTRAJ seedtraj(midhel.pos4(tmid),seedmom,midhel.charge(),bnom,seedrange);
+      if constexpr (std::is_constructible<KTRAJ,KTRAJ const&,BField const&>::value) seedtraj = KTRAJ(seedtraj,*BF);
       if(invert)seedtraj.invertCT();
       toy.createSeed(seedtraj);
       auto start = Clock::now();
@@ -0,0 +1,87 @@
+//
+// Test that the fit results don't depend on how the fit holds its hits and material crossings (see HandlePolicy): fits of the same
+// events sharing (SharedHandles) and borrowing (BorrowedHandles) them must give identical results, with and without material, and
+// after removing and adding back a hit.  Each fit gets freshly simulated hits, as the fit changes their state
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "KinKal/HandlePolicy.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: HandlePolicyTest --nevents i --seed i\n");
+}
+
+template <class KTRAJ>
+int HandlePolicyTest(int argc, char **argv) {
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  int status(0);
+  for(bool fitmat : {false, true}){
+    // simulate material only when fitting it
+    TOYFIT toyfit(40,fitmat);
+    auto configptr = toyfit.config("Schedule.txt",fitmat);
+    unsigned nfit(0), ndiff(0), nrefit(0);
+    for(unsigned iev=0;iev < nevents; iev++){
+      typename TOYFIT::PKTRAJ tptraj;
+      typename TOYFIT::THITCOL sthits, bthits;
+      typename TOYFIT::DXINGCOL sdxings, bdxings;
+      KTRAJ sseedtraj = toyfit.simulate(iseed+iev,tptraj,sthits,sdxings);
+      KKTrk<KTRAJ,SharedHandles> strk(configptr,sseedtraj,sthits,sdxings);
+      // the borrowed hits and crossings outlive the fit
+      KTRAJ bseedtraj = toyfit.simulate(iseed+iev,tptraj,bthits,bdxings);
+      KKTrk<KTRAJ,BorrowedHandles> btrk(configptr,bseedtraj,bthits,bdxings);
+      if(!KKTest::sameFit(strk,btrk)){
+	ndiff++;
+	continue;
+      }
+      if(!strk.fitStatus().usable()) continue;
+      nfit++;
+      // refit without one of the hits, then with it again
+      size_t ihit = iev%sthits.size();
+      strk.removeHit(sthits[ihit]);
+      btrk.removeHit(bthits[ihit]);
+      if(!KKTest::sameFit(strk,btrk)) ndiff++;
+      strk.addHit(sthits[ihit]);
+      btrk.addHit(bthits[ihit]);
+      if(!KKTest::sameFit(strk,btrk)) ndiff++;
+      nrefit++;
+    }
+    cout << KTRAJ::trajName() << " handle policy test " << (fitmat ? "with" : "without") << " material: " << nfit << " usable fits of "
+      << nevents << " events, " << nrefit << " refitted, " << ndiff << " differences between shared and borrowed handles" << endl;
+    // material fits of the ToyMC tracks don't yet converge reliably, so only the fits without material must be usable
+    if(ndiff > 0 || (nfit == 0 && !fitmat)){
+      cout << "Handle policy test failed" << endl;
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,129 @@
+//
+// Test the TPOCA computation of the hits in fits.  Fits of the same events computing the hit TPOCA in batches on each reference
+// piece (see TPocaBatch and KKConfig::batchtpoca_) and one hit at a time must agree, to within a small fraction of the parameter
+// sigma set by the TPOCA precision.  Both must start each hit's TPOCA search from its previous solution, so that the final update
+// needs fewer iterations than searching from scratch.  Each fit gets freshly simulated hits, as the fit changes their state
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: HitTPocaTest --nevents i --seed i --fitmat i --maxdiff f --maxdchisq f\n");
+}
+
+// count the TPOCA iterations of the final update of the hits with a sensor, and of searching for the same TPOCA from scratch
+template <class KTRAJ> void countIterations(KKTrk<KTRAJ> const& kktrk, unsigned long& nhit, unsigned long& niter, unsigned long& ncolditer) {
+  typedef typename KKTrk<KTRAJ>::KKHIT KKHIT;
+  typedef typename KKHIT::TPOCA TPOCA;
+  TPocaConfig const& tpconfig = kktrk.config().schedule().back().tpconfig_;
+  for(auto const& eff : kktrk.effects()){
+    auto kkhit = dynamic_cast<KKHIT const*>(eff.get());
+    if(kkhit == 0 || kkhit->sensor() == 0) continue;
+    TPOCA coldtpoca(kktrk.refTraj(),*kkhit->sensor(),TPocaHint(),tpconfig);
+    nhit++;
+    niter += kkhit->refResid().tPoca().iterations();
+    ncolditer += coldtpoca.iterations();
+  }
+}
+
+template <class KTRAJ>
+int HitTPocaTest(int argc, char **argv) {
+  typedef KKTrk<KTRAJ> KKTRK;
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+  bool fitmat(false); // material fits of the ToyMC tracks don't yet converge reliably
+  // batch and single TPOCA solutions differ by up to the TPOCA precision of each meta-iteration, which is much less than the hit resolution
+  double maxdiff(0.01); // in units of the parameter sigma
+  double maxdchisq(0.01);
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {"fitmat",     required_argument, 0, 'f'  },
+    {"maxdiff",     required_argument, 0, 'd'  },
+    {"maxdchisq",     required_argument, 0, 'c'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      case 'f' : fitmat = atoi(optarg);
+		 break;
+      case 'd' : maxdiff = atof(optarg);
+		 break;
+      case 'c' : maxdchisq = atof(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  // simulate material only when fitting it
+  TOYFIT toyfit(40,fitmat);
+  auto batchconfigptr = toyfit.config("Schedule.txt",fitmat);
+  auto configptr = toyfit.config("Schedule.txt",fitmat);
+  batchconfigptr->batchtpoca_ = true;
+  configptr->batchtpoca_ = false;
+  unsigned nfit(0), nbatchfit(0), nboth(0);
+  unsigned long nhit(0), niter(0), ncolditer(0), nbatchhit(0), nbatchiter(0), nbatchcolditer(0);
+  double maxpardiff(0.0), maxchisqdiff(0.0);
+  for(unsigned iev=0;iev < nevents; iev++){
+    typename TOYFIT::PKTRAJ tptraj;
+    typename TOYFIT::THITCOL thits, batchthits;
+    typename TOYFIT::DXINGCOL dxings, batchdxings;
+    KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+    KKTRK kktrk(configptr,seedtraj,thits,dxings);
+    KTRAJ batchseedtraj = toyfit.simulate(iseed+iev,tptraj,batchthits,batchdxings);
+    KKTRK batchtrk(batchconfigptr,batchseedtraj,batchthits,batchdxings);
+    bool usable = kktrk.fitStatus().usable();
+    bool batchusable = batchtrk.fitStatus().usable();
+    if(usable) nfit++;
+    if(batchusable) nbatchfit++;
+    if(!(usable && batchusable)) continue;
+    nboth++;
+    countIterations(kktrk,nhit,niter,ncolditer);
+    countIterations(batchtrk,nbatchhit,nbatchiter,nbatchcolditer);
+    // compare the parameters in units of the sigma of the fit without batches, at the start, middle and end of the track
+    auto const& fittraj = kktrk.fitTraj();
+    auto const& batchfittraj = batchtrk.fitTraj();
+    for(double time : {tptraj.range().low(), tptraj.range().mid(), tptraj.range().high()}){
+      auto const& pars = fittraj.nearestPiece(time).params();
+      auto const& batchpars = batchfittraj.nearestPiece(time).params();
+      for(size_t ipar=0;ipar < KTRAJ::NParams(); ipar++)
+	maxpardiff = std::max(maxpardiff,fabs(batchpars.parameters()[ipar]-pars.parameters()[ipar])/sqrt(pars.covariance()[ipar][ipar]));
+    }
+    maxchisqdiff = std::max(maxchisqdiff,fabs(batchtrk.fitStatus().chisq_ - kktrk.fitStatus().chisq_));
+  }
+  cout << KTRAJ::trajName() << " hit TPOCA test: " << nbatchfit << " usable fits with and " << nfit << " without batches, of " << nevents << " events" << endl;
+  cout << "Maximum difference between the fits with and without batches: parameters " << maxpardiff << " sigma, chisq " << maxchisqdiff << endl;
+  double iterhit = nhit > 0 ? niter/double(nhit) : 0.0;
+  double coldhit = nhit > 0 ? ncolditer/double(nhit) : 0.0;
+  double batchiterhit = nbatchhit > 0 ? nbatchiter/double(nbatchhit) : 0.0;
+  double batchcoldhit = nbatchhit > 0 ? nbatchcolditer/double(nbatchhit) : 0.0;
+  cout << "TPOCA iterations/hit in the final update: " << batchiterhit << " with batches, " << iterhit << " without, " << 
+    batchcoldhit << " and " << coldhit << " from scratch" << endl;
+  int status(0);
+  if(nboth == 0 || nbatchfit != nfit || maxpardiff > maxdiff || maxchisqdiff > maxdchisq || nhit == 0 || nbatchhit == 0 ||
+      !(iterhit < coldhit) || !(batchiterhit < batchcoldhit)){
+    cout << "Hit TPOCA test failed" << endl;
+    status = 1;
+  }
+  return status;
+}
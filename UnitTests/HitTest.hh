@@ -174,7 +174,7 @@ int HitTest(int argc, char **argv, const vector<double>& delpars) {
   for(auto const& thit : thits) {
    // compute residual
     RESIDUAL  res;
-    thit->resid(tptraj,res);
+    thit->resid(tptraj,TPocaConfig(),res);
     TPolyLine3D* line = new TPolyLine3D(2);
     Vec3 plow, phigh;
     STRAWHITPTR shptr = std::dynamic_pointer_cast<STRAWHIT> (thit); 
@@ -248,7 +248,9 @@ int HitTest(int argc, char **argv, const vector<double>& delpars) {
         RESIDUAL ores = kkhit.refResid(); // original residual
             // modify the helix
         KTRAJ modktraj = tptraj.nearestPiece(kkhit.time());
-        modktraj.params().parameters()[ipar] += dpar;
+        typename KTRAJ::DVEC modpars = modktraj.params().parameters();
+        modpars[ipar] += dpar;
+        modktraj.setParams(typename KTRAJ::PDATA(modpars,modktraj.params().covariance()));
         PKTRAJ modtptraj(modktraj);
         ROOT::Math::SVector<double,6> dpvec;
         dpvec[ipar] += dpar;
@@ -0,0 +1,83 @@
+//
+// Test reading a fit schedule: parse the hit update schedule used by the fit tests and check its content, then check
+// that malformed schedules are rejected
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKConfig.hh"
+#include "KinKal/WireHit.hh"
+#include "KinKal/AmbigResolver.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+using namespace KinKal;
+
+int main(int argc, char **argv) {
+  int status(0);
+  string fullfile;
+  if(const char* source = std::getenv("PACKAGE_SOURCE")){
+    fullfile = string(source) + string("/UnitTests/HitUpdateSchedule.txt");
+  } else {
+    cout << "PACKAGE_SOURCE not defined" << endl;
+    return -1;
+  }
+  UniformBField bfield(1.0);
+  KKConfig config(bfield);
+  std::ifstream ifs (fullfile, std::ifstream::in);
+  config.readSchedule<WireHitUpdater,AmbigResolver>(ifs);
+  cout << config << endl;
+  // expected content of HitUpdateSchedule.txt: meta-iterations 2 and 3 update the hits with a WireHitUpdater
+  auto const& schedule = config.schedule();
+  std::vector<double> temps = {1.0, 0.5, 0.2, 0.1, 0.0};
+  std::vector<double> precisions = {0.01, 0.01, 0.003, 0.001, 0.001};
+  std::vector<double> mindocas = {0.0, 0.0, 0.5, 0.2, 0.0};
+  std::vector<double> maxdocas = {0.0, 0.0, 10.0, 5.0, 0.0};
+  if(schedule.size() != temps.size()){
+    cout << "Schedule has " << schedule.size() << " meta-iterations, expected " << temps.size() << endl;
+    return 1;
+  }
+  for(size_t imeta=0;imeta<schedule.size();imeta++){
+    auto const& mconfig = schedule[imeta];
+    bool hasupdater = mindocas[imeta] > 0.0;
+    auto updater = mconfig.hitUpdater<WireHitUpdater>();
+    if(mconfig.miter_ != int(imeta) || !mconfig.updatemat_ || !mconfig.updatebfcorr_ || mconfig.updatehits_ != hasupdater ||
+	mconfig.temp_ != temps[imeta] || mconfig.tpconfig_.precision_ != precisions[imeta] || mconfig.updtol_ != 0.0 ||
+	mconfig.hitUpdater<AmbigResolver>() != 0 || mconfig.nHitUpdaters() != (hasupdater ? 1 : 0) ||
+	(hasupdater && (updater == 0 || updater->mindoca_ != mindocas[imeta] || updater->maxdoca_ != maxdocas[imeta]))){
+      cout << "Meta-iteration " << imeta << " doesn't match the schedule file" << endl;
+      status = 1;
+    }
+  }
+  // malformed schedules must be rejected
+  std::vector<std::string> badschedules = {
+    "1 1 1 0.2 0.1 10.0 1.0\nBogusUpdater 0.5 10.0\n", // unknown updater
+    "1 1 1 0.2 0.1 10.0 1.0\nWireHitUpdater 0.5 x\n", // bad updater field
+    "1 1 1 0.2 0.1 10.0 1.0\nWireHitUpdater 0.5\n", // missing updater field
+    "1 1 1 0.2 0.1 10.0 1.0\nWireHitUpdater 0.5 10.0 2.0\n", // extra updater field
+    "1 1 1 0.2 0.1 10.0 1.0\nAmbigResolver 0 2.0 2.0\n", // invalid updater parameter
+    "1 1 1 0.2 0.1 10.0 1.0\nWireHitUpdater 0.5 10.0\nWireHitUpdater 0.2 5.0\n", // duplicate updater
+    "1 1 0 0.2 0.1 10.0 1.0\nWireHitUpdater 0.5 10.0\n", // updater for a meta-iteration that doesn't update hits
+    "WireHitUpdater 0.5 10.0\n1 1 1 0.2 0.1 10.0 1.0\n", // updater before any meta-iteration
+    "1 1 1 0.2 x 10.0 1.0\n", // bad meta-iteration field
+    "1 1 1 0.2 0.1 10.0\n", // missing meta-iteration field
+    "1 1 1 0.2 0.1 10.0 1.0 0.001 0.1 x\n" // extra meta-iteration field
+  };
+  for(auto const& bad : badschedules){
+    KKConfig badconfig(bfield);
+    std::istringstream iss(bad);
+    try {
+      badconfig.readSchedule<WireHitUpdater,AmbigResolver>(iss);
+      cout << "Malformed schedule accepted:" << endl << bad;
+      status = 1;
+    } catch (std::invalid_argument const& error) {
+      cout << "Malformed schedule rejected: " << error.what() << endl;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,5 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/BFieldTest.hh"
+int main(int argc, char **argv) {
+  return BFieldTest<KTLine>(argc,argv);
+}
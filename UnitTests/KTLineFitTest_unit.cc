@@ -0,0 +1,9 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/FitTest.hh"
+int main(int argc, char **argv) {
+  // a line measures momentum only through the speed, so default to a (non-relativistic) muon instead of an electron.
+  // Explicit arguments follow, and so override these
+  vector<char*> args = {argv[0], (char*)"--simparticle", (char*)"1", (char*)"--fitparticle", (char*)"1"};
+  args.insert(args.end(),argv+1,argv+argc);
+  return FitTest<KTLine>(args.size(),args.data());
+}
@@ -0,0 +1,9 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/HitTest.hh"
+int main(int argc, char **argv) {
+  // momentum enters a line only through the speed, so default to a (non-relativistic) muon.  Explicit arguments override this
+  vector<char*> args = {argv[0], (char*)"--particle", (char*)"1"};
+  args.insert(args.end(),argv+1,argv+argc);
+  vector<double> delpars { 0.5, 0.001, 0.5, 0.005, 5.0, 0.5};
+  return HitTest<KTLine>(args.size(),args.data(),delpars);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/PKTrajTest.hh"
+int main(int argc, char **argv) {
+  return PKTrajTest<KTLine>(argc,argv);
+}
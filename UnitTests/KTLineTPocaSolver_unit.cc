@@ -0,0 +1,5 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/TPocaSolverTest.hh"
+int main(int argc, char **argv) {
+  return TPocaSolverTest<KTLine>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/TPocaTest.hh"
+int main(int argc, char **argv) {
+  return TPocaTest<KTLine>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/KTLine.hh"
+#include "UnitTests/KTraj_test.hh"
+int main(int argc, char **argv) {
+  return test<KTLine>(argc,argv);
+}
@@ -140,6 +140,24 @@ int test(int argc, char **argv) {
     tdir = lhel.direction(ttime);
     testmom = lhel.momentum(ttime);
     cout << "velocity " << tvel << " direction " << tdir << " momentum " << testmom << endl;
+    // the combined kinematic state must agree with the individual accessors
+    KinState kstate;
+    typename KTRAJ::DPDV dPdM;
+    lhel.kinState(ttime,kstate,dPdM);
+    double dpdmdiff(0.0);
+    for(size_t ipar=0;ipar<KTRAJ::NParams();ipar++)
+      for(size_t idim=0;idim<3;idim++)
+	dpdmdiff = std::max(dpdmdiff,fabs(dPdM(ipar,idim)-lhel.dPardM(ttime)(ipar,idim)));
+    double sdiff = (kstate.pos_-lhel.position(ttime)).R() + (kstate.vel_-tvel).R() + dpdmdiff +
+      fabs(kstate.mom_-lhel.momentumMag(ttime)) + fabs(kstate.speed_-lhel.speed(ttime));
+    for(int idir=0;idir<LocalBasis::ndir;idir++){
+      auto mdir = static_cast<LocalBasis::LocDir>(idir);
+      sdiff += (kstate.direction(mdir)-lhel.direction(ttime,mdir)).R();
+    }
+    if(sdiff > 1.0e-8){
+      cout << "KinState disagrees with KTRAJ accessors at time " << ttime << " difference " << sdiff << endl;
+      exit(EXIT_FAILURE);
+    }
 //    cout << "momentum beta =" << testmom.Beta() << " KTRAJ beta = " << lhel.beta() << " momentum gamma  = " << testmom.Gamma() << 
 //      " KTRAJ gamma = " << lhel.gamma() << " scalar mom " << lhel.momentum(ot) << endl;
   }
@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/AmbigResolverTest.hh"
+int main(int argc, char **argv) {
+  return AmbigResolverTest<LHelix>(argc,argv);
+}
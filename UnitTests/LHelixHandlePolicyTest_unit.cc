@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/HandlePolicyTest.hh"
+int main(int argc, char **argv) {
+  return HandlePolicyTest<LHelix>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/HitTPocaTest.hh"
+int main(int argc, char **argv) {
+  return HitTPocaTest<LHelix>(argc,argv);
+}
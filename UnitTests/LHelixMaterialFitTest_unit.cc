@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/MaterialFitTest.hh"
+int main(int argc, char **argv) {
+  return MaterialFitTest<LHelix>(argc,argv);
+}
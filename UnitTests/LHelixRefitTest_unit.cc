@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/RefitTest.hh"
+int main(int argc, char **argv) {
+  return RefitTest<LHelix>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/StrawHitCollectionTest.hh"
+int main(int argc, char **argv) {
+  return StrawHitCollectionTest<LHelix>(argc,argv);
+}
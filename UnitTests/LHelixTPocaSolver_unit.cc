@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/TPocaSolverTest.hh"
+int main(int argc, char **argv) {
+  return TPocaSolverTest<LHelix>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/LHelix.hh"
+#include "UnitTests/UpdateToleranceTest.hh"
+int main(int argc, char **argv) {
+  return UpdateToleranceTest<LHelix>(argc,argv);
+}
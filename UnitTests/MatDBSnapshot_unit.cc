@@ -0,0 +1,101 @@
+// 
+// Build a binary snapshot of the material database, and validate it against the text sources.
+// With --validate 0 this can be used as a tool to (re)generate the snapshot.  Without --file the snapshot
+// is written to a temporary file, which is removed afterwards
+//
+#include "MatEnv/MatDBInfo.hh"
+#include "MatEnv/MatDBSnapshot.hh"
+#include "MatEnv/DetMaterial.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace MatEnv;
+
+void print_usage() {
+  printf("Usage: MatDBSnapshot --file s --write i --validate i\n");
+}
+
+int main(int argc, char **argv) {
+
+  string filename;
+  int write(1), validate(1);
+
+  static struct option long_options[] = {
+    {"file",     required_argument, 0, 'f'  },
+    {"write",     required_argument, 0, 'w'  },
+    {"validate",     required_argument, 0, 'v'  },
+  };
+
+  int long_index =0;
+  int opt;
+
+  while ((opt = getopt_long_only(argc, argv,"", long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'f' : 
+	filename = string(optarg);
+	break;
+      case 'w' : 
+	write = atoi(optarg);
+	break;
+      case 'v' : 
+	validate = atoi(optarg);
+	break;
+      default: print_usage(); 
+	       exit(EXIT_FAILURE);
+    }
+  }
+
+  bool tempfile = filename.empty();
+  if(tempfile){
+    const char* tmpdir = getenv("TMPDIR");
+    filename = string(tmpdir != 0 ? tmpdir : "/tmp") + "/MatDBXXXXXX";
+    int fd = mkstemp(&filename[0]);
+    if(fd < 0){
+      cout << "Can't create temporary file " << filename << endl;
+      exit(EXIT_FAILURE);
+    }
+    close(fd);
+    write = 1;
+  }
+  if(write){
+    MatDBSnapshot::write(filename);
+    cout << "Wrote material snapshot " << filename << endl;
+  }
+  auto start = chrono::high_resolution_clock::now();
+  MatDBSnapshot snapshot(filename);
+  MatDBInfo snapdb;
+  snapdb.loadSnapshot(snapshot);
+  auto stop = chrono::high_resolution_clock::now();
+  cout << "Loaded " << snapdb.nMaterials() << " materials in "
+    << chrono::duration_cast<std::chrono::microseconds>(stop-start).count() << " microseconds" << endl;
+  int status(0);
+  if(validate){
+    unsigned nbad = snapshot.validate(cout);
+    if(nbad > 0){
+      cout << nbad << " invalid snapshot records" << endl;
+      status = 1;
+    }
+    // compare material effects against a database built from the text sources
+    MatDBInfo textdb;
+    double mom(100.0), plen(1.0), mass(0.511);
+    for(auto const& matname : snapdb.materialNames()){
+      const DetMaterial* smat = snapdb.findDetMaterial(matname);
+      const DetMaterial* tmat = textdb.findDetMaterial(matname);
+      if(smat == 0 || tmat == 0 ||
+	  smat->energyLoss(mom,plen,mass) != tmat->energyLoss(mom,plen,mass) ||
+	  smat->scatterAngleVar(mom,plen,mass) != tmat->scatterAngleVar(mom,plen,mass)){
+	cout << "Material " << matname << " effects differ from text sources" << endl;
+	status = 1;
+      }
+    }
+  }
+  if(tempfile) remove(filename.c_str());
+  exit(status);
+}
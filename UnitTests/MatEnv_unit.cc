@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <iostream>
 #include <getopt.h>
+#include <thread>
+#include <atomic>
 
 #include "TH1F.h"
 #include "TSystem.h"
@@ -32,7 +34,7 @@ using namespace std;
 using namespace MatEnv;
 
 void print_usage() {
-  printf("Usage: MatEnv --material c --particle i --momstart f --momend f --thickness f\n");
+  printf("Usage: MatEnv --material c --particle i --momstart f --momend f --thickness f --thickpath f\n");
 }
 
 int main(int argc, char **argv) {
@@ -40,6 +42,7 @@ int main(int argc, char **argv) {
   string matname("straw-wall");
   double momstart(10.0), momend(200.0);
   double thickness(0.015);
+  double thickpath(5.0);
   int imass(0);
   double masses[5]={0.511,105.66,139.57, 493.68, 938.0};
   const char* pnames[5] = {"electron","muon","pion","kaon","proton"};
@@ -52,6 +55,7 @@ int main(int argc, char **argv) {
     {"momstart",     required_argument, 0, 's'  },
     {"momend",     required_argument, 0, 'e'  },
     {"thickness",     required_argument, 0, 't'  },
+    {"thickpath",     required_argument, 0, 'l'  },
   };
 
   int long_index =0;
@@ -74,6 +78,9 @@ int main(int argc, char **argv) {
       case 't' : 
 	thickness = atof(optarg);
 	break;
+      case 'l' : 
+	thickpath = atof(optarg);
+	break;
       default: print_usage(); 
 	       exit(EXIT_FAILURE);
     }
@@ -82,7 +89,7 @@ int main(int argc, char **argv) {
   pname = pnames[imass];
   cout << "Test for particle " << pname  << " mass " << pmass << endl;
   cout << "Searching for material " << matname << endl;
-  MatDBInfo matdbinfo;
+  MatDBInfo matdbinfo(std::vector<double>(1,pmass));
   const DetMaterial* dmat = matdbinfo.findDetMaterial(matname);
   if(dmat != 0){
     cout << "Found DetMaterial " << dmat->name() << endl;
@@ -108,8 +115,85 @@ int main(int argc, char **argv) {
      + dmat->name() + string(" ") + pname
      + string(";Mom (MeV/c);#beta#gamma");
     gbetagamma->SetTitle(title.c_str());
+    TGraph* gthick = new TGraph(nstep);
+    title = string("Thick path Eloss fractional difference range table - integration vs Momentum ")
+     + dmat->name() + string(" ") + pname
+     + string(";Mom (MeV/c);#Delta E/E");
+    gthick->SetTitle(title.c_str());
+    int status(0);
+    MatRangeTable const* rtable = dmat->rangeTable(pmass);
+    if(rtable == 0){
+      cout << "No range table for mass " << pmass << endl;
+      exit(1);
+    }
+    // before freezing, concurrent lookups must create each material exactly once, while
+    // other threads use the materials already created
+    {
+      MatDBInfo livedb;
+      std::vector<std::string> livenames = {"straw-gas","straw-wall","straw-wire","Kapton","Mylar","CO2","air","CsI"};
+      unsigned nthread(4);
+      std::vector<std::vector<const DetMaterial*> > livemats(nthread,std::vector<const DetMaterial*>(livenames.size(),0));
+      std::atomic<unsigned> nlivebad(0);
+      std::vector<std::thread> livethreads;
+      for(unsigned ithread=0;ithread<nthread;ithread++){
+	livethreads.emplace_back([&,ithread](){
+	    for(unsigned ilook=0;ilook<100;ilook++){
+	      for(unsigned iname=0;iname<livenames.size();iname++){
+		// each thread walks the names in a different order
+		unsigned jname = (iname + ithread*ilook)%livenames.size();
+		const DetMaterial* lmat = livedb.findDetMaterial(livenames[jname]);
+		if(lmat == 0 || lmat->name() != livenames[jname] || lmat->energyLoss(100.0,thickness,pmass) >= 0.0 ||
+		    (livemats[ithread][jname] != 0 && livemats[ithread][jname] != lmat))
+		  nlivebad++;
+		livemats[ithread][jname] = lmat;
+	      }
+	    } });
+      }
+      for(auto& thread : livethreads)thread.join();
+      for(unsigned ithread=1;ithread<nthread;ithread++)
+	if(livemats[ithread] != livemats[0])nlivebad++;
+      if(nlivebad > 0 || livedb.nMaterials() != livenames.size()){
+	cout << "Concurrent material creation failed " << nlivebad << " times, created "
+	  << livedb.nMaterials() << " materials for " << livenames.size() << " names" << endl;
+	status = 1;
+      }
+    }
+    // after freezing, concurrent lookups must return the same material
+    matdbinfo.freeze();
+    std::atomic<unsigned> nbad(0);
+    std::vector<std::thread> threads;
+    for(unsigned ithread=0;ithread<4;ithread++){
+      threads.emplace_back([&](){
+	  for(unsigned ilook=0;ilook<1000;ilook++)
+	    if(matdbinfo.findDetMaterial(matname) != dmat)nbad++; });
+    }
+    for(auto& thread : threads)thread.join();
+    if(nbad > 0){
+      cout << "Frozen material lookup failed " << nbad << " times" << endl;
+      status = 1;
+    }
     for(unsigned istep = 0;istep < nstep; istep++){
       double mom = momstart + istep*momstep;
+      // compare thick-path energy loss with a fine numerical integration of dE/dx
+      double energy = dmat->particleEnergy(mom,pmass);
+      double tkin = dmat->particleKinEnergy(energy,pmass);
+      double thickloss = dmat->energyLoss(mom,thickpath,pmass);
+      unsigned nint(10000);
+      double dx = thickpath/nint;
+      double intenergy(energy);
+      for(unsigned iint=0;iint<nint && intenergy > pmass;iint++){
+	double mid = intenergy + 0.5*dx*dmat->dEdx(dmat->particleMomentum(intenergy,pmass),dmat->dEdxType(),pmass);
+	intenergy += dx*dmat->dEdx(dmat->particleMomentum(mid,pmass),dmat->dEdxType(),pmass);
+      }
+      double intloss = intenergy - energy;
+      double fdiff = (thickloss-intloss)/fabs(intloss);
+      gthick->SetPoint(istep,mom,fdiff);
+      // only test particles which don't range out, and paths thick enough to use the range table
+      bool thick = dmat->maxStepdEdx(mom,pmass,dmat->dEdx(mom,dmat->dEdxType(),pmass)) < thickpath;
+      if(thick && rtable->range(tkin) > 2*thickpath && fabs(fdiff) > 1.0e-4){
+	cout << "Thick path energy loss disagrees at momentum " << mom << " range table " << thickloss << " integration " << intloss << endl;
+	status = 1;
+      }
       double eloss = dmat->energyLoss(mom,thickness,pmass);
       geloss->SetPoint(istep,mom,eloss);
       double elossrms = dmat->energyLossRMS(mom,thickness,pmass);
@@ -121,7 +205,7 @@ int main(int argc, char **argv) {
     }
     TFile mefile("MatEnv.root","RECREATE");
     TCanvas* matcan = new TCanvas("matcan","MatEnv",1000,1000);
-    matcan->Divide(2,2);
+    matcan->Divide(3,2);
     matcan->cd(1);
     geloss->Draw("AC*");
     matcan->cd(2);
@@ -130,8 +214,11 @@ int main(int argc, char **argv) {
     gascat->Draw("AC*");
     matcan->cd(4);
     gbetagamma->Draw("AC*");
+    matcan->cd(5);
+    gthick->Draw("AC*");
     matcan->Write();
     mefile.Write();
     mefile.Close();
+    exit(status);
   }
 }
@@ -0,0 +1,90 @@
+//
+// Test fitting with material: fits of events simulated with material must not fail, and must build their fit trajectory from a piece
+// for each active material effect, covering the times of all the hits.  Each material effect appends its piece to the fit
+// trajectory after the end effect seeded it, so that piece must accept material effects at any time in the fit, and material
+// effects closer than the KKMat time offset must append in the order they were processed
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: MaterialFitTest --nevents i --seed i\n");
+}
+
+template <class KTRAJ>
+int MaterialFitTest(int argc, char **argv) {
+  typedef KKTrk<KTRAJ> KKTRK;
+  typedef typename KKTRK::KKMAT KKMAT;
+  typedef typename KKTRK::KKHIT KKHIT;
+  typedef typename KKTRK::KKMHIT KKMHIT;
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  TOYFIT toyfit(40,true);
+  auto configptr = toyfit.config("Schedule.txt",true);
+  unsigned nfail(0), ndiv(0), nbadtraj(0);
+  for(unsigned iev=0;iev < nevents; iev++){
+    typename TOYFIT::PKTRAJ tptraj;
+    typename TOYFIT::THITCOL thits;
+    typename TOYFIT::DXINGCOL dxings;
+    KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+    KKTRK kktrk(configptr,seedtraj,thits,dxings);
+    auto const& fstat = kktrk.fitStatus();
+    if(fstat.status_ == FitStatus::failed){
+      cout << "Failed fit of event " << iev << ": " << fstat.comment_ << endl;
+      nfail++;
+      continue;
+    }
+    if(fstat.status_ == FitStatus::diverged) ndiv++;
+    // the fit trajectory has the piece seeded by the end effect and a piece for each active material effect, including those of hits
+    // (and for each field correction)
+    auto const& fitrange = kktrk.fitTraj().range();
+    bool goodtraj = !fitrange.infinite();
+    size_t nmat(0);
+    for(auto const& eff : kktrk.effects()){
+      auto kkmat = dynamic_cast<KKMAT const*>(eff.get());
+      auto kkmhit = dynamic_cast<KKMHIT const*>(eff.get());
+      if(kkmhit != 0) kkmat = &kkmhit->mat();
+      if(kkmat != 0 && kkmat->isActive()) nmat++;
+      if((kkmhit != 0 || dynamic_cast<KKHIT const*>(eff.get()) != 0) && !fitrange.inRange(eff->time())) goodtraj = false;
+    }
+    if(kktrk.fitTraj().pieces().size() < nmat+1) goodtraj = false;
+    if(!goodtraj) nbadtraj++;
+  }
+  cout << KTRAJ::trajName() << " material fit test: " << nfail << " failed and " << ndiv << " diverged fits of " << nevents << " events, "
+    << nbadtraj << " with a bad fit trajectory" << endl;
+  int status(0);
+  if(nfail > 0 || nbadtraj > 0){
+    cout << "Material fit test failed" << endl;
+    status = 1;
+  }
+  return status;
+}
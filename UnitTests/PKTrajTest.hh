@@ -202,12 +202,26 @@ int PKTrajTest(int argc, char **argv) {
   all->SetLineColor(kYellow);
   all->SetLineStyle(kDotted);
   double ts = (ptraj.range().high()-ptraj.range().low())/(np-1);
-  for(unsigned ip=0;ip<np;ip++){
-  double tp = ptraj.range().low() + ip*ts;
-    Vec3 ppos = ptraj.position(tp);
-      all->SetPoint(ip,ppos.X(),ppos.Y(),ppos.Z());
-  }
+  std::vector<double> times(np);
+  for(unsigned ip=0;ip<np;ip++)
+    times[ip] = ptraj.range().low() + ip*ts;
+  std::vector<Vec3> ppos;
+  ptraj.positions(times,ppos);
+  for(unsigned ip=0;ip<np;ip++)
+    all->SetPoint(ip,ppos[ip].X(),ppos[ip].Y(),ppos[ip].Z());
   all->Draw();
+  // test the batch positions against single evaluation, including out-of-range and decreasing times
+  std::vector<double> rtimes(times.rbegin(),times.rend());
+  times.push_back(ptraj.range().high()+1.0);
+  times.push_back(ptraj.range().low()-1.0);
+  times.insert(times.end(),rtimes.begin(),rtimes.end());
+  ptraj.positions(times,ppos);
+  for(size_t itime=0;itime<times.size();itime++){
+    if((ppos[itime]-ptraj.position(times[itime])).R() > 1.0e-9){
+      cout << "Batch position disagrees at time " << times[itime] << endl;
+      return -2;
+    }
+  }
 
   // draw the origin and axes
   TAxis3D* rulers = new TAxis3D();
@@ -0,0 +1,5 @@
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/BFieldTest.hh"
+int main(int argc, char **argv) {
+  return BFieldTest<RKTraj>(argc,argv);
+}
@@ -0,0 +1,6 @@
+
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/KTrajDerivs_test.hh"
+int main(int argc, char **argv) {
+  return test<RKTraj>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/FitTest.hh"
+int main(int argc, char **argv) {
+  return FitTest<RKTraj>(argc,argv);
+}
@@ -0,0 +1,5 @@
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/PKTrajTest.hh"
+int main(int argc, char **argv) {
+  return PKTrajTest<RKTraj>(argc,argv);
+}
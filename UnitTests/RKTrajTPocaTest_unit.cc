@@ -0,0 +1,5 @@
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/TPocaTest.hh"
+int main(int argc, char **argv) {
+  return TPocaTest<RKTraj>(argc,argv);
+}
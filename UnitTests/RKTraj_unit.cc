@@ -0,0 +1,5 @@
+#include "KinKal/RKTraj.hh"
+#include "UnitTests/KTraj_test.hh"
+int main(int argc, char **argv) {
+  return test<RKTraj>(argc,argv);
+}
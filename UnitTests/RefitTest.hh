@@ -0,0 +1,174 @@
+//
+// Test incremental refits: removing a hit from a fit must agree with a new fit without that hit, adding it back must
+// restore the original fit, and deactivating it must drop its degrees of freedom.  The unbiased residuals of the hit must
+// predict the chisquared and parameter changes of removing it from, and reactivating it in, the fit
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: RefitTest --nevents i --seed i --fitmat i --maxdiff f --maxudchisq f --maxudiff f\n");
+}
+
+// maximum parameter difference in units of the reference parameter sigma, at the given time
+template <class KTRAJ> double maxParDiff(PKTraj<KTRAJ> const& fittraj, PKTraj<KTRAJ> const& reftraj, double time) {
+  auto const& fitpars = fittraj.nearestPiece(time).params();
+  auto const& refpars = reftraj.nearestPiece(time).params();
+  double maxdiff(0.0);
+  for(size_t ipar=0;ipar < KTRAJ::NParams(); ipar++)
+    maxdiff = std::max(maxdiff,fabs(fitpars.parameters()[ipar]-refpars.parameters()[ipar])/sqrt(refpars.covariance()[ipar][ipar]));
+  return maxdiff;
+}
+
+// find the unbiased residual of a hit
+template <class KTRAJ> UnbiasedResid<KTRAJ> const* findResid(std::vector<UnbiasedResid<KTRAJ>> const& uresids, THit<KTRAJ> const* thit) {
+  auto iuresid = std::find_if(uresids.begin(),uresids.end(),[thit](UnbiasedResid<KTRAJ> const& uresid){ return uresid.thit_ == thit; });
+  return iuresid != uresids.end() ? &*iuresid : 0;
+}
+
+// maximum difference between the parameter change at the hit predicted by its unbiased residual and the refit change, in units of the
+// original parameter sigma
+template <class KTRAJ> double maxPredDiff(UnbiasedResid<KTRAJ> const& uresid, PKTraj<KTRAJ> const& fittraj, PKTraj<KTRAJ> const& origtraj) {
+  auto const& fitpars = fittraj.nearestPiece(uresid.time_).params();
+  auto const& origpars = origtraj.nearestPiece(uresid.time_).params();
+  double maxdiff(0.0);
+  for(size_t ipar=0;ipar < KTRAJ::NParams(); ipar++)
+    maxdiff = std::max(maxdiff,fabs(fitpars.parameters()[ipar]-origpars.parameters()[ipar]-uresid.dpars_[ipar])/sqrt(origpars.covariance()[ipar][ipar]));
+  return maxdiff;
+}
+
+template <class KTRAJ>
+int RefitTest(int argc, char **argv) {
+  typedef KKTrk<KTRAJ> KKTRK;
+  typedef typename KKTRK::URESID URESID;
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+  bool fitmat(false); // material fits of the ToyMC tracks don't yet converge reliably
+  // the refit converges to the same minimum as a new fit, to within the convergence tolerance
+  double maxdiff(0.05); // in units of the parameter sigma
+  // the unbiased residual predictions are 1st order in the parameter change, which the refit iterates beyond
+  double maxudchisq(0.05), maxudiff(0.05); // chisquared, and parameter sigma
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {"fitmat",     required_argument, 0, 'f'  },
+    {"maxdiff",     required_argument, 0, 'd'  },
+    {"maxudchisq",     required_argument, 0, 'c'  },
+    {"maxudiff",     required_argument, 0, 'u'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      case 'f' : fitmat = atoi(optarg);
+		 break;
+      case 'd' : maxdiff = atof(optarg);
+		 break;
+      case 'c' : maxudchisq = atof(optarg);
+		 break;
+      case 'u' : maxudiff = atof(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  // simulate material only when fitting it
+  TOYFIT toyfit(40,fitmat);
+  auto configptr = toyfit.config("Schedule.txt",fitmat);
+  unsigned nfit(0), nbadrefit(0), nupred(0);
+  double maxremdiff(0.0), maxadddiff(0.0), maxudchisqdiff(0.0), maxudparsdiff(0.0);
+  std::vector<URESID> uresids;
+  for(unsigned iev=0;iev < nevents; iev++){
+    typename TOYFIT::PKTRAJ tptraj;
+    typename TOYFIT::THITCOL thits;
+    typename TOYFIT::DXINGCOL dxings;
+    KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+    KKTRK kktrk(configptr,seedtraj,thits,dxings);
+    if(!kktrk.fitStatus().usable()) continue;
+    nfit++;
+    auto const origtraj = kktrk.fitTraj();
+    double tmid = origtraj.range().mid();
+    // remove a hit, and compare with a new fit of the remaining hits from the same seed.  That can occasionally settle in a
+    // different local minimum than the original fit did; it doesn't for the default events
+    auto rhit = thits[iev%thits.size()];
+    // predict the removal from the unbiased residual.  Removing the hit also removes its material, which the prediction doesn't include
+    kktrk.unbiasedResids(uresids);
+    URESID const* uresid = findResid(uresids,rhit.get());
+    URESID remresid;
+    bool rempred = uresid != 0 && uresid->active_ && !(configptr->addmat_ && rhit->hasMaterial());
+    if(rempred) remresid = *uresid;
+    double origchisq = kktrk.fitStatus().chisq_;
+    typename TOYFIT::THITCOL remhits(thits);
+    remhits.erase(std::find(remhits.begin(),remhits.end(),rhit));
+    KKTRK remtrk(configptr,seedtraj,remhits,dxings);
+    kktrk.removeHit(rhit);
+    if(!kktrk.fitStatus().usable() || kktrk.timeHits().size() != remhits.size()){
+      nbadrefit++;
+      continue;
+    }
+    if(remtrk.fitStatus().usable()) maxremdiff = std::max(maxremdiff,maxParDiff(kktrk.fitTraj(),remtrk.fitTraj(),tmid));
+    if(rempred){
+      nupred++;
+      maxudchisqdiff = std::max(maxudchisqdiff,fabs(origchisq - kktrk.fitStatus().chisq_ - remresid.dchisq_));
+      maxudparsdiff = std::max(maxudparsdiff,maxPredDiff(remresid,kktrk.fitTraj(),origtraj));
+    }
+    // add it back
+    kktrk.addHit(rhit);
+    if(!kktrk.fitStatus().usable() || kktrk.timeHits().size() != thits.size()){
+      nbadrefit++;
+      continue;
+    }
+    maxadddiff = std::max(maxadddiff,maxParDiff(kktrk.fitTraj(),origtraj,tmid));
+    // deactivating the hit removes its degrees of freedom, reactivating it restores them
+    if(rhit->isActive()){
+      unsigned ndof = kktrk.fitStatus().ndof_;
+      kktrk.setHitActivity(rhit,false);
+      if(!kktrk.fitStatus().usable() || kktrk.fitStatus().ndof_ + rhit->nDOF() != ndof){
+	nbadrefit++;
+	continue;
+      }
+      // the unbiased residual of the inactive hit predicts its reactivation
+      auto const inacttraj = kktrk.fitTraj();
+      double inactchisq = kktrk.fitStatus().chisq_;
+      kktrk.unbiasedResids(uresids);
+      URESID const* inactresid = findResid(uresids,rhit.get());
+      kktrk.setHitActivity(rhit,true);
+      if(!kktrk.fitStatus().usable() || kktrk.fitStatus().ndof_ != ndof || inactresid == 0 || inactresid->active_){
+	nbadrefit++;
+	continue;
+      }
+      nupred++;
+      maxudchisqdiff = std::max(maxudchisqdiff,fabs(kktrk.fitStatus().chisq_ - inactchisq - inactresid->dchisq_));
+      maxudparsdiff = std::max(maxudparsdiff,maxPredDiff(*inactresid,kktrk.fitTraj(),inacttraj));
+    }
+  }
+  cout << KTRAJ::trajName() << " refit test: " << nfit << " usable fits of " << nevents << " events, " << nbadrefit << " failed refits" << endl;
+  cout << "Maximum parameter difference: hit removal from a new fit " << maxremdiff << " sigma, hit addition from the original fit " << maxadddiff << " sigma" << endl;
+  cout << nupred << " unbiased residual predictions, maximum difference from the refit: chisq " << maxudchisqdiff << " parameters " << maxudparsdiff << " sigma" << endl;
+  int status(0);
+  if(nfit == 0 || nbadrefit > 0 || maxremdiff > maxdiff || maxadddiff > maxdiff || nupred == 0 || maxudchisqdiff > maxudchisq || maxudparsdiff > maxudiff){
+    cout << "Refit test failed" << endl;
+    status = 1;
+  }
+  return status;
+}
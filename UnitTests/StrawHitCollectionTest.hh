@@ -0,0 +1,89 @@
+//
+// Test fitting straw hits stored in a StrawHitCollection: fits of the same events with individual StrawHits, and with the hits of a
+// collection borrowed through their index handles (see BorrowedHandles), must give identical results, with and without material and
+// hit updates.  The collection handles must be contiguous.  Each fit gets freshly simulated hits, as the fit changes their state
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "KinKal/HandlePolicy.hh"
+#include "KinKal/StrawHitCollection.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: StrawHitCollectionTest --nevents i --seed i\n");
+}
+
+template <class KTRAJ>
+int StrawHitCollectionTest(int argc, char **argv) {
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  typedef StrawHitHandle<KTRAJ> SHHANDLE;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  int status(0);
+  for(std::string sfile : {"Schedule.txt", "HitUpdateSchedule.txt"}){
+    for(bool fitmat : {false, true}){
+      // simulate material only when fitting it
+      TOYFIT toyfit(40,fitmat), coltoyfit(40,fitmat);
+      coltoyfit.setUseCollection(true);
+      auto configptr = toyfit.config(sfile,fitmat);
+      unsigned nfit(0), ndiff(0), nbadcol(0);
+      for(unsigned iev=0;iev < nevents; iev++){
+	typename TOYFIT::PKTRAJ tptraj;
+	typename TOYFIT::THITCOL thits, colthits;
+	typename TOYFIT::DXINGCOL dxings, coldxings;
+	KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+	KKTrk<KTRAJ,SharedHandles> kktrk(configptr,seedtraj,thits,dxings);
+	KTRAJ colseedtraj = coltoyfit.simulate(iseed+iev,tptraj,colthits,coldxings);
+	// the collection handles are contiguous, and share the same collection
+	SHHANDLE const* first = dynamic_cast<SHHANDLE const*>(colthits.front().get());
+	if(first == 0) {
+	  nbadcol++;
+	  continue;
+	}
+	for(size_t ihit=0;ihit < first->collection().size(); ihit++){
+	  if(colthits[ihit].get() != &first->collection().handles()[ihit] || colthits[ihit]->hasMaterial() != thits[ihit]->hasMaterial()) nbadcol++;
+	}
+	KKTrk<KTRAJ,BorrowedHandles> coltrk(configptr,colseedtraj,colthits,coldxings);
+	if(!KKTest::sameFit(kktrk,coltrk))
+	  ndiff++;
+	else if(kktrk.fitStatus().usable())
+	  nfit++;
+      }
+      cout << KTRAJ::trajName() << " straw hit collection test with " << sfile << (fitmat ? " with" : " without") << " material: " << nfit
+	<< " identical usable fits of " << nevents << " events, " << ndiff << " differences from StrawHits, " << nbadcol << " bad collection hits" << endl;
+      // material fits of the ToyMC tracks don't yet converge reliably, so only the fits without material must be usable
+      if(ndiff > 0 || nbadcol > 0 || (nfit == 0 && !fitmat)){
+	cout << "Straw hit collection test failed" << endl;
+	status = 1;
+      }
+    }
+  }
+  return status;
+}
@@ -0,0 +1,112 @@
+// 
+// Validate the tabulated straw pathlengths against the analytic functions
+//
+#include "KinKal/StrawMat.hh"
+#include "MatEnv/MatDBInfo.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "TRandom3.h"
+
+using namespace std;
+using namespace KinKal;
+
+void print_usage() {
+  printf("Usage: StrawMat --nbins i --ntest i --tolerance f --rstraw f --thick f --rwire f\n");
+}
+
+int main(int argc, char **argv) {
+
+  unsigned nbins(100), ntest(100000);
+  double tol(1.0e-3);
+  double rstraw(2.5), thick(0.015), rwire(0.025);
+
+  static struct option long_options[] = {
+    {"nbins",     required_argument, 0, 'n'  },
+    {"ntest",     required_argument, 0, 't'  },
+    {"tolerance",     required_argument, 0, 'e'  },
+    {"rstraw",     required_argument, 0, 'r'  },
+    {"thick",     required_argument, 0, 'w'  },
+    {"rwire",     required_argument, 0, 'i'  },
+  };
+
+  int long_index =0;
+  int opt;
+
+  while ((opt = getopt_long_only(argc, argv,"", long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : 
+	nbins = atoi(optarg);
+	break;
+      case 't' : 
+	ntest = atoi(optarg);
+	break;
+      case 'e' : 
+	tol = atof(optarg);
+	break;
+      case 'r' : 
+	rstraw = atof(optarg);
+	break;
+      case 'w' : 
+	thick = atof(optarg);
+	break;
+      case 'i' : 
+	rwire = atof(optarg);
+	break;
+      default: print_usage(); 
+	       exit(EXIT_FAILURE);
+    }
+  }
+
+  MatEnv::MatDBInfo matdb;
+  StrawMat smat(matdb,rstraw,thick,rwire);
+  StrawMat tsmat(matdb,rstraw,thick,rwire);
+  tsmat.setPathTable(nbins);
+  // sample DOCA over the straw, and DOCA errors above the integration threshold
+  TRandom3 tr_;
+  vector<double> docas(ntest), ddocas(ntest), adots(ntest);
+  for(unsigned itest=0;itest<ntest;itest++){
+    docas[itest] = tr_.Uniform(-rstraw,rstraw);
+    ddocas[itest] = tr_.Uniform(0.05*rstraw,1.5*rstraw);
+    adots[itest] = tr_.Uniform(-0.9,0.9);
+  }
+  double maxgerr(0.0), maxwerr(0.0);
+  for(unsigned itest=0;itest<ntest;itest++){
+    double gpath = smat.gasPath(docas[itest],ddocas[itest],adots[itest]);
+    double wpath = smat.wallPath(docas[itest],ddocas[itest],adots[itest]);
+    double tgpath = tsmat.gasPath(docas[itest],ddocas[itest],adots[itest]);
+    double twpath = tsmat.wallPath(docas[itest],ddocas[itest],adots[itest]);
+    maxgerr = max(maxgerr,fabs(tgpath-gpath)/gpath);
+    maxwerr = max(maxwerr,fabs(twpath-wpath)/wpath);
+  }
+  cout << "Path table with " << nbins << " bins maximum relative error gas " << maxgerr << " wall " << maxwerr << endl;
+  // compare timing
+  double sum(0.0);
+  auto start = chrono::high_resolution_clock::now();
+  for(unsigned itest=0;itest<ntest;itest++)
+    sum += smat.gasPath(docas[itest],ddocas[itest],adots[itest]) + smat.wallPath(docas[itest],ddocas[itest],adots[itest]);
+  auto mid = chrono::high_resolution_clock::now();
+  for(unsigned itest=0;itest<ntest;itest++)
+    sum -= tsmat.gasPath(docas[itest],ddocas[itest],adots[itest]) + tsmat.wallPath(docas[itest],ddocas[itest],adots[itest]);
+  auto stop = chrono::high_resolution_clock::now();
+  cout << "Time/path pair analytic " << chrono::duration_cast<std::chrono::nanoseconds>(mid-start).count()/double(ntest)
+    << " table " << chrono::duration_cast<std::chrono::nanoseconds>(stop-mid).count()/double(ntest)
+    << " Nanoseconds, sum " << sum << endl;
+  // crossings must fit in the fixed-capacity collection
+  MatXingCol mxings;
+  tsmat.findXings(0.5*rstraw,0.1*rstraw,0.0,mxings);
+  if(mxings.size() != 2){
+    cout << "Unexpected number of material crossings " << mxings.size() << endl;
+    exit(EXIT_FAILURE);
+  }
+  if(maxgerr > tol || maxwerr > tol){
+    cout << "Path table error exceeds tolerance " << tol << endl;
+    exit(EXIT_FAILURE);
+  }
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,151 @@
+//
+// Compare the TPoca solver of a KTraj and a TLine against the successive linear approximation
+// it replaced: iteration count and TOCA accuracy on randomized pairs, starting away from the solution
+//
+#include "KinKal/TLine.hh"
+#include "KinKal/TPoca.hh"
+#include "KinKal/BField.hh"
+#include "CLHEP/Units/PhysicalConstants.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <limits>
+
+#include "TRandom3.h"
+
+using namespace KinKal;
+using namespace std;
+// avoid confusion with root
+using KinKal::TLine;
+
+void print_usage() {
+  printf("Usage: TPocaSolverTest --ntrials i --seed i --dtmax f --precision f\n");
+}
+
+// the previous solver: successive linear approximation of both trajectories at the current TOCA estimates.
+// Returns the number of iterations, or 0 if the trajectories are parallel
+template <class KTRAJ> unsigned linearTPoca(KTRAJ const& ktraj, TLine const& tline, double& ptoca, double& stoca,
+    double precision, unsigned maxiter) {
+  double dptoca(std::numeric_limits<double>::max()), dstoca(std::numeric_limits<double>::max());
+  double pspeed = ktraj.speed(ptoca);
+  stoca = tline.t0();
+  unsigned niter(0);
+  while((fabs(dptoca) > precision || fabs(dstoca) > precision) && niter++ < maxiter) {
+    Vec3 ppos = ktraj.position(ptoca);
+    Vec3 pdir = ktraj.direction(ptoca);
+    auto dpos = tline.pos0()-ppos;
+    double ddot = tline.dir().Dot(pdir);
+    double denom = 1.0 - ddot*ddot;
+    if(denom<1.0e-5) return 0;
+    double pdd = dpos.Dot(pdir);
+    double ldd = dpos.Dot(tline.dir());
+    dptoca = (pdd - ldd*ddot)/(denom*pspeed);
+    dstoca = tline.t0() + (pdd*ddot - ldd)/(denom*tline.speed(stoca)) - stoca;
+    ptoca += dptoca;
+    stoca += dstoca;
+  }
+  return std::min(niter,maxiter);
+}
+
+template <class KTRAJ>
+int TPocaSolverTest(int argc, char **argv) {
+  typedef TPoca<KTRAJ,TLine> TPOCA;
+  int opt;
+  unsigned ntrials(20000);
+  int iseed(3478);
+  double dtmax(0.8); // maximum offset of the starting particle time from the solution (ns)
+  double precision(0.001); // default TPoca precision
+  double mom(105.0), pmass(105.66);
+  int icharge(-1);
+  double hlen(500.0); // half-length of the wire
+  double gapmax(2.5); // maximum distance between TLine and KTRAJ
+
+  static struct option long_options[] = {
+    {"ntrials",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {"dtmax",     required_argument, 0, 'd'  },
+    {"precision",     required_argument, 0, 'p'  },
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : ntrials = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      case 'd' : dtmax = atof(optarg);
+		 break;
+      case 'p' : precision = atof(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  TRandom3 tr(iseed);
+  Vec3 bnom(0.0,0.0,1.0);
+  TPocaConfig config(precision);
+  // the reference solution is converged far beyond the test precision
+  TPocaConfig refconfig(1.0e-12,1000);
+  unsigned nnewiter(0), nolditer(0), nfail(0);
+  double newmaxerr(0.0), oldmaxerr(0.0);
+  for(unsigned itrial=0;itrial < ntrials; itrial++){
+    // random particle
+    double cost = tr.Uniform(-0.8,0.8);
+    double phi = tr.Uniform(-M_PI,M_PI);
+    double sint = sqrt(1.0-cost*cost);
+    Mom4 momv(mom*sint*cos(phi),mom*sint*sin(phi),mom*cost,pmass);
+    KTRAJ ktraj(Vec4(0.0,0.0,0.0,0.0),momv,icharge,bnom);
+    // random line passing near the particle at a random time, skewed WRT the particle direction
+    double time = tr.Uniform(-10.0,10.0);
+    Vec3 pos = ktraj.position(time);
+    Vec3 dir = ktraj.direction(time);
+    Vec3 perp1 = ktraj.direction(time,LocalBasis::perpdir);
+    Vec3 perp2 = ktraj.direction(time,LocalBasis::phidir);
+    double eta = tr.Uniform(-M_PI,M_PI);
+    Vec3 docadir = cos(eta)*perp1 + sin(eta)*perp2;
+    Vec3 ldir = (sin(eta)*perp1 - cos(eta)*perp2 + tr.Uniform(-0.5,0.5)*dir).Unit();
+    double lspeed = 0.7*CLHEP::c_light;
+    Vec3 lpos = pos + tr.Uniform(0.0,gapmax)*docadir;
+    TLine tline(lpos,ldir*lspeed,time,TRange(time-hlen/lspeed,time+hlen/lspeed));
+    TPocaHint refhint;
+    refhint.particleHint_ = true;
+    refhint.particleToca_ = time;
+    TPOCA reftp(ktraj,tline,refhint,refconfig);
+    if(reftp.status() != TPocaBase::converged){
+      nfail++;
+      continue;
+    }
+    // start both solvers at the same offset from the solution
+    TPocaHint hint;
+    hint.particleHint_ = true;
+    hint.particleToca_ = reftp.particleToca() + tr.Uniform(-dtmax,dtmax);
+    TPOCA newtp(ktraj,tline,hint,config);
+    double ptoca(hint.particleToca_), stoca;
+    unsigned oldniter = linearTPoca(ktraj,tline,ptoca,stoca,precision,100);
+    if(newtp.status() != TPocaBase::converged || oldniter == 0){
+      nfail++;
+      continue;
+    }
+    nnewiter += newtp.iterations();
+    nolditer += oldniter;
+    newmaxerr = std::max(newmaxerr,std::max(fabs(newtp.particleToca()-reftp.particleToca()),fabs(newtp.sensorToca()-reftp.sensorToca())));
+    oldmaxerr = std::max(oldmaxerr,std::max(fabs(ptoca-reftp.particleToca()),fabs(stoca-reftp.sensorToca())));
+  }
+  unsigned nsolve = ntrials-nfail;
+  double newavg = nnewiter/double(nsolve);
+  double oldavg = nolditer/double(nsolve);
+  cout << KTRAJ::trajName() << " TPoca " << nsolve << " solves, " << nfail << " failed" << endl;
+  cout << "Iterations/solve: TPoca " << newavg << " linear approximation " << oldavg << endl;
+  cout << "Max TOCA error: TPoca " << newmaxerr << " ns, linear approximation " << oldmaxerr << " ns" << endl;
+  int status(0);
+  // the solver must converge, be within the requested precision, and be at least as accurate as the
+  // linear approximation.  It may take at most 0.5 more iterations on average
+  if(nfail > 0 || newmaxerr > precision || newmaxerr > oldmaxerr || newavg > oldavg + 0.5){
+    cout << "TPoca solver test failed" << endl;
+    status = 1;
+  }
+  return status;
+}
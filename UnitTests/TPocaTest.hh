@@ -3,6 +3,7 @@
 //
 #include "KinKal/TLine.hh"
 #include "KinKal/TPoca.hh"
+#include "KinKal/TPocaBatch.hh"
 #include "KinKal/BField.hh"
 #include "CLHEP/Units/PhysicalConstants.h"
 
@@ -111,6 +112,8 @@ int TPocaTest(int argc, char **argv) {
     ts = KTRAJ::paramTitle(parindex)+string(" TOCA Change;#Delta TOCA (exact);#Delta TOCA (derivative)");
     ttpoca.back()->SetTitle(ts.c_str());
   }
+  std::vector<TLine> tlines;
+  tlines.reserve(ntstep);
   for(unsigned itime=0;itime < ntstep;itime++){
     double time = tmin + itime*(tmax-tmin)/(ntstep-1);
     // create tline perp to trajectory at the specified time, separated by the specified gap
@@ -130,7 +133,8 @@ int TPocaTest(int argc, char **argv) {
     // time range;
     TRange prange(time-hlen/pspeed, time+hlen/pspeed);
     // create the TLine
-    TLine tline(ppos, pvel,time,prange);
+    tlines.emplace_back(ppos, pvel,time,prange);
+    TLine const& tline = tlines.back();
     // create TPoca from these
     TPOCA tp(lhel,tline);
   //  cout << "TPoca status " << tp.statusName() << " doca " << tp.doca() << " dt " << tp.deltaT() << endl;
@@ -165,6 +169,21 @@ int TPocaTest(int argc, char **argv) {
       }
     }
   }
+  // test the batched TPOCA against the single-sensor results
+  TPocaBatch<KTRAJ> tpbatch;
+  for(auto const& tline : tlines) tpbatch.addSensor(tline);
+  tpbatch.solve(lhel);
+  for(size_t iline=0;iline < tlines.size(); iline++){
+    TPOCA tp(lhel,tlines[iline]);
+    TPOCA btp = tpbatch.tPoca(lhel,iline);
+    if(btp.status() != tp.status() || fabs(btp.doca()-tp.doca()) > 1.0e-6 || fabs(btp.deltaT()-tp.deltaT()) > 1.0e-6 ||
+	fabs(btp.dDdP()[0]-tp.dDdP()[0]) > 1.0e-6){
+      cout << "Batch TPoca disagrees " << endl;
+      btp.print(cout,1);
+      tp.print(cout,1);
+      return -1;
+    }
+  }
   for(int ipar=0;ipar<lhel.npars_;ipar++){
     dtpcan->cd(ipar+1);
     dtpoca[ipar]->Draw("A*");
@@ -0,0 +1,199 @@
+//
+// Test the table-driven distance-to-time relationship: compare against a constant velocity D2T and an analytic
+// ExB-dependent model, round-trip the binary calibration file, and time the evaluation
+//
+#include "KinKal/TableD2T.hh"
+
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <getopt.h>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+
+using namespace std;
+using namespace KinKal;
+
+void print_usage() {
+  printf("Usage: TableD2T --file s --nr i --nphi i --ntries i\n");
+}
+
+int main(int argc, char **argv) {
+
+  string filename("TableD2T.bin");
+  unsigned nr(26), nphi(13);
+  unsigned ntries(1000000);
+  double rcell(2.5), vdrift(0.05), sigt(3.0);
+  double rcoef(0.4), phicoef(0.2); // analytic model: nonlinearity in distance, and ExB azimuth dependence
+
+  static struct option long_options[] = {
+    {"file",     required_argument, 0, 'f'  },
+    {"nr",     required_argument, 0, 'r'  },
+    {"nphi",     required_argument, 0, 'p'  },
+    {"ntries",     required_argument, 0, 'n'  },
+  };
+
+  int long_index =0;
+  int opt;
+
+  while ((opt = getopt_long_only(argc, argv,"", long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'f' :
+	filename = string(optarg);
+	break;
+      case 'r' :
+	nr = atoi(optarg);
+	break;
+      case 'p' :
+	nphi = atoi(optarg);
+	break;
+      case 'n' :
+	ntries = atoi(optarg);
+	break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  int status(0);
+  TableD2T::Grid grid(nr,nphi,rcell);
+  // analytic model: t = r/v0 (1 + a r/rcell)(1 + b cos(phi))
+  auto model = [&](double rho, double phi, double& tdrift, double& tdriftvar, double& dspeed) {
+    double phifac = 1.0 + phicoef*cos(phi);
+    tdrift = rho/vdrift*(1.0 + rcoef*rho/rcell)*phifac;
+    dspeed = vdrift/((1.0 + 2.0*rcoef*rho/rcell)*phifac);
+    tdriftvar = sigt*sigt*(1.0 + rho/rcell); };
+  std::vector<double> tcv(grid.size()), tvcv(grid.size()), vcv(grid.size());
+  std::vector<double> tm(grid.size()), tvm(grid.size()), vm(grid.size());
+  for(unsigned iphi=0;iphi<nphi;iphi++){
+    for(unsigned ir=0;ir<nr;ir++){
+      double rho = ir*rcell/(nr-1);
+      double phi = grid.phimin_ + iphi*(grid.phimax_-grid.phimin_)/(nphi-1);
+      size_t ival = grid.index(ir,iphi);
+      tcv[ival] = rho/vdrift;
+      tvcv[ival] = sigt*sigt;
+      vcv[ival] = vdrift;
+      model(rho,phi,tm[ival],tvm[ival],vm[ival]);
+    }
+  }
+  // a constant table must reproduce CVD2T exactly, including outside the table
+  CVD2T cvd2t(vdrift,sigt*sigt,rcell);
+  TableD2T cvtable(grid,tcv,tvcv,vcv);
+  double maxdiff(0.0);
+  for(double rho = -1.5*rcell; rho < 1.5*rcell; rho += 0.01*rcell){
+    for(double phi = -M_PI; phi < M_PI; phi += 0.05){
+      Pol2 drift(rho,phi);
+      double t1, tv1, v1, t2, tv2, v2;
+      cvd2t.distanceToTime(drift,t1,tv1,v1);
+      cvtable.distanceToTime(drift,t2,tv2,v2);
+      maxdiff = std::max(maxdiff,std::max(fabs(t1-t2),std::max(fabs(tv1-tv2),fabs(v1-v2)/vdrift)));
+    }
+  }
+  cout << "Constant table maximum difference from CVD2T " << maxdiff << endl;
+  if(maxdiff > 1e-4 || fabs(cvtable.averageDriftSpeed()-vdrift) > 1e-9 || fabs(cvtable.maximumDriftTime()-cvd2t.maximumDriftTime()) > 1e-9){
+    cout << "Constant table doesn't match CVD2T" << endl;
+    status = 1;
+  }
+  // compare against the analytic model, and check the speed is consistent with the time
+  TableD2T mtable(grid,tm,tvm,vm);
+  double maxterr(0.0), maxvarerr(0.0), maxverr(0.0), maxslope(0.0);
+  double dr(1e-4);
+  for(double rho = 0.0; rho < rcell; rho += 0.013*rcell){
+    for(double phi = grid.phimin_; phi < grid.phimax_; phi += 0.03){
+      double t, tv, v, tmod, tvmod, vmod, tp, tvp, vp;
+      mtable.distanceToTime(Pol2(rho,phi),t,tv,v);
+      mtable.distanceToTime(Pol2(rho+dr,phi),tp,tvp,vp);
+      model(rho,phi,tmod,tvmod,vmod);
+      maxterr = std::max(maxterr,fabs(t-tmod));
+      maxvarerr = std::max(maxvarerr,fabs(tv-tvmod)/tvmod);
+      maxverr = std::max(maxverr,fabs(v-vmod)/vmod);
+      maxslope = std::max(maxslope,fabs(dr/(tp-t)-v)/v);
+    }
+  }
+  cout << "Model maximum time error " << maxterr << " ns, relative variance error " << maxvarerr
+    << " relative speed error " << maxverr << " relative speed-slope difference " << maxslope << endl;
+  if(maxterr > 0.01 || maxvarerr > 1e-3 || maxverr > 1e-3 || maxslope > 0.01){
+    cout << "Table doesn't match model" << endl;
+    status = 1;
+  }
+  // beyond the table the time must keep increasing, with a speed no smaller than the smallest tabulated speed.  Test also a table
+  // whose speed drops sharply at the edge
+  std::vector<double> vdrop(vm);
+  for(unsigned iphi=0;iphi<nphi;iphi++) vdrop[grid.index(nr-1,iphi)] = 0.05*vm[grid.index(nr-2,iphi)];
+  TableD2T droptable(grid,tm,tvm,vdrop);
+  for(auto const* table : {&mtable,&droptable}){
+    double vmin = *std::min_element(table == &mtable ? vm.begin() : vdrop.begin(),table == &mtable ? vm.end() : vdrop.end());
+    for(double phi = grid.phimin_; phi < grid.phimax_; phi += 0.03){
+      double tlast(-1.0);
+      for(double rho = rcell; rho < 3.0*rcell; rho += 0.01*rcell){
+	double t, tv, v;
+	table->distanceToTime(Pol2(rho,phi),t,tv,v);
+	if(!(v >= vmin) || !std::isfinite(t) || !(t > tlast)){
+	  cout << "Invalid extrapolation at distance " << rho << " azimuth " << phi << " time " << t << " speed " << v << endl;
+	  status = 1;
+	  break;
+	}
+	tlast = t;
+      }
+    }
+  }
+  // round-trip through a calibration file.  The file values are single precision
+  TableD2T::write(filename,grid,tm,tvm,vm);
+  TableD2T ftable(filename);
+  maxdiff = 0.0;
+  for(double rho = -1.2*rcell; rho < 1.2*rcell; rho += 0.017*rcell){
+    for(double phi = -M_PI; phi < M_PI; phi += 0.07){
+      double t1, tv1, v1, t2, tv2, v2;
+      mtable.distanceToTime(Pol2(rho,phi),t1,tv1,v1);
+      ftable.distanceToTime(Pol2(rho,phi),t2,tv2,v2);
+      maxdiff = std::max(maxdiff,std::max(fabs(t1-t2),std::max(fabs(tv1-tv2),fabs(v1-v2)/vdrift)));
+    }
+  }
+  cout << "File table maximum difference " << maxdiff << endl;
+  if(maxdiff > 1e-4){
+    cout << "File table doesn't match" << endl;
+    status = 1;
+  }
+  // a file written with the other byte order, or truncated, must be rejected
+  std::vector<char> bytes;
+  {
+    std::ifstream ifs(filename.c_str(),std::ios::binary);
+    bytes.assign((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+  }
+  std::vector<char> swapped(bytes);
+  size_t boffset = offsetof(TableD2T::Header,byteorder_);
+  std::reverse(swapped.begin()+boffset,swapped.begin()+boffset+sizeof(std::uint32_t));
+  std::vector<char> truncated(bytes.begin(),bytes.end()-sizeof(float));
+  for(auto const* badbytes : {&swapped,&truncated}){
+    {
+      std::ofstream ofs(filename.c_str(),std::ios::binary|std::ios::trunc);
+      ofs.write(badbytes->data(),badbytes->size());
+    }
+    try {
+      TableD2T badtable(filename);
+      cout << "Bad file was accepted" << endl;
+      status = 1;
+    } catch (std::runtime_error const& error) {
+      cout << "Bad file rejected: " << error.what() << endl;
+    }
+  }
+  remove(filename.c_str());
+  // time the evaluation
+  std::vector<Pol2> drifts;
+  for(unsigned itry=0;itry<1000;itry++)
+    drifts.push_back(Pol2(rcell*(itry%997)/997.0,grid.phimin_+(grid.phimax_-grid.phimin_)*(itry%89)/89.0));
+  double tsum(0.0);
+  auto start = chrono::high_resolution_clock::now();
+  for(unsigned itry=0;itry<ntries;itry++){
+    double t, tv, v;
+    mtable.distanceToTime(drifts[itry%drifts.size()],t,tv,v);
+    tsum += t + tv + v;
+  }
+  auto stop = chrono::high_resolution_clock::now();
+  cout << "Time/evaluation = " << chrono::duration_cast<std::chrono::nanoseconds>(stop-start).count()/double(ntries)
+    << " Nanoseconds (checksum " << tsum << ")" << endl;
+  exit(status);
+}
@@ -0,0 +1,95 @@
+#ifndef KinKal_ToyFit_hh
+#define KinKal_ToyFit_hh
+//
+//  Simulate tracks with the ToyMC and create their fit seeds and configurations, for the tests of specific fit features.
+//  Each event is simulated from its own random seed, so the same event can be re-simulated with fresh hits for fits that
+//  must not share hit state.  The hits refer to the ToyMC drift and material models, so they must not outlive the ToyFit.
+//
+#include "MatEnv/MatDBInfo.hh"
+#include "MatEnv/DetMaterial.hh"
+#include "KinKal/PKTraj.hh"
+#include "KinKal/BField.hh"
+#include "KinKal/KKConfig.hh"
+#include "KinKal/KKTrk.hh"
+#include "UnitTests/ToyMC.hh"
+
+#include <string>
+#include <fstream>
+#include <cstdlib>
+#include <memory>
+#include <type_traits>
+
+namespace KKTest {
+  using namespace KinKal;
+  template <class KTRAJ> class ToyFit {
+    public:
+      typedef ToyMC<KTRAJ> TOYMC;
+      typedef PKTraj<KTRAJ> PKTRAJ;
+      typedef typename TOYMC::THITCOL THITCOL;
+      typedef typename TOYMC::DXINGCOL DXINGCOL;
+      // electrons of 105 MeV/c in a uniform 1 Tesla field, as the FitTest defaults
+      ToyFit(unsigned nhits=40, bool simmat=true, double ambigdoca=-1.0) : bfield_(Vec3(0.0,0.0,1.0)), mom_(105.0), mass_(0.511),
+	toy_(bfield_, mom_, -1, 3000.0, 0, nhits, simmat, true, ambigdoca, mass_) { toy_.setSmearSeed(true); }
+      // simulate an event, and return a randomized fit seed created from the true trajectory
+      KTRAJ simulate(int iseed, PKTRAJ& tptraj, THITCOL& thits, DXINGCOL& dxings);
+      // create a fit configuration with the schedule from the named file in UnitTests
+      std::shared_ptr<KKConfig> config(std::string const& sfile, bool fitmat) const;
+      // simulate the straw hits in a StrawHitCollection
+      void setUseCollection(bool usecol) { toy_.setUseCollection(usecol); }
+      BField const& bfield() const { return bfield_; }
+    private:
+      UniformBField bfield_;
+      double mom_, mass_;
+      TOYMC toy_;
+  };
+
+  template <class KTRAJ> KTRAJ ToyFit<KTRAJ>::simulate(int iseed, PKTRAJ& tptraj, THITCOL& thits, DXINGCOL& dxings) {
+    toy_.setRandomSeed(iseed);
+    tptraj = PKTRAJ();
+    thits.clear();
+    dxings.clear();
+    toy_.simulateParticle(tptraj,thits,dxings);
+    double tmid = tptraj.range().mid();
+    auto const& midhel = tptraj.nearestPiece(tmid);
+    auto seedmom = midhel.momentum(tmid);
+    seedmom.SetM(mass_);
+    TRange seedrange(tptraj.range().low()-0.5,tptraj.range().high()+0.5);
+    KTRAJ seedtraj(midhel.pos4(tmid),seedmom,midhel.charge(),bfield_.fieldVect(midhel.position(tmid)),seedrange);
+    if constexpr (std::is_constructible<KTRAJ,KTRAJ const&,BField const&>::value) seedtraj = KTRAJ(seedtraj,bfield_);
+    toy_.createSeed(seedtraj);
+    return seedtraj;
+  }
+
+  template <class KTRAJ> std::shared_ptr<KKConfig> ToyFit<KTRAJ>::config(std::string const& sfile, bool fitmat) const {
+    auto configptr = std::make_shared<KKConfig>(bfield_);
+    configptr->addmat_ = fitmat;
+    configptr->plevel_ = KKConfig::none;
+    const char* source = std::getenv("PACKAGE_SOURCE");
+    if(source == 0) throw std::invalid_argument("ToyFit: PACKAGE_SOURCE not defined");
+    std::ifstream ifs(std::string(source) + "/UnitTests/" + sfile);
+    if(!ifs.good()) throw std::invalid_argument("ToyFit: can't open schedule file " + sfile);
+    configptr->readSchedule<WireHitUpdater,AmbigResolver>(ifs);
+    return configptr;
+  }
+
+  // compare the fit status and, for usable fits, the fit parameters at the start, middle and end of the track.  These must be identical
+  template <class KTRAJ, class HPOLICY1, class HPOLICY2> bool sameFit(KKTrk<KTRAJ,HPOLICY1> const& trk1, KKTrk<KTRAJ,HPOLICY2> const& trk2) {
+    auto const& stat1 = trk1.fitStatus();
+    auto const& stat2 = trk2.fitStatus();
+    if(stat1.status_ != stat2.status_ || stat1.miter_ != stat2.miter_ || stat1.iter_ != stat2.iter_) return false;
+    if(!stat1.usable()) return true;
+    if(stat1.chisq_ != stat2.chisq_ || stat1.ndof_ != stat2.ndof_ || trk1.fitTraj().pieces().size() != trk2.fitTraj().pieces().size()) return false;
+    auto const& range = trk1.fitTraj().range();
+    for(double time : {range.low(), range.mid(), range.high()}){
+      auto const& pars1 = trk1.fitTraj().nearestPiece(time).params();
+      auto const& pars2 = trk2.fitTraj().nearestPiece(time).params();
+      for(size_t ipar=0;ipar < KTRAJ::NParams(); ipar++){
+	if(pars1.parameters()[ipar] != pars2.parameters()[ipar]) return false;
+	for(size_t jpar=0;jpar < KTRAJ::NParams(); jpar++)
+	  if(pars1.covariance()[ipar][jpar] != pars2.covariance()[ipar][jpar]) return false;
+      }
+    }
+    return true;
+  }
+}
+#endif
@@ -8,6 +8,7 @@
 #include "KinKal/PKTraj.hh"
 #include "KinKal/TPoca.hh"
 #include "KinKal/StrawHit.hh"
+#include "KinKal/StrawHitCollection.hh"
 #include "KinKal/StrawMat.hh"
 #include "KinKal/ScintHit.hh"
 #include "KinKal/BField.hh"
@@ -30,6 +31,7 @@ namespace KKTest {
       typedef std::shared_ptr<SCINTHIT> SCINTHITPTR;
       typedef StrawXing<KTRAJ> STRAWXING;
       typedef std::shared_ptr<STRAWXING> STRAWXINGPTR;
+      typedef StrawHitCollection<KTRAJ> STRAWHITCOL;
       typedef std::vector<THITPTR> THITCOL;
       typedef std::vector<DXINGPTR> DXINGCOL;
       typedef PKTraj<KTRAJ> PKTRAJ;
@@ -37,14 +39,14 @@ namespace KKTest {
       typedef typename KTRAJ::DVEC DVEC;     
       // create from aseed
       ToyMC(BField const& bfield, double mom, int icharge, double zrange, int iseed, unsigned nhits, bool simmat, bool lighthit, double ambigdoca ,double simmass) : 
-	bfield_(bfield), mom_(mom), icharge_(icharge),
+	bfield_(bfield), matdb_(std::vector<double>(1,simmass)), mom_(mom), icharge_(icharge),
 	tr_(iseed), nhits_(nhits), simmat_(simmat), lighthit_(lighthit), ambigdoca_(ambigdoca), simmass_(simmass),
 	sprop_(0.8*CLHEP::c_light), sdrift_(0.065), 
 	zrange_(zrange), rmax_(800.0), rstraw_(2.5), rwire_(0.025), wthick_(0.015), sigt_(3.0), ineff_(0.1),
 	momvar_(1.0), ttsig_(0.5), twsig_(10.0), shmax_(80.0), clen_(200.0), cprop_(0.8*CLHEP::c_light),
 	osig_(10.0), ctmin_(0.5), ctmax_(0.8), tbuff_(0.1), tol_(0.01),
 	smat_(matdb_,rstraw_, wthick_,rwire_),
-	d2t_(sdrift_,sigt_*sigt_,rstraw_) {}
+	d2t_(sdrift_,sigt_*sigt_,rstraw_), usecol_(false) {}
 
       // generate a straw at the given time.  direction and drift distance are random
       TLine generateStraw(PKTRAJ const& traj, double htime);
@@ -58,6 +60,9 @@ namespace KKTest {
       // set functions, for special purposes
       void setSeedVar(double momvar) { momvar_ = momvar; }
       void setSmearSeed(bool smear) { smearseed_ = smear; }
+      void setRandomSeed(int iseed) { tr_.SetSeed(iseed); }
+      // store the straw hits of each particle in a StrawHitCollection instead of individual StrawHits
+      void setUseCollection(bool usecol) { usecol_ = usecol; }
       // accessors
       double shVar() const {return sigt_*sigt_;}
       double chVar() const {return ttsig_*ttsig_;}
@@ -88,6 +93,7 @@ namespace KKTest {
       double tol_; // tolerance on spatial accuracy for 
       StrawMat smat_; // straw material
       CVD2T d2t_;
+      bool usecol_; // use a StrawHitCollection
   };
 
   template <class KTRAJ> TLine ToyMC<KTRAJ>::generateStraw(PKTRAJ const& traj, double htime) {
@@ -123,6 +129,11 @@ namespace KKTest {
     double dt(0.0);
     if(nhits_ > 0) dt = (pktraj.range().range()-2*tbuff_)/(nhits_);
     Vec3 bsim;
+    std::shared_ptr<STRAWHITCOL> shcol;
+    if(usecol_){
+      shcol = std::make_shared<STRAWHITCOL>(bfield_,d2t_,smat_);
+      shcol->reserve(nhits_);
+    }
     // create the hits (and associated materials)
     for(size_t ihit=0; ihit<nhits_; ihit++){
       double htime = tbuff_ + pktraj.range().low() + ihit*dt;
@@ -136,7 +147,10 @@ namespace KKTest {
       // construct the hit from this trajectory
       auto sxing = std::make_shared<STRAWXING>(tp,smat_);
       if(tr_.Uniform(0.0,1.0) > ineff_){
-	thits.push_back(std::make_shared<STRAWHIT>(bfield_, tline, d2t_,sxing,ambig));
+	if(usecol_)
+	  shcol->addHit(tline,tp,ambig);
+	else
+	  thits.push_back(std::make_shared<STRAWHIT>(bfield_, tline, d2t_,sxing,ambig));
       } else {
 	dxings.push_back(sxing);
       }
@@ -147,6 +161,7 @@ namespace KKTest {
 	if(fabs(defrac) > 0.1)break;
       }
     }
+    if(usecol_) STRAWHITCOL::createHandles(shcol,thits);
     if(lighthit_ && tr_.Uniform(0.0,1.0) > ineff_){
       createScintHit(pktraj,thits);
     }
@@ -228,7 +243,7 @@ namespace KKTest {
   }
 
   template <class KTRAJ> void ToyMC<KTRAJ>::createSeed(KTRAJ& seed){
-    auto& seedpar = seed.params();
+    auto seedpar = seed.params();
     // propagate the momentum and position variances to parameter variances
     for(int idir=0;idir<LocalBasis::ndir;idir++){
       DVEC pder = seed.momDeriv(seed.range().mid(),LocalBasis::LocDir(idir));
@@ -252,6 +267,7 @@ namespace KKTest {
 	seedpar.parameters()[ipar] += tr_.Gaus(0.0,perr);
       }
     }
+    seed.setParams(seedpar);
   }
 
   template <class KTRAJ> void ToyMC<KTRAJ>::extendTraj(PKTRAJ& pktraj,double htime) {
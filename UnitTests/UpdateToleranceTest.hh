@@ -0,0 +1,109 @@
+//
+// Test keeping the hit derivatives in algebraic iterations where the reference moved little (see MConfig::updtol_): fits of the same
+// events with and without an update tolerance must converge to the same parameters and chisquared, within a fraction of the parameter
+// sigma set by the tolerance.  They must also differ somewhat, or the tolerance never kept any derivatives.  Each fit gets freshly
+// simulated hits, as the fit changes their state.  With material in the fit, only the hits without material keep their derivatives
+//
+#include "KinKal/PKTraj.hh"
+#include "KinKal/KKTrk.hh"
+#include "UnitTests/ToyFit.hh"
+
+#include <iostream>
+#include <stdio.h>
+#include <getopt.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace KinKal;
+using namespace std;
+
+void print_usage() {
+  printf("Usage: UpdateToleranceTest --nevents i --seed i --fitmat i --updtol f --maxdiff f --maxdchisq f\n");
+}
+
+template <class KTRAJ>
+int UpdateToleranceTest(int argc, char **argv) {
+  typedef KKTrk<KTRAJ> KKTRK;
+  typedef KKTest::ToyFit<KTRAJ> TOYFIT;
+  int opt;
+  unsigned nevents(50);
+  int iseed(123421);
+  bool fitmat(false); // material fits of the ToyMC tracks don't yet converge reliably
+  double updtol(0.1); // in units of the residual sigma
+  // the derivatives are kept only while the residual change they predict is below the tolerance, so the fits should agree to well below that
+  double maxdiff(0.05); // in units of the parameter sigma
+  double maxdchisq(0.05);
+
+  static struct option long_options[] = {
+    {"nevents",     required_argument, 0, 'n'  },
+    {"seed",     required_argument, 0, 's'  },
+    {"fitmat",     required_argument, 0, 'f'  },
+    {"updtol",     required_argument, 0, 'U'  },
+    {"maxdiff",     required_argument, 0, 'd'  },
+    {"maxdchisq",     required_argument, 0, 'c'  },
+    {NULL, 0,0,0}
+  };
+
+  int long_index =0;
+  while ((opt = getopt_long_only(argc, argv,"",
+	  long_options, &long_index )) != -1) {
+    switch (opt) {
+      case 'n' : nevents = atoi(optarg);
+		 break;
+      case 's' : iseed = atoi(optarg);
+		 break;
+      case 'f' : fitmat = atoi(optarg);
+		 break;
+      case 'U' : updtol = atof(optarg);
+		 break;
+      case 'd' : maxdiff = atof(optarg);
+		 break;
+      case 'c' : maxdchisq = atof(optarg);
+		 break;
+      default: print_usage();
+	       exit(EXIT_FAILURE);
+    }
+  }
+  // simulate material only when fitting it
+  TOYFIT toyfit(40,fitmat);
+  auto configptr = toyfit.config("Schedule.txt",fitmat);
+  auto tolconfigptr = toyfit.config("Schedule.txt",fitmat);
+  for(auto& mconfig : configptr->schedule_) mconfig.updtol_ = 0.0;
+  for(auto& mconfig : tolconfigptr->schedule_) mconfig.updtol_ = updtol;
+  unsigned nfit(0), ntolfit(0), nboth(0);
+  double maxpardiff(0.0), maxchisqdiff(0.0);
+  for(unsigned iev=0;iev < nevents; iev++){
+    typename TOYFIT::PKTRAJ tptraj;
+    typename TOYFIT::THITCOL thits, tolthits;
+    typename TOYFIT::DXINGCOL dxings, toldxings;
+    KTRAJ seedtraj = toyfit.simulate(iseed+iev,tptraj,thits,dxings);
+    KKTRK kktrk(configptr,seedtraj,thits,dxings);
+    KTRAJ tolseedtraj = toyfit.simulate(iseed+iev,tptraj,tolthits,toldxings);
+    KKTRK toltrk(tolconfigptr,tolseedtraj,tolthits,toldxings);
+    bool usable = kktrk.fitStatus().usable();
+    bool tolusable = toltrk.fitStatus().usable();
+    if(usable) nfit++;
+    if(tolusable) ntolfit++;
+    if(!(usable && tolusable)) continue;
+    nboth++;
+    // compare the parameters in units of the sigma of the fit without tolerance, at the start, middle and end of the track
+    auto const& fittraj = kktrk.fitTraj();
+    auto const& tolfittraj = toltrk.fitTraj();
+    for(double time : {tptraj.range().low(), tptraj.range().mid(), tptraj.range().high()}){
+      auto const& pars = fittraj.nearestPiece(time).params();
+      auto const& tolpars = tolfittraj.nearestPiece(time).params();
+      for(size_t ipar=0;ipar < KTRAJ::NParams(); ipar++)
+	maxpardiff = std::max(maxpardiff,fabs(tolpars.parameters()[ipar]-pars.parameters()[ipar])/sqrt(pars.covariance()[ipar][ipar]));
+    }
+    maxchisqdiff = std::max(maxchisqdiff,fabs(toltrk.fitStatus().chisq_ - kktrk.fitStatus().chisq_));
+  }
+  cout << KTRAJ::trajName() << " update tolerance " << updtol << " test: " << nfit << " usable fits without and " << ntolfit << " with tolerance, of "
+    << nevents << " events" << endl;
+  cout << "Maximum difference from the fits without tolerance: parameters " << maxpardiff << " sigma, chisq " << maxchisqdiff << endl;
+  int status(0);
+  if(nboth == 0 || ntolfit < nfit || maxpardiff > maxdiff || maxchisqdiff > maxdchisq || maxchisqdiff == 0.0){
+    cout << "Update tolerance test failed" << endl;
+    status = 1;
+  }
+  return status;
+}